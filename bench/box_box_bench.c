@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "chaos/chaos.h"
+
+#define BOX_COUNT 4096
+#define PAIR_COUNT 100000
+#define ROUND_COUNT 20
+
+// NOTE: random_random_float only yields floats with SINGLE_PRECISION defined, so they are made
+// from the bits here
+static float bench_float(struct Random* random, float min, float max) {
+  return min + (max - min) * (float)(random_bits(random) / 4294967296.0);
+}
+
+// Boxes of mixed sizes and orientations packed close enough that a good share of the pairs touch
+static void bench_reset(struct RigidBody* bodies, struct CollisionBox* boxes, unsigned int* pairs) {
+  struct Random random;
+  random_seed(&random, 1);
+
+  for (unsigned int box_num = 0; box_num < BOX_COUNT; box_num++) {
+    struct RigidBody* body = &bodies[box_num];
+    memset(body, 0, sizeof(struct RigidBody));
+    rigid_body_set_mass(body, 1.0f);
+    body->position = (vec3){.x = bench_float(&random, -1.0f, 1.0f), .y = bench_float(&random, -1.0f, 1.0f), .z = bench_float(&random, -1.0f, 1.0f)};
+    body->orientation = (quat){.data[0] = bench_float(&random, -1.0f, 1.0f), .data[1] = bench_float(&random, -1.0f, 1.0f), .data[2] = bench_float(&random, -1.0f, 1.0f), .data[3] = bench_float(&random, -1.0f, 1.0f)};
+    rigid_body_calculate_derived_data(body);
+
+    boxes[box_num].half_size = (vec3){.x = bench_float(&random, 0.2f, 0.7f), .y = bench_float(&random, 0.2f, 0.7f), .z = bench_float(&random, 0.2f, 0.7f)};
+    boxes[box_num].collision_primitive.body = body;
+    boxes[box_num].collision_primitive.offset = (mat4){.data[0] = 1.0f, .data[5] = 1.0f, .data[10] = 1.0f, .data[15] = 1.0f};
+    collision_primitive_calculate_internals(&boxes[box_num].collision_primitive);
+  }
+
+  for (unsigned int pair_num = 0; pair_num < PAIR_COUNT; pair_num++) {
+    pairs[pair_num * 2] = random_int(&random, BOX_COUNT - 1);
+    pairs[pair_num * 2 + 1] = (pairs[pair_num * 2] + 1 + random_int(&random, BOX_COUNT - 2)) % BOX_COUNT;
+  }
+}
+
+static double bench_seconds(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(void) {
+  struct RigidBody* bodies = malloc(sizeof(struct RigidBody) * BOX_COUNT);
+  struct CollisionBox* boxes = malloc(sizeof(struct CollisionBox) * BOX_COUNT);
+  unsigned int* pairs = malloc(sizeof(unsigned int) * PAIR_COUNT * 2);
+  struct Contact* contacts = malloc(sizeof(struct Contact) * PAIR_COUNT);
+  bench_reset(bodies, boxes, pairs);
+
+  unsigned int overlapping = 0;
+  clock_t start = clock();
+  for (unsigned int round = 0; round < ROUND_COUNT; round++)
+    for (unsigned int pair_num = 0; pair_num < PAIR_COUNT; pair_num++)
+      overlapping += intersection_test_box_and_box(&boxes[pairs[pair_num * 2]], &boxes[pairs[pair_num * 2 + 1]]);
+  double test_time = bench_seconds(start);
+
+  struct CollisionData data = {.contact_array = contacts, .friction = 0.6f, .restitution = 0.0f, .tolerance = 0.0f};
+  start = clock();
+  for (unsigned int round = 0; round < ROUND_COUNT; round++) {
+    collision_data_reset(&data, PAIR_COUNT);
+    for (unsigned int pair_num = 0; pair_num < PAIR_COUNT; pair_num++)
+      collision_detector_box_and_box(&boxes[pairs[pair_num * 2]], &boxes[pairs[pair_num * 2 + 1]], &data);
+  }
+  double detect_time = bench_seconds(start);
+
+  double tests = (double)PAIR_COUNT * ROUND_COUNT;
+  printf("box and box, %d pairs x %d rounds, %u lanes, %u contacts per round\n", PAIR_COUNT, ROUND_COUNT, rigid_body_get_batch_width(), data.contact_count);
+  printf("  intersection test: %8.3f ms  %8.2f Mpairs/s\n", test_time * 1000.0, test_time > 0.0 ? tests / test_time * 1e-6 : 0.0);
+  printf("  detector:          %8.3f ms  %8.2f Mpairs/s\n", detect_time * 1000.0, detect_time > 0.0 ? tests / detect_time * 1e-6 : 0.0);
+  printf("  overlapping: %.1f%%\n", 100.0 * overlapping / tests);
+
+  free(contacts);
+  free(pairs);
+  free(boxes);
+  free(bodies);
+
+  return 0;
+}
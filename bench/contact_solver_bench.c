@@ -0,0 +1,254 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "chaos/chaos.h"
+
+#define GRID_SIZE 100
+#define BODY_COUNT (GRID_SIZE * GRID_SIZE)
+#define MAX_CONTACTS (BODY_COUNT * 3)
+#define FRAME_COUNT 50
+#define DURATION (1.0f / 60.0f)
+
+// NOTE: random_random_float only yields floats with SINGLE_PRECISION defined, so they are made
+// from the bits here
+static float bench_float(struct Random* random, float min, float max) {
+  return min + (max - min) * (float)(random_bits(random) / 4294967296.0);
+}
+
+// A resting layer of spheres, each pressing on the ground and on its grid neighbours
+static unsigned int bench_reset(struct RigidBody* bodies, struct CollisionSphere* spheres, struct Contact* contacts) {
+  struct Random random;
+  random_seed(&random, 1);
+
+  for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++) {
+    struct RigidBody* body = &bodies[body_num];
+    memset(body, 0, sizeof(struct RigidBody));
+    rigid_body_set_mass(body, 1.0f);
+    rigid_body_set_inertia_tensor(body, (mat3){.data[0] = 0.4f, .data[4] = 0.4f, .data[8] = 0.4f});
+    body->position = (vec3){.x = (body_num % GRID_SIZE) * 0.99f, .y = 0.49f, .z = (body_num / GRID_SIZE) * 0.99f};
+    body->orientation = (quat){.data[3] = 1.0f};
+    body->velocity = (vec3){.x = bench_float(&random, -0.5f, 0.5f), .y = bench_float(&random, -0.5f, 0.5f), .z = bench_float(&random, -0.5f, 0.5f)};
+    rigid_body_set_acceleration_xyz(body, 0.0f, -9.8f, 0.0f);
+    body->last_frame_acceleration = body->acceleration;
+    rigid_body_set_awake(body, true);
+    rigid_body_calculate_derived_data(body);
+
+    spheres[body_num].radius = 0.5f;
+    spheres[body_num].collision_primitive.body = body;
+    spheres[body_num].collision_primitive.offset = (mat4){.data[0] = 1.0f, .data[5] = 1.0f, .data[10] = 1.0f, .data[15] = 1.0f};
+    collision_primitive_calculate_internals(&spheres[body_num].collision_primitive);
+  }
+
+  struct CollisionPlane plane = {.direction = (vec3){.y = 1.0f}, .offset = 0.0f};
+  struct CollisionData data = {.contact_array = contacts, .friction = 0.6f, .restitution = 0.0f, .tolerance = 0.1f};
+  collision_data_reset(&data, MAX_CONTACTS);
+  for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++) {
+    collision_detector_sphere_and_half_space(&spheres[body_num], &plane, &data);
+    if (body_num % GRID_SIZE + 1 < GRID_SIZE)
+      collision_detector_sphere_and_sphere(&spheres[body_num], &spheres[body_num + 1], &data);
+    if (body_num + GRID_SIZE < BODY_COUNT)
+      collision_detector_sphere_and_sphere(&spheres[body_num], &spheres[body_num + GRID_SIZE], &data);
+  }
+  return data.contact_count;
+}
+
+static double bench_seconds(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// One contact of the scalar solver, the same rows the packed kernel reads but one contact per
+// struct, with the velocities read from and written to the bodies themselves
+struct BenchScalarContact {
+  struct RigidBody* body[2];
+  vec3 direction[3];
+  vec3 angular[3][2];
+  vec3 inverse_angular[3][2];
+  float mass[3];
+  float bias[3];
+  float inverse_mass[2];
+  float target;
+  float friction;
+  vec3 accumulated;
+};
+
+static void bench_scalar_prepare(struct BenchScalarContact* scalar, struct Contact* contacts, unsigned int num_contacts) {
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    struct Contact* contact = &contacts[contact_num];
+    struct BenchScalarContact* row = &scalar[contact_num];
+    mat3 basis = contact->contact_to_world;
+    row->direction[0] = contact->contact_normal;
+    row->direction[1] = (vec3){.data[0] = basis.data[1], .data[1] = basis.data[4], .data[2] = basis.data[7]};
+    row->direction[2] = (vec3){.data[0] = basis.data[2], .data[1] = basis.data[5], .data[2] = basis.data[8]};
+
+    for (unsigned int b = 0; b < 2; b++) {
+      struct RigidBody* body = contact->body[b];
+      row->body[b] = (body && body->inverse_mass != 0.0f) ? body : NULL;
+      row->inverse_mass[b] = row->body[b] ? body->inverse_mass : 0.0f;
+    }
+
+    for (unsigned int r = 0; r < 3; r++) {
+      float inverse_mass = 0.0f;
+      row->bias[r] = 0.0f;
+      for (unsigned int b = 0; b < 2; b++) {
+        row->angular[r][b] = VEC3_ZERO;
+        row->inverse_angular[r][b] = VEC3_ZERO;
+        if (!row->body[b])
+          continue;
+        row->angular[r][b] = vec3_cross_product(contact->relative_contact_position[b], row->direction[r]);
+        row->inverse_angular[r][b] = mat3_transform(row->body[b]->inverse_inertia_tensor_world, row->angular[r][b]);
+        inverse_mass += row->inverse_mass[b] + vec3_dot(vec3_cross_product(row->inverse_angular[r][b], contact->relative_contact_position[b]), row->direction[r]);
+      }
+      row->mass[r] = inverse_mass > 0.0f ? 1.0f / inverse_mass : 0.0f;
+    }
+
+    row->target = contact->contact_velocity.data[0] + contact->desired_delta_velocity;
+    row->friction = contact->friction;
+    row->accumulated = VEC3_ZERO;
+  }
+}
+
+static inline float bench_scalar_row_velocity(struct BenchScalarContact* row, unsigned int r) {
+  float velocity = row->bias[r];
+  if (row->body[0])
+    velocity += vec3_dot(row->direction[r], row->body[0]->velocity) + vec3_dot(row->angular[r][0], row->body[0]->rotation);
+  if (row->body[1])
+    velocity -= vec3_dot(row->direction[r], row->body[1]->velocity) + vec3_dot(row->angular[r][1], row->body[1]->rotation);
+  return velocity;
+}
+
+static inline void bench_scalar_row_apply(struct BenchScalarContact* row, unsigned int r, float impulse) {
+  for (unsigned int b = 0; b < 2; b++) {
+    if (!row->body[b])
+      continue;
+    float sign = b ? -1.0f : 1.0f;
+    row->body[b]->velocity = vec3_add_scaled_vector(row->body[b]->velocity, row->direction[r], sign * impulse * row->inverse_mass[b]);
+    row->body[b]->rotation = vec3_add_scaled_vector(row->body[b]->rotation, row->inverse_angular[r][b], sign * impulse);
+  }
+}
+
+// Same projected Gauss-Seidel step as impulse_solver_solve_groups, one contact at a time
+static void bench_scalar_pass(struct BenchScalarContact* scalar, unsigned int num_contacts) {
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    struct BenchScalarContact* row = &scalar[contact_num];
+
+    float tangent[2];
+    for (unsigned int t = 0; t < 2; t++)
+      tangent[t] = row->accumulated.data[t + 1] - bench_scalar_row_velocity(row, t + 1) * row->mass[t + 1];
+
+    float max_friction = row->friction * row->accumulated.data[0];
+    float planar_impulse = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1]);
+    float scale = fminf(1.0f, max_friction / fmaxf(planar_impulse, FLT_MIN));
+    for (unsigned int t = 0; t < 2; t++) {
+      tangent[t] *= scale;
+      bench_scalar_row_apply(row, t + 1, tangent[t] - row->accumulated.data[t + 1]);
+      row->accumulated.data[t + 1] = tangent[t];
+    }
+
+    float normal = fmaxf(row->accumulated.data[0] + (row->target - bench_scalar_row_velocity(row, 0)) * row->mass[0], 0.0f);
+    bench_scalar_row_apply(row, 0, normal - row->accumulated.data[0]);
+    row->accumulated.data[0] = normal;
+  }
+}
+
+// Times only the passes, both solvers start from the same prepared contacts
+static double bench_scalar_passes(struct RigidBody* bodies, struct CollisionSphere* spheres, struct Contact* contacts, struct ContactResolver* resolver, float* total_impulse) {
+  struct BenchScalarContact* scalar = malloc(sizeof(struct BenchScalarContact) * MAX_CONTACTS);
+  double time = 0.0;
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++) {
+    unsigned int num_contacts = bench_reset(bodies, spheres, contacts);
+    contact_resolver_prepare_contacts(resolver, contacts, num_contacts, DURATION);
+    bench_scalar_prepare(scalar, contacts, num_contacts);
+
+    clock_t start = clock();
+    for (unsigned int pass = 0; pass < IMPULSE_SOLVER_ITERATIONS; pass++)
+      bench_scalar_pass(scalar, num_contacts);
+    time += bench_seconds(start);
+
+    *total_impulse = 0.0f;
+    for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+      *total_impulse += scalar[contact_num].accumulated.data[0];
+  }
+  free(scalar);
+  return time;
+}
+
+static double bench_packed_passes(struct RigidBody* bodies, struct CollisionSphere* spheres, struct Contact* contacts, struct ContactResolver* resolver, float* total_impulse) {
+  struct ContactGraph graph;
+  struct ImpulseSolver impulse_solver;
+  contact_graph_init(&graph);
+  impulse_solver_init(&impulse_solver);
+
+  double time = 0.0;
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++) {
+    unsigned int num_contacts = bench_reset(bodies, spheres, contacts);
+    contact_resolver_prepare_contacts(resolver, contacts, num_contacts, DURATION);
+    contact_graph_build(&graph, contacts, num_contacts);
+    impulse_solver_prepare(&impulse_solver, &graph, NULL, contacts, num_contacts, DURATION);
+
+    clock_t start = clock();
+    for (unsigned int pass = 0; pass < IMPULSE_SOLVER_ITERATIONS; pass++)
+      impulse_solver_iterate(&impulse_solver, NULL);
+    time += bench_seconds(start);
+
+    impulse_solver_finish(&impulse_solver, &graph, contacts);
+    *total_impulse = 0.0f;
+    for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+      *total_impulse += contacts[contact_num].accumulated_impulse.data[0];
+  }
+
+  impulse_solver_delete(&impulse_solver);
+  contact_graph_delete(&graph);
+  return time;
+}
+
+static double bench_velocity_pass(struct ContactResolver* resolver, struct RigidBody* bodies, struct CollisionSphere* spheres, struct Contact* contacts, unsigned int* num_contacts) {
+  double time = 0.0;
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++) {
+    *num_contacts = bench_reset(bodies, spheres, contacts);
+    contact_resolver_prepare_contacts(resolver, contacts, *num_contacts, DURATION);
+
+    clock_t start = clock();
+    contact_resolver_adjust_velocities(resolver, contacts, *num_contacts, DURATION);
+    time += bench_seconds(start);
+  }
+  return time;
+}
+
+int main(void) {
+  struct RigidBody* bodies = malloc(sizeof(struct RigidBody) * BODY_COUNT);
+  struct CollisionSphere* spheres = malloc(sizeof(struct CollisionSphere) * BODY_COUNT);
+  struct Contact* contacts = calloc(MAX_CONTACTS, sizeof(struct Contact));
+  unsigned int num_contacts = 0;
+
+  struct ContactResolver resolver;
+  contact_resolver_init(&resolver, 1, 1, 0.01f, 0.01f);
+  float scalar_impulse, packed_impulse;
+  double scalar_time = bench_scalar_passes(bodies, spheres, contacts, &resolver, &scalar_impulse);
+  double packed_time = bench_packed_passes(bodies, spheres, contacts, &resolver, &packed_impulse);
+
+  contact_resolver_set_mode(&resolver, CONTACT_RESOLVER_SEQUENTIAL_IMPULSE);
+  double impulse_time = bench_velocity_pass(&resolver, bodies, spheres, contacts, &num_contacts);
+
+  contact_resolver_set_mode(&resolver, CONTACT_RESOLVER_WORST_FIRST);
+  contact_resolver_set_iterations(&resolver, num_contacts * 4, num_contacts * 4);
+  double worst_first_time = bench_velocity_pass(&resolver, bodies, spheres, contacts, &num_contacts);
+  contact_resolver_delete(&resolver);
+
+  double solves = (double)num_contacts * FRAME_COUNT;
+  double passes = solves * IMPULSE_SOLVER_ITERATIONS;
+  printf("velocity pass, %u contacts x %d frames, %u lanes\n", num_contacts, FRAME_COUNT, rigid_body_get_batch_width());
+  printf("  scalar passes, one contact at a time: %8.3f ms  %8.2f ns/contact/pass  normal impulse %.3f\n", scalar_time * 1000.0, scalar_time * 1e9 / passes, scalar_impulse);
+  printf("  packed passes, a group at a time:     %8.3f ms  %8.2f ns/contact/pass  normal impulse %.3f\n", packed_time * 1000.0, packed_time * 1e9 / passes, packed_impulse);
+  printf("  packed speedup: %.2fx\n", packed_time > 0.0 ? scalar_time / packed_time : 0.0);
+  printf("  sequential impulse (%d passes): %8.3f ms  %8.2f ns/contact/pass\n", IMPULSE_SOLVER_ITERATIONS, impulse_time * 1000.0, impulse_time * 1e9 / (solves * IMPULSE_SOLVER_ITERATIONS));
+  printf("  worst first (4 per contact):    %8.3f ms  %8.2f ns/contact\n", worst_first_time * 1000.0, worst_first_time * 1e9 / solves);
+
+  free(contacts);
+  free(spheres);
+  free(bodies);
+
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "chaos/chaos.h"
+
+#define BODY_COUNT 20000
+#define FRAME_COUNT 200
+
+static void bench_reset(struct RigidBody* bodies, struct RigidBody** body_ptrs) {
+  struct Random random;
+  random_seed(&random, 1);
+
+  for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++) {
+    struct RigidBody* body = &bodies[body_num];
+    memset(body, 0, sizeof(struct RigidBody));
+    body->position = random_vector_scale(&random, 100.0f);
+    body->orientation = random_quaternion(&random);
+    rigid_body_set_inertia_tensor(body, (mat3){.data[0] = 2.0f, .data[4] = 3.0f, .data[8] = 4.0f});
+    body_ptrs[body_num] = body;
+  }
+}
+
+static double bench_seconds(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(void) {
+  struct RigidBody* bodies = malloc(sizeof(struct RigidBody) * BODY_COUNT);
+  struct RigidBody** body_ptrs = malloc(sizeof(struct RigidBody*) * BODY_COUNT);
+
+  bench_reset(bodies, body_ptrs);
+  clock_t start = clock();
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++)
+    for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++)
+      rigid_body_calculate_derived_data(body_ptrs[body_num]);
+  double scalar_time = bench_seconds(start);
+
+  bench_reset(bodies, body_ptrs);
+  start = clock();
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++)
+    rigid_body_calculate_derived_data_batch(body_ptrs, BODY_COUNT);
+  double batch_time = bench_seconds(start);
+
+  double updates = (double)BODY_COUNT * FRAME_COUNT;
+  printf("derived data, %d bodies x %d frames, %u lanes\n", BODY_COUNT, FRAME_COUNT, rigid_body_get_batch_width());
+  printf("  scalar: %8.3f ms  %8.2f ns/body\n", scalar_time * 1000.0, scalar_time * 1e9 / updates);
+  printf("  batch:  %8.3f ms  %8.2f ns/body\n", batch_time * 1000.0, batch_time * 1e9 / updates);
+  printf("  speedup: %.2fx\n", batch_time > 0.0 ? scalar_time / batch_time : 0.0);
+
+  free(body_ptrs);
+  free(bodies);
+
+  return 0;
+}
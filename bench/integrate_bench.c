@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "chaos/chaos.h"
+
+#define BODY_COUNT 20000
+#define FRAME_COUNT 200
+#define FRAME_DURATION (1.0f / 60.0f)
+
+// NOTE: random_random_float only yields floats with SINGLE_PRECISION defined, so they are made
+// from the bits here
+static float bench_float(struct Random* random, float min, float max) {
+  return min + (max - min) * (float)(random_bits(random) / 4294967296.0);
+}
+
+// Awake bodies that never sleep, under gravity and a small spin, so every frame integrates all
+// of them
+static void bench_reset(struct BodyPool* body_pool) {
+  struct Random random;
+  random_seed(&random, 1);
+  body_pool_clear(body_pool);
+
+  for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++) {
+    struct RigidBody added;
+    struct RigidBody* body = &added;
+    memset(body, 0, sizeof(struct RigidBody));
+    body->position = (vec3){.x = bench_float(&random, -100.0f, 100.0f), .y = bench_float(&random, -100.0f, 100.0f), .z = bench_float(&random, -100.0f, 100.0f)};
+    body->orientation = (quat){.data[0] = bench_float(&random, -1.0f, 1.0f), .data[1] = bench_float(&random, -1.0f, 1.0f), .data[2] = bench_float(&random, -1.0f, 1.0f), .data[3] = bench_float(&random, -1.0f, 1.0f)};
+    rigid_body_set_mass(body, 1.0f);
+    rigid_body_set_inertia_tensor(body, (mat3){.data[0] = 2.0f, .data[4] = 3.0f, .data[8] = 4.0f});
+    rigid_body_set_damping(body, 0.99f, 0.99f);
+    rigid_body_set_acceleration_xyz(body, 0.0f, -9.81f, 0.0f);
+    rigid_body_set_rotation_xyz(body, 0.1f, 0.2f, 0.3f);
+    rigid_body_set_can_sleep(body, false);
+    rigid_body_set_awake(body, true);
+    rigid_body_calculate_derived_data(body);
+    body_pool_add(body_pool, body);
+  }
+}
+
+// The same bodies owned by the caller, one allocation each and visited in shuffled order, as a
+// world that has added and removed bodies for a while would find them outside the pool
+static void bench_scatter(struct RigidBody** scattered, struct BodyPool* body_pool) {
+  struct Random random;
+  random_seed(&random, 2);
+
+  for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++)
+    scattered[body_num] = NULL;
+  for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++) {
+    unsigned int slot = random_bits(&random) % BODY_COUNT;
+    while (scattered[slot])
+      slot = (slot + 1) % BODY_COUNT;
+    scattered[slot] = malloc(sizeof(struct RigidBody));
+    *scattered[slot] = *body_pool->bodies[body_num];
+  }
+}
+
+static double bench_seconds(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// The scalar loops are what the world ran before the body pool, one rigid_body_integrate per
+// body, first over caller owned bodies and then over the pool's own storage
+int main(void) {
+  struct RigidBody** scattered = malloc(sizeof(struct RigidBody*) * BODY_COUNT);
+  struct BodyPool body_pool;
+  body_pool_init(&body_pool);
+
+  bench_reset(&body_pool);
+  bench_scatter(scattered, &body_pool);
+  clock_t start = clock();
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++)
+    for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++)
+      rigid_body_integrate(scattered[body_num], FRAME_DURATION);
+  double scattered_time = bench_seconds(start);
+
+  start = clock();
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++)
+    for (unsigned int body_num = 0; body_num < body_pool.size; body_num++)
+      rigid_body_integrate(body_pool.bodies[body_num], FRAME_DURATION);
+  double scalar_time = bench_seconds(start);
+  float scalar_height = body_pool.bodies[BODY_COUNT - 1]->position.y;
+
+  bench_reset(&body_pool);
+  start = clock();
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++)
+    body_pool_integrate(&body_pool, NULL, FRAME_DURATION, true);
+  double pool_time = bench_seconds(start);
+  float pool_height = body_pool.bodies[BODY_COUNT - 1]->position.y;
+
+  double updates = (double)BODY_COUNT * FRAME_COUNT;
+  printf("integrate, %d bodies x %d frames, %u lanes\n", BODY_COUNT, FRAME_COUNT, rigid_body_get_batch_width());
+  printf("  scalar, caller owned: %8.3f ms  %8.2f ns/body\n", scattered_time * 1000.0, scattered_time * 1e9 / updates);
+  printf("  scalar, pool owned:   %8.3f ms  %8.2f ns/body\n", scalar_time * 1000.0, scalar_time * 1e9 / updates);
+  printf("  body pool lanes:      %8.3f ms  %8.2f ns/body\n", pool_time * 1000.0, pool_time * 1e9 / updates);
+  printf("  speedup: %.2fx over caller owned, %.2fx over pool owned scalar\n", pool_time > 0.0 ? scattered_time / pool_time : 0.0, pool_time > 0.0 ? scalar_time / pool_time : 0.0);
+  printf("  last body height: %.4f scalar, %.4f pool\n", scalar_height, pool_height);
+
+  body_pool_delete(&body_pool);
+  for (unsigned int body_num = 0; body_num < BODY_COUNT; body_num++)
+    free(scattered[body_num]);
+  free(scattered);
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "chaos/chaos.h"
+
+#define FRAME_COUNT 120
+#define FRAME_DURATION (1.0f / 60.0f)
+#define SUBSTEP_COUNT 4
+#define VELOCITY_TOLERANCE 0.0001f
+
+struct FallResult {
+  vec3 body_velocity;
+  vec3 body_position;
+  vec3 link_velocity;
+};
+
+// A body pulled by a gravity force generator and a free articulation pushed through its stand
+// in body, both forces added once per frame before the step as a game would
+static struct FallResult bench_fall(unsigned int substeps) {
+  struct World world;
+  world_init(&world, 16, 4);
+  world_set_substeps(&world, substeps);
+
+  struct RigidBody body;
+  memset(&body, 0, sizeof(struct RigidBody));
+  rigid_body_set_mass(&body, 2.0f);
+  rigid_body_set_inertia_tensor(&body, (mat3){.data[0] = 1.0f, .data[4] = 1.0f, .data[8] = 1.0f});
+  rigid_body_set_damping(&body, 1.0f, 1.0f);
+  body.orientation = (quat){.data[3] = 1.0f};
+  rigid_body_set_can_sleep(&body, false);
+  rigid_body_set_awake(&body, true);
+  rigid_body_calculate_derived_data(&body);
+  struct RigidBody* falling = world_get_body(&world, world_add_body(&world, &body));
+
+  struct Articulation articulation;
+  articulation_init(&articulation, 1);
+  articulation_add_root(&articulation, ARTICULATION_JOINT_FREE, 3.0f, (mat3){.data[0] = 1.0f, .data[4] = 1.0f, .data[8] = 1.0f}, VEC3_ZERO, (quat){.data[3] = 1.0f});
+  articulation_set_gravity(&articulation, VEC3_ZERO);
+  world_add_articulation(&world, &articulation);
+
+  struct Gravity gravity;
+  gravity_init(&gravity, (vec3){.y = -9.81f});
+
+  for (unsigned int frame = 0; frame < FRAME_COUNT; frame++) {
+    world_start_frame(&world);
+    gravity_update_force(&gravity, falling, FRAME_DURATION);
+    rigid_body_add_force(articulation_get_body(&articulation, 0), (vec3){.x = 6.0f});
+    world_run_physics(&world, FRAME_DURATION);
+  }
+
+  struct FallResult result = {.body_velocity = falling->velocity, .body_position = falling->position, .link_velocity = articulation_get_body(&articulation, 0)->velocity};
+  articulation_delete(&articulation);
+  world_delete(&world);
+  return result;
+}
+
+// Forces must act over the whole step however it is split, so every substep count ends at the
+// same velocity. Positions differ by the integration error of the coarser step.
+int main(void) {
+  struct FallResult single = bench_fall(1);
+  struct FallResult split = bench_fall(SUBSTEP_COUNT);
+  float time = FRAME_COUNT * FRAME_DURATION;
+
+  printf("free fall over %.2f s, expected velocity %.4f\n", time, -9.81f * time);
+  printf("  1 substep:  body velocity %8.4f position %8.4f, articulation velocity %8.4f\n", single.body_velocity.y, single.body_position.y, single.link_velocity.x);
+  printf("  %u substeps: body velocity %8.4f position %8.4f, articulation velocity %8.4f\n", SUBSTEP_COUNT, split.body_velocity.y, split.body_position.y, split.link_velocity.x);
+
+  bool matches = fabsf(single.body_velocity.y - split.body_velocity.y) < VELOCITY_TOLERANCE * time && fabsf(single.link_velocity.x - split.link_velocity.x) < VELOCITY_TOLERANCE * time;
+  printf("  %s\n", matches ? "substeps match" : "MISMATCH");
+
+  return matches ? 0 : 1;
+}
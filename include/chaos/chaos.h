@@ -2,12 +2,25 @@
 #ifndef CHAOS_H
 #define CHAOS_H
 
+#include "chaos/core/aabbtree.h"
+#include "chaos/core/articulation.h"
 #include "chaos/core/body.h"
+#include "chaos/core/bodypool.h"
 #include "chaos/core/collidefine.h"
+#include "chaos/core/contactarena.h"
+#include "chaos/core/contactgraph.h"
 #include "chaos/core/contacts.h"
 #include "chaos/core/fgen.h"
+#include "chaos/core/impulse.h"
+#include "chaos/core/island.h"
+#include "chaos/core/jobs.h"
 #include "chaos/core/joints.h"
+#include "chaos/core/jointsolver.h"
+#include "chaos/core/manifold.h"
 #include "chaos/core/precision.h"
 #include "chaos/core/random.h"
+#include "chaos/core/spatialgrid.h"
+#include "chaos/core/sweepprune.h"
+#include "chaos/core/world.h"
 
 #endif  // CHAOS_H
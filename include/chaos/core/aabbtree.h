@@ -0,0 +1,100 @@
+#pragma once
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/body.h"
+#include "chaos/core/collidefine.h"
+
+#define AABB_TREE_NULL UINT_MAX
+#define AABB_TREE_MARGIN 0.1f
+
+// NOTE: Defined in collidecoarse.h, which only the callers reading pairs need
+struct PotentialContact;
+
+struct AABB {
+  vec3 min;
+  vec3 max;
+};
+
+static inline struct AABB aabb_union(struct AABB one, struct AABB two);
+static inline bool aabb_overlaps(struct AABB one, struct AABB two);
+static inline bool aabb_contains(struct AABB aabb, struct AABB other);
+static inline float aabb_surface_area(struct AABB aabb);
+struct AABB aabb_from_box(struct CollisionBox* box);
+struct AABB aabb_from_sphere(struct CollisionSphere* sphere);
+
+static inline struct AABB aabb_union(struct AABB one, struct AABB two) {
+  struct AABB aabb;
+  for (unsigned int i = 0; i < 3; i++) {
+    aabb.min.data[i] = one.min.data[i] < two.min.data[i] ? one.min.data[i] : two.min.data[i];
+    aabb.max.data[i] = one.max.data[i] > two.max.data[i] ? one.max.data[i] : two.max.data[i];
+  }
+  return aabb;
+}
+
+static inline bool aabb_overlaps(struct AABB one, struct AABB two) {
+  for (unsigned int i = 0; i < 3; i++)
+    if (one.max.data[i] < two.min.data[i] || two.max.data[i] < one.min.data[i])
+      return false;
+  return true;
+}
+
+static inline bool aabb_contains(struct AABB aabb, struct AABB other) {
+  for (unsigned int i = 0; i < 3; i++)
+    if (other.min.data[i] < aabb.min.data[i] || other.max.data[i] > aabb.max.data[i])
+      return false;
+  return true;
+}
+
+static inline float aabb_surface_area(struct AABB aabb) {
+  vec3 size = vec3_sub(aabb.max, aabb.min);
+  return 2.0f * (size.data[0] * size.data[1] + size.data[1] * size.data[2] + size.data[2] * size.data[0]);
+}
+
+// A leaf has no children and a body, parent links the free list while the node is unused
+struct AABBTreeNode {
+  struct AABB aabb;
+  struct RigidBody* body;
+  unsigned int parent;
+  unsigned int children[2];
+  int height;
+};
+
+// Dynamic bounding volume tree over axis aligned boxes. Leaves store their box grown by margin
+// on every side, so a body that moves less than that keeps its leaf and costs nothing. One
+// that leaves its fat box is removed and reinserted next to the sibling that grows the surface
+// area least. Nodes live in one array linked by index, proxies are leaf indices and stay valid
+// until removed.
+//
+// After each insert or remove the ancestors are refit and rebalanced by rotations, walking up
+// only while their boxes or heights change. Pairs are reported from the fat boxes in the
+// PotentialContact format, each overlapping pair once.
+struct AABBTree {
+  unsigned int root;
+  unsigned int node_count;
+  unsigned int node_capacity;
+  struct AABBTreeNode* nodes;
+  unsigned int free_list;
+  unsigned int leaf_count;
+  float margin;
+
+  unsigned int stack_capacity;
+  unsigned int* stack;
+};
+
+void aabb_tree_init(struct AABBTree* aabb_tree, float margin);
+void aabb_tree_delete(struct AABBTree* aabb_tree);
+unsigned int aabb_tree_insert(struct AABBTree* aabb_tree, struct RigidBody* body, struct AABB aabb);
+void aabb_tree_remove(struct AABBTree* aabb_tree, unsigned int proxy);
+bool aabb_tree_move(struct AABBTree* aabb_tree, unsigned int proxy, struct AABB aabb);
+struct AABB aabb_tree_get_fat_aabb(struct AABBTree* aabb_tree, unsigned int proxy);
+int aabb_tree_get_height(struct AABBTree* aabb_tree);
+unsigned int aabb_tree_get_potential_contacts(struct AABBTree* aabb_tree, struct PotentialContact* contacts, unsigned int limit, unsigned int* needed);
+
+#endif  // AABB_TREE_H
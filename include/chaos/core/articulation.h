@@ -0,0 +1,117 @@
+#pragma once
+#ifndef ARTICULATION_H
+#define ARTICULATION_H
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/body.h"
+
+#define ARTICULATION_NO_LINK UINT_MAX
+#define ARTICULATION_SPATIAL_FLOATS 36
+#define ARTICULATION_REGULARISE 1e-6f
+#define ARTICULATION_MAX_STEP_ANGLE 0.1f
+#define ARTICULATION_MAX_SUBSTEPS 16
+#define ARTICULATION_MAX_JOINT_SPEED 100.0f
+
+enum ArticulationJointType {
+  ARTICULATION_JOINT_FIXED = 0,
+  ARTICULATION_JOINT_REVOLUTE,
+  ARTICULATION_JOINT_PRISMATIC,
+  ARTICULATION_JOINT_FREE
+};
+
+// Angular part then linear part. Motion vectors hold the velocity of the body point passing
+// through the articulation's origin, force vectors the moment about it. Spatial matrices are
+// 6x6 row major arrays in the same order.
+struct SpatialVector {
+  vec3 angular;
+  vec3 linear;
+};
+
+// One rigid link and the joint to its parent. Anchors are in the parent's and the link's own
+// space, the axis in the parent's space, and the link's origin is its centre of mass. The
+// joint coordinate is an angle around the axis for a revolute joint and a distance along it
+// for a prismatic one. Joint damping is taken implicitly, so any amount of it stays stable.
+//
+// body is a stand in for collision detection and contacts. It is rewritten from the
+// articulation every step, so generators can point at it like at any other body, but it is
+// never added to a BodyPool. Its inverse mass and inertia are the link's response inside the
+// articulation, not the link's own.
+struct ArticulationLink {
+  unsigned int parent;
+  enum ArticulationJointType joint_type;
+  vec3 parent_anchor;
+  vec3 child_anchor;
+  vec3 axis;
+  float mass;
+  mat3 inertia;
+  float position;
+  float velocity;
+  float force;
+  float damping;
+  struct RigidBody body;
+
+  // Recomputed every step in world space about the origin
+  vec3 external_force;
+  vec3 external_torque;
+  quat orientation;
+  mat4 transform;
+  vec3 center;
+  struct SpatialVector motion;
+  struct SpatialVector spatial_velocity;
+  struct SpatialVector bias_acceleration;
+  struct SpatialVector bias_force;
+  struct SpatialVector projected_inertia;
+  struct SpatialVector acceleration;
+  float projected_mass;
+  float projected_force;
+  float acceleration_joint;
+  float articulated_inertia[ARTICULATION_SPATIAL_FLOATS];
+  float response[ARTICULATION_SPATIAL_FLOATS];
+
+  vec3 written_position;
+  quat written_orientation;
+  vec3 written_velocity;
+  vec3 written_rotation;
+};
+
+// A tree of links solved in reduced coordinates with the articulated body algorithm, linear in
+// the link count and free of joint drift. Parents come before their children, link zero is the
+// root, fixed in place or free to move. The link array is allocated once so the stand in
+// bodies never move.
+//
+// articulation_integrate runs forward dynamics and moves the links. Contacts then change the
+// stand in bodies like any others, and articulation_apply_contacts turns those changes back
+// into impulses, and position changes into pseudo impulses, pushed through the tree.
+struct Articulation {
+  unsigned int link_count;
+  unsigned int link_capacity;
+  struct ArticulationLink* links;
+  vec3 gravity;
+  vec3 origin;
+
+  vec3 root_position;
+  quat root_orientation;
+  vec3 root_velocity;
+  vec3 root_rotation;
+};
+
+void articulation_init(struct Articulation* articulation, unsigned int link_capacity);
+void articulation_delete(struct Articulation* articulation);
+unsigned int articulation_add_root(struct Articulation* articulation, enum ArticulationJointType joint_type, float mass, mat3 inertia, vec3 position, quat orientation);
+unsigned int articulation_add_link(struct Articulation* articulation, unsigned int parent, enum ArticulationJointType joint_type, float mass, mat3 inertia, vec3 parent_anchor, vec3 child_anchor, vec3 axis);
+struct RigidBody* articulation_get_body(struct Articulation* articulation, unsigned int link);
+void articulation_set_gravity(struct Articulation* articulation, vec3 gravity);
+void articulation_set_joint_force(struct Articulation* articulation, unsigned int link, float force);
+void articulation_set_joint_damping(struct Articulation* articulation, unsigned int link, float damping);
+void articulation_update_bodies(struct Articulation* articulation);
+void articulation_integrate(struct Articulation* articulation, float duration, bool clear_accumulators);
+void articulation_apply_contacts(struct Articulation* articulation);
+
+#endif  // ARTICULATION_H
@@ -21,6 +21,8 @@ struct RigidBody {
   float motion;
   bool is_awake;
   bool can_sleep;
+  bool is_dirty;
+  unsigned int island_index;
   mat4 transform_matrix;
   vec3 force_accum;
   vec3 torque_accum;
@@ -31,7 +33,12 @@ struct RigidBody {
 mat3 rigid_body_transform_inertia_tensor(mat3 iit_body, mat4 rotmat);
 mat4 rigid_body_calculate_transform_matrix(vec3 position, quat orientation);
 void rigid_body_calculate_derived_data(struct RigidBody* rigid_body);
+// Lanes every batched kernel was built with, which only the library's own build flags decide
+unsigned int rigid_body_get_batch_width(void);
+void rigid_body_calculate_derived_data_batch(struct RigidBody** bodies, unsigned int count);
 void rigid_body_integrate(struct RigidBody* rigid_body, float duration);
+void rigid_body_update_motion(struct RigidBody* rigid_body, float duration);
+void rigid_body_update_sleep_state(struct RigidBody* rigid_body, float duration);
 void rigid_body_set_mass(struct RigidBody* rigid_body, float mass);
 float rigid_body_get_mass(struct RigidBody* rigid_body);
 void rigid_body_set_inverse_mass(struct RigidBody* rigid_body, float inverse_mass);
@@ -52,6 +59,7 @@ void rigid_body_add_velocity(struct RigidBody* rigid_body, vec3 delta_velocity);
 void rigid_body_set_rotation_xyz(struct RigidBody* rigid_body, float x, float y, float z);
 void rigid_body_add_rotation(struct RigidBody* rigid_body, vec3 delta_rotation);
 void rigid_body_set_awake(struct RigidBody* rigid_body, bool awake);
+void rigid_body_mark_dirty(struct RigidBody* rigid_body);
 void rigid_body_set_can_sleep(struct RigidBody* rigid_body, bool can_sleep);
 void rigid_body_clear_accumulators(struct RigidBody* rigid_body);
 void rigid_body_add_force(struct RigidBody* rigid_body, vec3 force);
@@ -60,9 +68,4 @@ void rigid_body_add_force_at_point(struct RigidBody* rigid_body, vec3 force, vec
 void rigid_body_add_torque(struct RigidBody* rigid_body, vec3 torque);
 void rigid_body_set_acceleration_xyz(struct RigidBody* rigid_body, float x, float y, float z);
 
-struct BodyRegistration {
-  struct RigidBody* body;
-  struct BodyRegistration* next;
-};
-
 #endif  // BODY_H
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef BODY_POOL_H
+#define BODY_POOL_H
+
+#include <limits.h>
+#include <stdlib.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/body.h"
+#include "chaos/core/jobs.h"
+
+#define BODY_POOL_INIT_CAPACITY 64
+#define BODY_POOL_RESIZE_FACTOR 2
+#define BODY_POOL_CHUNK_SIZE 256
+#define BODY_POOL_BATCH_SIZE 64
+#define BODY_POOL_BLOCK_SIZE 256
+#define BODY_POOL_NO_SLOT UINT_MAX
+
+// Handles stay valid until their body is removed, after which the slot generation moves on
+// and lookups through the stale handle return NULL
+struct BodyHandle {
+  unsigned int slot;
+  unsigned int generation;
+};
+
+// Live slots hold the body's dense index, free slots hold the next free slot. A slot is also
+// where its body is stored, so a freed slot's storage goes to the next body added.
+struct BodySlot {
+  unsigned int index;
+  unsigned int generation;
+};
+
+// The pool owns the bodies. Adding copies a body into the pool's storage, blocks of
+// BODY_POOL_BLOCK_SIZE bodies that are allocated as the slots run out and never move, so a
+// body's struct RigidBody* stays valid until it is removed and bodies added together sit next
+// to each other in memory. The handle is the reference to keep, the pointer is what colliders,
+// joints and contacts hold while the body lives. bodies is the packed array of the live
+// bodies in dense index order that every per-body loop runs over. Awake bodies are also
+// gathered into the structure-of-arrays lanes each step so the integrator runs SIMD_WIDTH
+// bodies at once, then written back.
+struct BodyPool {
+  unsigned int size;
+  unsigned int capacity;
+  struct RigidBody** bodies;
+  unsigned int* body_slot;
+
+  unsigned int slot_count;
+  unsigned int free_slot;
+  struct BodySlot* slots;
+  unsigned int block_count;
+  struct RigidBody** blocks;
+
+  unsigned int lane_count;
+  unsigned int lane_capacity;
+  unsigned int lane_stride;
+  struct RigidBody** lane_body;
+  float* lane_data;
+  float* inverse_mass;
+  float* linear_damping;
+  float* angular_damping;
+  float* position[3];
+  float* orientation[4];
+  float* velocity[3];
+  float* rotation[3];
+  float* force_accum[3];
+  float* torque_accum[3];
+  float* acceleration[3];
+  float* last_frame_acceleration[3];
+  float* inverse_inertia_tensor_world[9];
+
+  unsigned int chunk_capacity;
+  unsigned int* chunk_lane;
+};
+
+void body_pool_init(struct BodyPool* body_pool);
+void body_pool_delete(struct BodyPool* body_pool);
+struct BodyHandle body_pool_add(struct BodyPool* body_pool, const struct RigidBody* body);
+bool body_pool_remove(struct BodyPool* body_pool, struct BodyHandle handle);
+void body_pool_clear(struct BodyPool* body_pool);
+bool body_pool_is_valid(struct BodyPool* body_pool, struct BodyHandle handle);
+struct RigidBody* body_pool_get(struct BodyPool* body_pool, struct BodyHandle handle);
+unsigned int body_pool_get_index(struct BodyPool* body_pool, struct BodyHandle handle);
+void body_pool_calculate_derived_data(struct BodyPool* body_pool, struct JobScheduler* scheduler);
+void body_pool_gather(struct BodyPool* body_pool, struct JobScheduler* scheduler, float duration);
+void body_pool_integrate_lanes(struct BodyPool* body_pool, unsigned int first_lane, unsigned int last_lane, float duration);
+void body_pool_scatter(struct BodyPool* body_pool, unsigned int first_lane, unsigned int last_lane, float duration, bool clear_accumulators);
+void body_pool_integrate(struct BodyPool* body_pool, struct JobScheduler* scheduler, float duration, bool clear_accumulators);
+
+#endif  // BODY_POOL_H
@@ -1,10 +1,17 @@
+#pragma once
 #ifndef COLLIDE_COARSE_H
 #define COLLIDE_COARSE_H
 
 #include <math.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "chaos/core/contacts.h"
+#include "chaos/core/jobs.h"
+
+#define BVH_NULL UINT32_MAX
+#define BVH_TREE_TASK_TARGET 256
+#define BVH_TREE_LEAF_PAIR UINT_MAX
 
 struct BoundingSphere {
   vec3 centre;
@@ -17,24 +24,111 @@ static inline bool bounding_sphere_overlaps(struct BoundingSphere* bounding_sphe
 static inline float bounding_sphere_get_growth(struct BoundingSphere* bounding_sphere, struct BoundingSphere* other);
 static inline float bounding_sphere_get_size(struct BoundingSphere* bounding_sphere);
 
+static inline void bounding_sphere_init(struct BoundingSphere* bounding_sphere, vec3 centre, float radius) {
+  bounding_sphere->centre = centre;
+  bounding_sphere->radius = radius;
+}
+
+static inline void bounding_sphere_init_two(struct BoundingSphere* bounding_sphere, struct BoundingSphere* one, struct BoundingSphere* two) {
+  vec3 centre_offset;
+  centre_offset = vec3_sub(two->centre, one->centre);
+  float distance = vec3_square_magnitude(centre_offset);
+  float radius_diff = two->radius - one->radius;
+
+  if (radius_diff * radius_diff >= distance) {
+    if (one->radius > two->radius) {
+      bounding_sphere->centre = one->centre;
+      bounding_sphere->radius = one->radius;
+    } else {
+      bounding_sphere->centre = two->centre;
+      bounding_sphere->radius = two->radius;
+    }
+  }
+
+  else {
+    distance = sqrtf(distance);
+    bounding_sphere->radius = (distance + one->radius + two->radius) * 0.5f;
+
+    bounding_sphere->centre = one->centre;
+    if (distance > 0)
+      bounding_sphere->centre = vec3_add(bounding_sphere->centre, vec3_scale(centre_offset, ((bounding_sphere->radius - one->radius) / distance)));
+  }
+}
+
+static inline bool bounding_sphere_overlaps(struct BoundingSphere* bounding_sphere, struct BoundingSphere* other) {
+  float distance_squared = vec3_square_magnitude(vec3_sub(bounding_sphere->centre, other->centre));
+  return distance_squared < (bounding_sphere->radius + other->radius) * (bounding_sphere->radius + other->radius);
+}
+
+static inline float bounding_sphere_get_growth(struct BoundingSphere* bounding_sphere, struct BoundingSphere* other) {
+  struct BoundingSphere new_sphere;
+  bounding_sphere_init_two(&new_sphere, bounding_sphere, other);
+
+  return new_sphere.radius * new_sphere.radius - bounding_sphere->radius * bounding_sphere->radius;
+}
+
+static inline float bounding_sphere_get_size(struct BoundingSphere* bounding_sphere) {
+  return 1.333333f * UM_PI * bounding_sphere->radius * bounding_sphere->radius * bounding_sphere->radius;
+}
+
 struct PotentialContact {
   struct RigidBody* body[2];
 };
 
+// A leaf has a body and no children, parent links the free list while the node is unused
 struct BVHNode {
-  struct BVHNode* children[2];
-  struct BoundingSphere* volume;
+  struct BoundingSphere volume;
   struct RigidBody* body;
-  struct BVHNode* parent;
+  uint32_t parent;
+  uint32_t children[2];
+};
+
+// A node pair whose pairs one thread finds, and where in its buffer they went
+struct BVHTask {
+  uint32_t node[2];
+  unsigned int thread_index;
+  unsigned int offset;
+  unsigned int count;
+};
+
+struct BVHThreadPairs {
+  unsigned int count;
+  unsigned int capacity;
+  struct PotentialContact* pairs;
+  uint32_t stack_capacity;
+  uint32_t* stack;
+};
+
+// Bounding sphere hierarchy with every node in one pool, linked by 32 bit indices. Freed nodes
+// go on a free list and are reused, so inserting and removing only allocate when the pool
+// grows and deleting the tree is a single free. Proxies are leaf indices and stay valid until
+// removed.
+struct BVHTree {
+  uint32_t root;
+  uint32_t node_count;
+  uint32_t node_capacity;
+  struct BVHNode* nodes;
+  uint32_t free_list;
+  uint32_t leaf_count;
+
+  unsigned int task_count;
+  unsigned int task_capacity;
+  struct BVHTask* tasks;
+  struct BVHTask* next_tasks;
+  unsigned int thread_pairs_count;
+  struct BVHThreadPairs* thread_pairs;
+  unsigned int pair_count;
+  unsigned int pair_capacity;
+  struct PotentialContact* pairs;
 };
 
-static inline void bvh_node_init(struct BVHNode* bvh_node, struct BVHNode* parent, struct BoundingSphere* volume, struct RigidBody* body);
-static inline void bvh_node_delete(struct BVHNode* bvh_node);
-static inline bool bvh_node_is_leaf(struct BVHNode* bvh_node);
-static inline bool bvh_node_overlaps(struct BVHNode* bvh_node, struct BVHNode* other);
-static inline void bvh_node_insert(struct BVHNode* bvh_node, struct RigidBody* new_body, struct BoundingSphere* new_volume);
-static inline void bvh_node_recalculate_bounding_volume(struct BVHNode* bvh_node, bool recurse);
-static inline unsigned int bvh_node_get_potential_contacts(struct BVHNode* bvh_node, struct PotentialContact* contacts, unsigned int limit);
-static inline unsigned int bvh_node_get_potential_contacts_with(struct BVHNode* bvh_node, struct BVHNode* other, struct PotentialContact* contacts, unsigned int limit);
+void bvh_tree_init(struct BVHTree* bvh_tree, uint32_t node_capacity);
+void bvh_tree_delete(struct BVHTree* bvh_tree);
+void bvh_tree_clear(struct BVHTree* bvh_tree);
+uint32_t bvh_tree_insert(struct BVHTree* bvh_tree, struct RigidBody* body, struct BoundingSphere volume);
+void bvh_tree_remove(struct BVHTree* bvh_tree, uint32_t proxy);
+void bvh_tree_move(struct BVHTree* bvh_tree, uint32_t proxy, struct BoundingSphere volume);
+unsigned int bvh_tree_find_pairs(struct BVHTree* bvh_tree, struct JobScheduler* scheduler);
+unsigned int bvh_tree_get_potential_contacts(struct BVHTree* bvh_tree, struct PotentialContact* contacts, unsigned int limit, unsigned int* needed);
 
 #endif  // COLLIDE_COARSE_H
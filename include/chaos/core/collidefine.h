@@ -2,11 +2,22 @@
 #ifndef COLLIDE_FINE_H
 #define COLLIDE_FINE_H
 
+#include <float.h>
 #include <memory.h>
+#include <stdbool.h>
 #include <ubermath/ubermath.h>
 
 #include "chaos/core/contacts.h"
 
+// Separating axes of two boxes: one's faces, two's faces, then one's edge i crossed with two's
+// edge j at 6 + i * 3 + j, padded to a whole number of SIMD registers
+#define COLLISION_BOX_AXES 15
+#define COLLISION_BOX_AXIS_LANES 16
+// Edge cross products shorter than this squared come from near parallel edges and are skipped
+#define COLLISION_BOX_PARALLEL 0.0001f
+// An edge axis has to beat the best face axis by this factor, so resting boxes keep face contacts
+#define COLLISION_BOX_EDGE_BIAS 0.95f
+
 struct CollisionPrimitive {
   struct RigidBody* body;
   mat4 offset;
@@ -36,14 +47,19 @@ bool intersection_test_sphere_and_sphere(struct CollisionSphere* one, struct Col
 bool intersection_test_box_and_box(struct CollisionBox* one, struct CollisionBox* two);
 bool intersection_test_box_and_half_space(struct CollisionBox* box, struct CollisionPlane* plane);
 
+// contacts_needed counts every contact the detectors found, also those they had no room for,
+// for generators to report back as needed. With skip_sleeping set the detectors return straight
+// away for pairs where no body is awake, whose contacts the world would only drop.
 struct CollisionData {
   struct Contact* contact_array;
   struct Contact* contacts;
   int contacts_left;
   unsigned int contact_count;
+  unsigned int contacts_needed;
   float friction;
   float restitution;
   float tolerance;
+  bool skip_sleeping;
 };
 
 bool collision_data_has_more_contacts(struct CollisionData* collision_data);
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef CONTACT_ARENA_H
+#define CONTACT_ARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chaos/core/contacts.h"
+
+#define CONTACT_ARENA_MIN_CHUNK 256
+
+struct ContactChunk {
+  struct Contact* contacts;
+  unsigned int capacity;
+  unsigned int size;
+};
+
+// Contact storage for one step. Spans are handed out from the last chunk, and a span that does
+// not fit opens a new chunk at least as large as all the others together, so contacts already
+// written never move while the step runs. Flattening folds the chunks into one, which a steady
+// scene then keeps, so it only copies in steps where the arena grew.
+//
+// high_water is the most contacts committed in any one step, for sizing the arena up front.
+struct ContactArena {
+  unsigned int chunk_count;
+  unsigned int chunk_capacity;
+  struct ContactChunk* chunks;
+  unsigned int size;
+  unsigned int capacity;
+  unsigned int high_water;
+};
+
+void contact_arena_init(struct ContactArena* contact_arena, unsigned int capacity);
+void contact_arena_delete(struct ContactArena* contact_arena);
+void contact_arena_reserve(struct ContactArena* contact_arena, unsigned int capacity);
+void contact_arena_reset(struct ContactArena* contact_arena);
+struct Contact* contact_arena_begin(struct ContactArena* contact_arena, unsigned int count, unsigned int* limit);
+void contact_arena_commit(struct ContactArena* contact_arena, unsigned int count);
+struct Contact* contact_arena_flatten(struct ContactArena* contact_arena);
+
+#endif  // CONTACT_ARENA_H
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef CONTACT_GRAPH_H
+#define CONTACT_GRAPH_H
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/body.h"
+
+#define CONTACT_GRAPH_MAX_COLORS 64
+#define CONTACT_GRAPH_NO_BODY UINT_MAX
+
+struct Contact;
+
+// Indexes the movable bodies of a contact array so the resolvers can find the contacts
+// touching a body without scanning. Bodies with infinite mass (and missing bodies) are left
+// out, nothing the resolvers do can move them.
+//
+// The greedy coloring puts no two contacts sharing a movable body in one color, so a ground
+// plane does not serialize everything resting on it. Contacts are ordered by color and keep
+// their original order inside a color, contacts that found no free color among
+// CONTACT_GRAPH_MAX_COLORS are placed last and have to be resolved one at a time.
+struct ContactGraph {
+  unsigned int contact_count;
+  unsigned int contact_capacity;
+  unsigned int* order;
+  unsigned int* contact_color;
+  unsigned int* contact_body;
+  unsigned int* contact_visit;
+  unsigned int visit;
+  unsigned int* neighbours;
+
+  unsigned int color_count;
+  unsigned int color_start[CONTACT_GRAPH_MAX_COLORS + 1];
+
+  unsigned int body_count;
+  unsigned int table_capacity;
+  struct RigidBody** table_body;
+  unsigned int* table_index;
+  struct RigidBody** bodies;
+  unsigned int* body_contact_start;
+  unsigned int* body_contacts;
+  uint64_t* body_colors;
+  vec3* body_linear_change;
+  vec3* body_angular_change;
+};
+
+void contact_graph_init(struct ContactGraph* contact_graph);
+void contact_graph_delete(struct ContactGraph* contact_graph);
+unsigned int contact_graph_find_body(struct ContactGraph* contact_graph, struct RigidBody* body);
+void contact_graph_index_bodies(struct ContactGraph* contact_graph, struct Contact* contacts, unsigned int num_contacts);
+void contact_graph_build_adjacency(struct ContactGraph* contact_graph);
+unsigned int contact_graph_gather_neighbours(struct ContactGraph* contact_graph, unsigned int contact_index);
+void contact_graph_build(struct ContactGraph* contact_graph, struct Contact* contacts, unsigned int num_contacts);
+
+// Indexed max-heap over per-contact keys. Equal keys come out lowest index first, which is
+// the contact a linear scan for the largest key would have picked.
+struct ContactHeap {
+  unsigned int size;
+  unsigned int capacity;
+  unsigned int* heap;
+  unsigned int* position;
+  float* key;
+};
+
+void contact_heap_init(struct ContactHeap* contact_heap);
+void contact_heap_delete(struct ContactHeap* contact_heap);
+void contact_heap_reset(struct ContactHeap* contact_heap, unsigned int count);
+void contact_heap_build(struct ContactHeap* contact_heap);
+unsigned int contact_heap_top(struct ContactHeap* contact_heap);
+void contact_heap_update(struct ContactHeap* contact_heap, unsigned int index, float key);
+
+#endif  // CONTACT_GRAPH_H
@@ -3,12 +3,24 @@
 #define CONTACTS_H
 
 #include <assert.h>
+#include <limits.h>
 #include <memory.h>
+#include <time.h>
 #include <ubermath/ubermath.h>
 
 #include "chaos/core/body.h"
+#include "chaos/core/contactgraph.h"
+#include "chaos/core/impulse.h"
+#include "chaos/core/island.h"
+#include "chaos/core/jobs.h"
+#include "chaos/core/jointsolver.h"
 
 #define VELOCITY_LIMIT 0.25f
+#define CONTACT_RESOLVER_GRAIN 64
+#define CONTACT_RESOLVER_LARGE_ISLAND 1024
+#define CONTACT_RESOLVER_NO_ISLAND UINT_MAX
+#define CONTACT_RESOLVER_CLOCK_INTERVAL 16
+#define CONTACT_RESOLVER_POSITION_SHARE 0.5f
 
 struct Contact {
   struct RigidBody* body[2];
@@ -21,6 +33,14 @@ struct Contact {
   vec3 contact_velocity;
   float desired_delta_velocity;
   vec3 relative_contact_position[2];
+  // Identifies the touching features of the pair, so a contact can be matched across frames
+  unsigned int feature;
+  // Normal and tangent impulse in contact coordinates, set by the sequential impulse mode
+  vec3 accumulated_impulse;
+  // Where the contact sat on each body when anchored, in body space or in world space without
+  // a body, and the penetration then, so substeps can follow the bodies without new detection
+  vec3 local_position[2];
+  float anchor_penetration;
 };
 
 void contact_set_body_data(struct Contact* contact, struct RigidBody* one, struct RigidBody* two, float friction, float restitution);
@@ -34,33 +54,149 @@ void contact_apply_velocity_change(struct Contact* contact, vec3 velocity_change
 vec3 contact_calculate_frictionless_impulse(struct Contact* contact, mat3 inverse_inertia_tensor[2]);
 vec3 contact_calculate_friction_impulse(struct Contact* contact, mat3* inverse_inertia_tensor);
 void contact_apply_position_change(struct Contact* contact, vec3 linear_change[2], vec3 angular_change[2], float penetration);
+void contact_store_anchors(struct Contact* contact);
+void contact_follow_anchors(struct Contact* contact);
 
+// Worst first resolves the single most violated contact per iteration. Graph colored sweeps
+// over the contact graph one color at a time and resolves every contact of a color in
+// parallel, since they share no movable body. Either way the iteration counts bound how many
+// contacts get resolved, and the colored result does not depend on the thread count.
+// Sequential impulse replaces the velocity pass with the warm started ImpulseSolver, which
+// runs impulse_iterations passes, penetration is still resolved worst first.
+enum ContactResolverMode {
+  CONTACT_RESOLVER_WORST_FIRST = 0,
+  CONTACT_RESOLVER_GRAPH_COLORED,
+  CONTACT_RESOLVER_SEQUENTIAL_IMPULSE
+};
+
+// Scratch for solving one set of contacts, the resolver keeps one per scheduler thread
+struct ContactResolverWorkspace {
+  struct ContactGraph graph;
+  struct ContactHeap heap;
+  struct ImpulseSolver impulse_solver;
+};
+
+// Contacts linked through movable bodies, stored from first in the resolved contact array.
+// The errors are the largest desired velocity change and penetration left once the passes
+// stopped, out_of_time is set when the time budget stopped them.
+struct ContactIsland {
+  unsigned int first;
+  unsigned int count;
+  unsigned int velocity_iterations_used;
+  unsigned int position_iterations_used;
+  float velocity_error;
+  float position_error;
+  bool out_of_time;
+};
+
+// Resolving splits the contacts into islands and reorders them island by island. Each island
+// gets its own iteration budget, iterations_per_contact times its contact count when that is
+// set and the fixed counts otherwise, and stops on its own. Small islands are solved as
+// parallel tasks, islands of CONTACT_RESOLVER_LARGE_ISLAND contacts or more one at a time with
+// the scheduler working inside them. The used counts are summed over the islands, apart from
+// the impulse passes, which run once over all of them.
+//
+// A non-zero time_budget in seconds caps the wall clock time of a resolve on top of the
+// iteration counts. The position passes may use up to CONTACT_RESOLVER_POSITION_SHARE of it
+// and the velocity passes get the rest, the islands go in order of their worst penetration
+// and each pass keeps working on its worst contact first, so a cut mostly leaves small
+// errors behind. Preparing the contacts is never cut short, so the budget needs room for it.
+// The errors left are the maximum over the islands.
+//
+// Joints are solved with the contacts' velocities. In sequential impulse mode they share the
+// impulse passes with the contacts, the other modes run impulse_iterations joint passes once
+// the contacts are resolved, within what is left of the velocity budget.
+//
+// resolve_substep resolves the same contacts again over the substeps of a step. The first
+// substep builds the islands, which reorders the contacts, and in sequential impulse mode
+// colors and packs them into impulse_workspace. Later substeps keep both and only refresh the
+// contact internals, the penetrations and the packed bias and target, warm starting from the
+// previous substep. The impulse cache is written by the last substep. In between the caller
+// may move the bodies and contact points but not add, remove or reorder contacts.
 struct ContactResolver {
+  enum ContactResolverMode mode;
+  struct JobScheduler* scheduler;
   unsigned int velocity_iterations;
   unsigned int position_iterations;
+  unsigned int iterations_per_contact;
   float velocity_epsilon;
   float position_epsilon;
   unsigned int velocity_iterations_used;
   unsigned int position_iterations_used;
+
+  float time_budget;
+  double position_deadline;
+  double velocity_deadline;
+  float velocity_error;
+  float position_error;
+  bool out_of_time;
+
+  unsigned int impulse_iterations;
+  bool warm_starting;
+  struct ImpulseCache impulse_cache;
+
+  struct JointConstraint* joints;
+  unsigned int joint_count;
+  struct JointSolver joint_solver;
+
+  unsigned int workspace_count;
+  struct ContactResolverWorkspace* workspaces;
+  struct ContactResolverWorkspace impulse_workspace;
+
+  struct IslandBuilder island_builder;
+  unsigned int island_count;
+  unsigned int island_capacity;
+  struct ContactIsland* islands;
+  unsigned int root_capacity;
+  unsigned int* root_island;
+  unsigned int contact_capacity;
+  unsigned int* contact_island;
+  struct Contact* island_contacts;
 };
 
 void contact_resolver_init(struct ContactResolver* contact_resolver, unsigned int velocity_iterations, unsigned int position_iterations, float velocity_epsilon, float position_epsilon);
+void contact_resolver_delete(struct ContactResolver* contact_resolver);
 bool contact_resolver_is_valid(struct ContactResolver* contact_resolver);
 void contact_resolver_set_iterations(struct ContactResolver* contact_resolver, unsigned int velocity_iterations, unsigned int position_iterations);
+void contact_resolver_set_iterations_per_contact(struct ContactResolver* contact_resolver, unsigned int iterations_per_contact);
+void contact_resolver_set_time_budget(struct ContactResolver* contact_resolver, float time_budget);
 void contact_resolver_set_epsilon(struct ContactResolver* contact_resolver, float velocity_epsilon, float position_epsilon);
+void contact_resolver_set_mode(struct ContactResolver* contact_resolver, enum ContactResolverMode mode);
+void contact_resolver_set_scheduler(struct ContactResolver* contact_resolver, struct JobScheduler* scheduler);
+void contact_resolver_set_joints(struct ContactResolver* contact_resolver, struct JointConstraint* joints, unsigned int joint_count);
 void contact_resolver_resolve_contacts(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration);
+void contact_resolver_resolve_substep(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration, bool first_substep, bool last_substep);
 void contact_resolver_prepare_contacts(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration);
 void contact_resolver_adjust_velocities(struct ContactResolver* contact_resolver, struct Contact* contact, unsigned int num_contacts, float duration);
 void contact_resolver_adjust_positions(struct ContactResolver* contact_resolver, struct Contact* contact, unsigned int num_contacts, float duration);
 
+// Writes at most limit contacts and returns how many were written. needed is set to how many
+// the generator had to write, more than limit when it ran out of space, so the caller can make
+// room and call it again. That second call gets room for needed and is the last, so needed must
+// not grow between the two and the generator must not rely on running only once per step.
+typedef unsigned int (*contact_generator_function)(void* context, struct Contact* contacts, unsigned int limit, unsigned int* needed);
+
+// context is the generator's own state, usually a whole batch of sources handled in one call
 struct ContactGenerator {
-  unsigned int (*add_contact)(struct Contact*, unsigned int);
-  //virtual unsigned addContact(Contact* contact, unsigned limit) const = 0;
+  contact_generator_function add_contacts;
+  void* context;
 };
 
-struct ContactGenRegistration {
-  struct ContactGenerator* gen;
-  struct ContactGenRegistration* next;
-};
+// True when neither body of a pair is awake. The world drops the contacts of such pairs before
+// solving, so a generator can skip the pair before running any narrowphase on it.
+static inline bool contact_pair_is_sleeping(struct RigidBody* one, struct RigidBody* two);
+static inline unsigned int contact_generator_run(struct ContactGenerator* contact_generator, struct Contact* contacts, unsigned int limit, unsigned int* needed);
+
+static inline bool contact_pair_is_sleeping(struct RigidBody* one, struct RigidBody* two) {
+  return !(one && one->is_awake) && !(two && two->is_awake);
+}
+
+static inline unsigned int contact_generator_run(struct ContactGenerator* contact_generator, struct Contact* contacts, unsigned int limit, unsigned int* needed) {
+  *needed = 0;
+  unsigned int used = contact_generator->add_contacts(contact_generator->context, contacts, limit, needed);
+  if (*needed < used)
+    *needed = used;
+  return used;
+}
 
 #endif  // CONTACTS_H
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef IMPULSE_H
+#define IMPULSE_H
+
+#include <float.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/body.h"
+#include "chaos/core/contactgraph.h"
+#include "chaos/core/jobs.h"
+
+#define IMPULSE_SOLVER_ITERATIONS 10
+#define IMPULSE_SOLVER_GRAIN 16
+#define IMPULSE_SOLVER_NO_CONTACT UINT_MAX
+// Velocity then rotation
+#define IMPULSE_SOLVER_BODY_FLOATS 6
+
+struct Contact;
+
+// World space impulses the last solve ended with, keyed by body pair and contact feature. A key
+// more than one contact had, or one with a body removed since, is ambiguous and never found.
+struct ImpulseCacheEntry {
+  struct RigidBody* body[2];
+  unsigned int feature;
+  bool ambiguous;
+  vec3 impulse;
+};
+
+struct ImpulseCache {
+  unsigned int capacity;
+  unsigned int size;
+  struct ImpulseCacheEntry* entries;
+};
+
+void impulse_cache_init(struct ImpulseCache* impulse_cache);
+void impulse_cache_delete(struct ImpulseCache* impulse_cache);
+void impulse_cache_store(struct ImpulseCache* impulse_cache, struct Contact* contacts, unsigned int num_contacts);
+void impulse_cache_remove_body(struct ImpulseCache* impulse_cache, struct RigidBody* body);
+bool impulse_cache_find(struct ImpulseCache* impulse_cache, struct Contact* contact, vec3* impulse);
+
+// Projected Gauss-Seidel over the contacts with accumulated impulses. The normal impulse is
+// kept non-negative and the friction impulse inside the cone of friction * normal impulse.
+// Each frame starts from the impulses a cache holds for the same body pair and feature.
+//
+// Prepare packs the contacts of each graph color into groups of SIMD_WIDTH constraints, one
+// per lane, with the rows the passes read (directions, angular terms, masses, target, bias
+// and accumulated impulse) kept apart from the contact and body indices. Lanes of a group
+// share no movable body, so a group is solved in one go and the groups of a color in
+// parallel. Overflow contacts get a group each. Body velocities are copied into a dense
+// array indexed like the graph bodies, with one extra zeroed slot standing in for missing
+// and immovable bodies, and copied back once the passes are done. Refresh reuses the packing
+// for the substeps of a step, where only the velocities, bias and target change.
+struct ImpulseSolver {
+  unsigned int group_count;
+  unsigned int group_capacity;
+  float* constraints;
+  unsigned int* lane_contact;
+  unsigned int* lane_body;
+  unsigned int color_group_start[CONTACT_GRAPH_MAX_COLORS + 2];
+  unsigned int color_count;
+
+  unsigned int body_capacity;
+  unsigned int dummy_body;
+  float* body_state;
+};
+
+void impulse_solver_init(struct ImpulseSolver* impulse_solver);
+void impulse_solver_delete(struct ImpulseSolver* impulse_solver);
+void impulse_solver_prepare(struct ImpulseSolver* impulse_solver, struct ContactGraph* contact_graph, struct ImpulseCache* impulse_cache, struct Contact* contacts, unsigned int num_contacts, float duration);
+void impulse_solver_refresh(struct ImpulseSolver* impulse_solver, struct ContactGraph* contact_graph, struct Contact* contacts, bool warm_start, float duration);
+void impulse_solver_solve_groups(struct ImpulseSolver* impulse_solver, unsigned int first_group, unsigned int last_group);
+void impulse_solver_iterate(struct ImpulseSolver* impulse_solver, struct JobScheduler* scheduler);
+void impulse_solver_finish(struct ImpulseSolver* impulse_solver, struct ContactGraph* contact_graph, struct Contact* contacts);
+
+#endif  // IMPULSE_H
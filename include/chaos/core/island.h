@@ -0,0 +1,29 @@
+#pragma once
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#include <stdlib.h>
+
+#include "chaos/core/bodypool.h"
+
+struct Contact;
+
+// Union-find over the dense body indices of a BodyPool. Bodies touching through a contact
+// (or a joint) end up in one island, and islands sleep and wake as a unit.
+struct IslandBuilder {
+  unsigned int capacity;
+  unsigned int* parent;
+  bool* restless;
+};
+
+void island_builder_init(struct IslandBuilder* island_builder);
+void island_builder_delete(struct IslandBuilder* island_builder);
+void island_builder_reset(struct IslandBuilder* island_builder, unsigned int count);
+unsigned int island_builder_find(struct IslandBuilder* island_builder, unsigned int index);
+void island_builder_union(struct IslandBuilder* island_builder, unsigned int a, unsigned int b);
+void island_builder_link(struct IslandBuilder* island_builder, struct BodyPool* body_pool, struct RigidBody* one, struct RigidBody* two);
+void island_builder_build(struct IslandBuilder* island_builder, struct BodyPool* body_pool, struct Contact* contacts, unsigned int num_contacts);
+void island_builder_update_sleep(struct IslandBuilder* island_builder, struct BodyPool* body_pool);
+unsigned int island_builder_remove_sleeping_contacts(struct IslandBuilder* island_builder, struct Contact* contacts, unsigned int num_contacts);
+
+#endif  // ISLAND_H
@@ -0,0 +1,96 @@
+#pragma once
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "chaos/core/thread.h"
+
+#define JOB_QUEUE_CAPACITY 1024
+#define TASK_GRAPH_INIT_CAPACITY 16
+
+// Range callback for parallel loops. thread_index is below the scheduler's thread_count and
+// no two ranges running at the same time share one, so it can pick a per-thread buffer.
+typedef void (*job_range_function)(void* data, unsigned int begin, unsigned int end, unsigned int thread_index);
+
+// Everything in chaos that runs in parallel goes through this interface, so an engine can
+// route the work to its own scheduler instead of the built in JobSystem
+struct JobScheduler {
+  void* context;
+  unsigned int thread_count;
+  void (*parallel_for)(void* context, unsigned int count, unsigned int grain, job_range_function function, void* data);
+};
+
+// A NULL scheduler runs the whole range inline on thread 0
+void job_scheduler_parallel_for(struct JobScheduler* scheduler, unsigned int count, unsigned int grain, job_range_function function, void* data);
+unsigned int job_scheduler_thread_count(struct JobScheduler* scheduler);
+
+struct Job {
+  job_range_function function;
+  void* data;
+  unsigned int begin;
+  unsigned int end;
+  atomic_uint* remaining;
+};
+
+// Owner pushes and pops at the tail, thieves take from the head
+struct JobQueue {
+  thread_mutex lock;
+  unsigned int head;
+  unsigned int tail;
+  struct Job jobs[JOB_QUEUE_CAPACITY];
+};
+
+// Work stealing pool. The thread that creates it is thread 0 and helps run jobs while it waits,
+// so thread_count includes it and thread_count - 1 workers are started. A failed init has
+// already stopped and freed everything, so only a successful one is paired with delete.
+struct JobSystem {
+  unsigned int thread_count;
+  thread_handle* threads;
+  struct JobQueue* queues;
+  atomic_uint queued;
+  atomic_bool quit;
+  thread_mutex sleep_lock;
+  thread_cond wake;
+  struct JobScheduler scheduler;
+};
+
+bool job_system_init(struct JobSystem* job_system, unsigned int thread_count);
+void job_system_delete(struct JobSystem* job_system);
+struct JobScheduler* job_system_get_scheduler(struct JobSystem* job_system);
+void job_system_parallel_for(struct JobSystem* job_system, unsigned int count, unsigned int grain, job_range_function function, void* data);
+
+struct Task {
+  void (*function)(void* data, unsigned int thread_index);
+  void* data;
+  unsigned int level;
+  unsigned int dependencies;
+};
+
+struct TaskDependency {
+  unsigned int before;
+  unsigned int after;
+};
+
+// Tasks run once all of their dependencies have finished. The graph is run level by level
+// through parallel_for, so it works on any JobScheduler.
+struct TaskGraph {
+  unsigned int task_count;
+  unsigned int task_capacity;
+  struct Task* tasks;
+  unsigned int dependency_count;
+  unsigned int dependency_capacity;
+  struct TaskDependency* dependencies;
+  unsigned int* order;
+};
+
+void task_graph_init(struct TaskGraph* task_graph);
+void task_graph_delete(struct TaskGraph* task_graph);
+void task_graph_clear(struct TaskGraph* task_graph);
+unsigned int task_graph_add_task(struct TaskGraph* task_graph, void (*function)(void* data, unsigned int thread_index), void* data);
+void task_graph_add_dependency(struct TaskGraph* task_graph, unsigned int before, unsigned int after);
+bool task_graph_run(struct TaskGraph* task_graph, struct JobScheduler* scheduler);
+
+#endif  // JOBS_H
@@ -6,14 +6,27 @@
 
 #include "chaos/core/contacts.h"
 
+// Joint contacts get features from here up, clear of the ones the collision detectors use. A
+// JointGroup adds the joint's index, so joints on the same pair stay apart across frames.
+#define JOINT_CONTACT_FEATURE 0x80000000u
+
+// Emits a contact when the anchors drift further apart than error, see struct JointConstraint
+// for joints solved as constraints
 struct Joint {
-  struct ContactGenerator contact_generator;
   struct RigidBody* body[2];
   vec3 position[2];
   float error;
 };
 
+// Context for joint_group_add_contacts, one generator covering every joint in the array
+struct JointGroup {
+  struct Joint* joints;
+  unsigned int joint_count;
+};
+
 unsigned int joint_add_contact(struct Joint* joint, struct Contact* contact, unsigned int limit);
 void joint_set(struct Joint* joint, struct RigidBody* a, vec3 a_pos, struct RigidBody* b, vec3 b_pos, float error);
+void joint_group_init(struct JointGroup* joint_group, struct Joint* joints, unsigned int joint_count);
+unsigned int joint_group_add_contacts(void* context, struct Contact* contacts, unsigned int limit, unsigned int* needed);
 
 #endif  // JOINTS_H
@@ -0,0 +1,108 @@
+#pragma once
+#ifndef JOINT_SOLVER_H
+#define JOINT_SOLVER_H
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/body.h"
+#include "chaos/core/contactgraph.h"
+#include "chaos/core/impulse.h"
+
+#define JOINT_MAX_ROWS 6
+#define JOINT_BAUMGARTE 0.2f
+#define JOINT_WARM_START 0.8f
+#define JOINT_PIVOT_EPSILON 1e-5f
+
+enum JointType {
+  JOINT_BALL = 0,
+  JOINT_HINGE,
+  JOINT_FIXED,
+  JOINT_SLIDER
+};
+
+// Unlike struct Joint, which emits a contact once its anchors drift apart, these are solved
+// as velocity constraints. Ball keeps the anchors together, hinge also keeps the axes lined
+// up, fixed also locks the rotation and slider locks the rotation while letting the anchors
+// move apart along the axis. Hinge limits are angles around the axis, slider limits distances
+// along it. body[1] may be NULL to attach body[0] to the world.
+//
+// Anchors, axes and reference directions are stored in each body's space, or in world space
+// for a missing body, as they were when the joint was set. The impulses carry over as the
+// next step's warm start.
+struct JointConstraint {
+  enum JointType type;
+  struct RigidBody* body[2];
+  vec3 position[2];
+  vec3 axis[2];
+  vec3 reference[2][3];
+  bool limited;
+  float lower_limit;
+  float upper_limit;
+  int limit_side;
+  float impulse[JOINT_MAX_ROWS];
+};
+
+void joint_constraint_set_ball(struct JointConstraint* joint, struct RigidBody* a, struct RigidBody* b, vec3 anchor);
+void joint_constraint_set_hinge(struct JointConstraint* joint, struct RigidBody* a, struct RigidBody* b, vec3 anchor, vec3 axis);
+void joint_constraint_set_fixed(struct JointConstraint* joint, struct RigidBody* a, struct RigidBody* b, vec3 anchor);
+void joint_constraint_set_slider(struct JointConstraint* joint, struct RigidBody* a, struct RigidBody* b, vec3 anchor, vec3 axis);
+void joint_constraint_set_limits(struct JointConstraint* joint, float lower_limit, float upper_limit);
+void joint_constraint_clear_limits(struct JointConstraint* joint);
+
+// One dimension of a joint. J·v is linear·velocity + angular·rotation summed over both
+// bodies, and the accumulated impulse stays within lower and upper.
+struct JointRow {
+  float* state[2];
+  vec3 linear[2];
+  vec3 angular[2];
+  vec3 inverse_angular[2];
+  float inverse_mass[2];
+  float mass;
+  float bias;
+  float lower;
+  float upper;
+  float* impulse;
+};
+
+// The equality rows of one joint, solved together through the Cholesky factor of their
+// effective mass matrix. A limit row is a block of its own and is clamped on its own.
+struct JointBlock {
+  unsigned int first;
+  unsigned int count;
+  bool limit;
+  float factor[JOINT_MAX_ROWS * JOINT_MAX_ROWS];
+};
+
+// Projected Gauss-Seidel over the joint blocks, run on the calling thread. Body velocities live
+// in the ImpulseSolver's dense array when the body is in its contact graph, so the joints and
+// contacts see each other's impulses within a pass, and in the solver's own array otherwise.
+struct JointSolver {
+  unsigned int row_count;
+  unsigned int row_capacity;
+  struct JointRow* rows;
+  unsigned int block_count;
+  unsigned int block_capacity;
+  struct JointBlock* blocks;
+
+  unsigned int body_count;
+  unsigned int body_capacity;
+  struct RigidBody** bodies;
+  float* body_state;
+  unsigned int table_capacity;
+  struct RigidBody** table_body;
+  unsigned int* table_index;
+};
+
+void joint_solver_init(struct JointSolver* joint_solver);
+void joint_solver_delete(struct JointSolver* joint_solver);
+void joint_solver_prepare(struct JointSolver* joint_solver, struct JointConstraint* joints, unsigned int num_joints, struct ContactGraph* contact_graph, float* shared_state, float duration);
+void joint_solver_iterate(struct JointSolver* joint_solver);
+void joint_solver_finish(struct JointSolver* joint_solver);
+
+#endif  // JOINT_SOLVER_H
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef MANIFOLD_H
+#define MANIFOLD_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/body.h"
+#include "chaos/core/contacts.h"
+
+#define CONTACT_MANIFOLD_POINTS 4
+#define CONTACT_MANIFOLD_NONE UINT_MAX
+// How far a kept point may separate or slide before it is dropped
+#define CONTACT_MANIFOLD_BREAK 0.02f
+// New points closer than this to a kept point replace it
+#define CONTACT_MANIFOLD_MERGE 0.02f
+// Kept points whose normal turned further than this from the new one are dropped
+#define CONTACT_MANIFOLD_NORMAL_DOT 0.95f
+
+// The contacts of one body pair, at most CONTACT_MANIFOLD_POINTS of them. Points are anchored
+// to the bodies like substep contacts, so a point keeps its place on both bodies from one frame
+// to the next.
+struct ContactManifold {
+  struct RigidBody* body[2];
+  unsigned int point_count;
+  struct Contact points[CONTACT_MANIFOLD_POINTS];
+};
+
+// Manifolds of one frame in the order their pairs were first seen, hashed by body pair
+struct ManifoldTable {
+  unsigned int count;
+  unsigned int capacity;
+  struct ContactManifold* manifolds;
+  unsigned int slot_capacity;
+  unsigned int* slots;
+};
+
+// Turns each frame's generated contacts into persistent manifolds. Every pair the generators
+// reported gets one, built from its new contacts and the points last frame's manifold kept
+// that are still valid: not separated or slid further than CONTACT_MANIFOLD_BREAK and facing
+// the same way as the new contacts. A new point takes over a kept point with the same feature
+// or within CONTACT_MANIFOLD_MERGE of it. Pairs without new contacts lose their manifold.
+//
+// More than CONTACT_MANIFOLD_POINTS candidates are reduced to the deepest point, the one
+// furthest from it, the one spanning the largest triangle with those and the one adding the
+// most area outside that triangle. Kept points keep their feature, so the impulse cache still
+// warm starts them.
+//
+// contacts holds the manifold points for the resolver, kept points that have separated stay in
+// their manifold but are left out until they touch again.
+struct ManifoldCache {
+  struct ManifoldTable current;
+  struct ManifoldTable previous;
+
+  unsigned int scratch_capacity;
+  unsigned int* contact_manifold;
+  unsigned int* pair_start;
+  unsigned int* pair_contacts;
+  unsigned int candidate_capacity;
+  struct Contact* candidates;
+
+  unsigned int contact_count;
+  unsigned int contact_capacity;
+  struct Contact* contacts;
+};
+
+void manifold_cache_init(struct ManifoldCache* manifold_cache);
+void manifold_cache_delete(struct ManifoldCache* manifold_cache);
+void manifold_cache_clear(struct ManifoldCache* manifold_cache);
+void manifold_cache_remove_body(struct ManifoldCache* manifold_cache, struct RigidBody* body);
+unsigned int manifold_cache_update(struct ManifoldCache* manifold_cache, struct Contact* contacts, unsigned int num_contacts);
+struct ContactManifold* manifold_cache_find(struct ManifoldCache* manifold_cache, struct RigidBody* one, struct RigidBody* two);
+unsigned int manifold_reduce(struct Contact* points, unsigned int point_count, unsigned int selected[CONTACT_MANIFOLD_POINTS]);
+
+#endif  // MANIFOLD_H
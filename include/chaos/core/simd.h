@@ -0,0 +1,73 @@
+#pragma once
+#ifndef SIMD_H
+#define SIMD_H
+
+// Thin lane abstraction over SSE/AVX so batched kernels can be written once.
+// SIMD_WIDTH floats are processed per call; builds without SSE fall back to one lane.
+// Operations are kept unfused (no FMA) so lane results match the scalar code paths.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+
+#define SIMD_WIDTH 8
+
+typedef __m256 simd_float;
+
+static inline simd_float simd_load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+static inline void simd_store(float* ptr, simd_float value) { _mm256_storeu_ps(ptr, value); }
+static inline simd_float simd_set(float value) { return _mm256_set1_ps(value); }
+static inline simd_float simd_zero(void) { return _mm256_setzero_ps(); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm256_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm256_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm256_mul_ps(a, b); }
+static inline simd_float simd_div(simd_float a, simd_float b) { return _mm256_div_ps(a, b); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return _mm256_min_ps(a, b); }
+static inline simd_float simd_max(simd_float a, simd_float b) { return _mm256_max_ps(a, b); }
+static inline simd_float simd_sqrt(simd_float a) { return _mm256_sqrt_ps(a); }
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+#define SIMD_WIDTH 4
+
+typedef __m128 simd_float;
+
+static inline simd_float simd_load(const float* ptr) { return _mm_loadu_ps(ptr); }
+static inline void simd_store(float* ptr, simd_float value) { _mm_storeu_ps(ptr, value); }
+static inline simd_float simd_set(float value) { return _mm_set1_ps(value); }
+static inline simd_float simd_zero(void) { return _mm_setzero_ps(); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm_mul_ps(a, b); }
+static inline simd_float simd_div(simd_float a, simd_float b) { return _mm_div_ps(a, b); }
+static inline simd_float simd_min(simd_float a, simd_float b) { return _mm_min_ps(a, b); }
+static inline simd_float simd_max(simd_float a, simd_float b) { return _mm_max_ps(a, b); }
+static inline simd_float simd_sqrt(simd_float a) { return _mm_sqrt_ps(a); }
+
+#else
+#include <math.h>
+
+#define SIMD_WIDTH 1
+
+typedef float simd_float;
+
+static inline simd_float simd_load(const float* ptr) { return *ptr; }
+static inline void simd_store(float* ptr, simd_float value) { *ptr = value; }
+static inline simd_float simd_set(float value) { return value; }
+static inline simd_float simd_zero(void) { return 0.0f; }
+static inline simd_float simd_add(simd_float a, simd_float b) { return a + b; }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return a - b; }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return a * b; }
+static inline simd_float simd_div(simd_float a, simd_float b) { return a / b; }
+static inline simd_float simd_min(simd_float a, simd_float b) { return a < b ? a : b; }
+static inline simd_float simd_max(simd_float a, simd_float b) { return a > b ? a : b; }
+static inline simd_float simd_sqrt(simd_float a) { return sqrtf(a); }
+
+#endif
+
+// Round a lane count up to a whole number of SIMD registers
+static inline unsigned int simd_round_up(unsigned int count) {
+  return (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+#endif  // SIMD_H
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/aabbtree.h"
+#include "chaos/core/body.h"
+#include "chaos/core/jobs.h"
+
+#define SPATIAL_GRID_CHUNK_SIZE 256
+#define SPATIAL_GRID_CELL_BLOCK 256
+
+struct SpatialGridProxy {
+  struct RigidBody* body;
+  struct AABB aabb;
+  int cell_min[3];
+  int cell_max[3];
+  unsigned int first_entry;
+};
+
+// One per cell a proxy's box touches, bucket is the hashed cell
+struct SpatialGridEntry {
+  unsigned int proxy;
+  unsigned int bucket;
+  int cell[3];
+};
+
+// Where one block of buckets wrote its pairs, so they can be merged in bucket order
+struct SpatialGridBlockOutput {
+  unsigned int thread_index;
+  unsigned int offset;
+  unsigned int count;
+};
+
+struct SpatialGridThreadPairs {
+  unsigned int count;
+  unsigned int capacity;
+  struct PotentialContact* pairs;
+};
+
+// Uniform grid hashed into buckets, for many bodies of about the same size. Proxies are added
+// each frame and build puts every box in each cell it touches with a counting sort, so the
+// buckets are ranges of one entry array and nothing is allocated per cell. A cell size a bit
+// larger than the typical box keeps that to a few cells per box, large boxes still work but
+// land in many cells.
+//
+// Build then tests the boxes sharing a cell, in parallel over blocks of buckets with each
+// thread writing to its own pairs. A pair sharing several cells is only kept in the cell
+// holding the min corner of the overlap, and the blocks are merged in order so the pairs do
+// not depend on the scheduling. Build runs on the scheduler itself, so call it before
+// generating contacts rather than from a generator.
+struct SpatialGrid {
+  float cell_size;
+  float inverse_cell_size;
+  unsigned int proxy_count;
+  unsigned int proxy_capacity;
+  struct SpatialGridProxy* proxies;
+
+  unsigned int entry_count;
+  unsigned int entry_capacity;
+  struct SpatialGridEntry* entries;
+  struct SpatialGridEntry* sorted_entries;
+  unsigned int bucket_count;
+  unsigned int bucket_capacity;
+  unsigned int* bucket_start;
+  atomic_uint* bucket_cursor;
+
+  unsigned int block_capacity;
+  struct SpatialGridBlockOutput* block_output;
+  unsigned int thread_pairs_count;
+  struct SpatialGridThreadPairs* thread_pairs;
+  unsigned int pair_count;
+  unsigned int pair_capacity;
+  struct PotentialContact* pairs;
+};
+
+void spatial_grid_init(struct SpatialGrid* spatial_grid, float cell_size);
+void spatial_grid_delete(struct SpatialGrid* spatial_grid);
+void spatial_grid_set_cell_size(struct SpatialGrid* spatial_grid, float cell_size);
+void spatial_grid_clear(struct SpatialGrid* spatial_grid);
+unsigned int spatial_grid_add(struct SpatialGrid* spatial_grid, struct RigidBody* body, struct AABB aabb);
+void spatial_grid_build(struct SpatialGrid* spatial_grid, struct JobScheduler* scheduler);
+unsigned int spatial_grid_get_potential_contacts(struct SpatialGrid* spatial_grid, struct PotentialContact* contacts, unsigned int limit, unsigned int* needed);
+
+#endif  // SPATIAL_GRID_H
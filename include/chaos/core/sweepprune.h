@@ -0,0 +1,89 @@
+#pragma once
+#ifndef SWEEP_PRUNE_H
+#define SWEEP_PRUNE_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ubermath/ubermath.h>
+
+#include "chaos/core/aabbtree.h"
+#include "chaos/core/body.h"
+
+#define SWEEP_PRUNE_NULL UINT_MAX
+
+// proxy_end is the proxy index shifted left once, with the low bit set on a box's max end
+struct SweepEndpoint {
+  float value;
+  unsigned int proxy_end;
+};
+
+// endpoint holds where the proxy's min and max ends sit in each sorted axis
+struct SweepProxy {
+  struct RigidBody* body;
+  struct AABB aabb;
+  unsigned int endpoint[3][2];
+  unsigned int next_free;
+  unsigned int active_index;
+  bool removing;
+};
+
+struct SweepPair {
+  unsigned int proxy[2];
+  unsigned int stamp;
+};
+
+// Sweep and prune over sorted box ends. Moving a proxy only rewrites its end values, update
+// then puts every axis back in order with an insertion sort, which costs little more than a
+// pass over the ends when the bodies moved little since the last update.
+//
+// With three axes the pairs follow the swaps: a min end passing a max end starts an overlap on
+// that axis and adds the pair if the boxes overlap on all three, a max end passing a min end
+// removes it. With one axis update sweeps the sorted axis and tests the boxes of every overlap
+// along it, then drops the pairs it did not find again, which suits scenes spread out along
+// that axis.
+//
+// Either way the pairs live in a hash set, and update lists the pairs it added and removed
+// since the previous update. Removed proxies stay in place until the next update, which
+// reports their pairs as removed.
+struct SweepPrune {
+  unsigned int axis_count;
+  unsigned int proxy_count;
+  unsigned int proxy_capacity;
+  struct SweepProxy* proxies;
+  unsigned int free_list;
+  unsigned int endpoint_count;
+  unsigned int endpoint_capacity;
+  struct SweepEndpoint* endpoints[3];
+
+  unsigned int pair_count;
+  unsigned int pair_capacity;
+  struct SweepPair* pairs;
+  unsigned int stamp;
+
+  unsigned int active_count;
+  unsigned int active_capacity;
+  unsigned int* active;
+  unsigned int pending_count;
+  unsigned int pending_capacity;
+  unsigned int* pending;
+
+  unsigned int added_count;
+  unsigned int added_capacity;
+  struct PotentialContact* added;
+  unsigned int removed_count;
+  unsigned int removed_capacity;
+  struct PotentialContact* removed;
+};
+
+void sweep_prune_init(struct SweepPrune* sweep_prune, unsigned int axis_count);
+void sweep_prune_delete(struct SweepPrune* sweep_prune);
+unsigned int sweep_prune_insert(struct SweepPrune* sweep_prune, struct RigidBody* body, struct AABB aabb);
+void sweep_prune_remove(struct SweepPrune* sweep_prune, unsigned int proxy);
+void sweep_prune_move(struct SweepPrune* sweep_prune, unsigned int proxy, struct AABB aabb);
+void sweep_prune_update(struct SweepPrune* sweep_prune);
+unsigned int sweep_prune_get_potential_contacts(struct SweepPrune* sweep_prune, struct PotentialContact* contacts, unsigned int limit, unsigned int* needed);
+
+#endif  // SWEEP_PRUNE_H
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef THREAD_H
+#define THREAD_H
+
+// Thin wrapper over Win32 and POSIX threads so the job system builds where C11 <threads.h> is
+// missing (macOS, older MSVC). Only what the JobSystem needs: threads, a plain mutex, a
+// condition variable and thread local storage.
+
+#include <stdbool.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+#define THREAD_CALL WINAPI
+
+typedef DWORD thread_result;
+typedef HANDLE thread_handle;
+typedef SRWLOCK thread_mutex;
+typedef CONDITION_VARIABLE thread_cond;
+typedef thread_result(THREAD_CALL* thread_function)(void* arg);
+
+static inline bool thread_create(thread_handle* thread, thread_function function, void* arg) {
+  *thread = CreateThread(NULL, 0, function, arg, 0, NULL);
+  return *thread != NULL;
+}
+static inline void thread_join(thread_handle thread) {
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+}
+static inline void thread_yield(void) { SwitchToThread(); }
+
+static inline void thread_mutex_init(thread_mutex* mutex) { InitializeSRWLock(mutex); }
+static inline void thread_mutex_destroy(thread_mutex* mutex) { (void)mutex; }
+static inline void thread_mutex_lock(thread_mutex* mutex) { AcquireSRWLockExclusive(mutex); }
+static inline void thread_mutex_unlock(thread_mutex* mutex) { ReleaseSRWLockExclusive(mutex); }
+
+static inline void thread_cond_init(thread_cond* cond) { InitializeConditionVariable(cond); }
+static inline void thread_cond_destroy(thread_cond* cond) { (void)cond; }
+static inline void thread_cond_wait(thread_cond* cond, thread_mutex* mutex) { SleepConditionVariableSRW(cond, mutex, INFINITE, 0); }
+static inline void thread_cond_broadcast(thread_cond* cond) { WakeAllConditionVariable(cond); }
+
+#else
+#include <pthread.h>
+#include <sched.h>
+
+#define THREAD_LOCAL _Thread_local
+#define THREAD_CALL
+
+typedef void* thread_result;
+typedef pthread_t thread_handle;
+typedef pthread_mutex_t thread_mutex;
+typedef pthread_cond_t thread_cond;
+typedef thread_result (*thread_function)(void* arg);
+
+static inline bool thread_create(thread_handle* thread, thread_function function, void* arg) { return pthread_create(thread, NULL, function, arg) == 0; }
+static inline void thread_join(thread_handle thread) { pthread_join(thread, NULL); }
+static inline void thread_yield(void) { sched_yield(); }
+
+static inline void thread_mutex_init(thread_mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static inline void thread_mutex_destroy(thread_mutex* mutex) { pthread_mutex_destroy(mutex); }
+static inline void thread_mutex_lock(thread_mutex* mutex) { pthread_mutex_lock(mutex); }
+static inline void thread_mutex_unlock(thread_mutex* mutex) { pthread_mutex_unlock(mutex); }
+
+static inline void thread_cond_init(thread_cond* cond) { pthread_cond_init(cond, NULL); }
+static inline void thread_cond_destroy(thread_cond* cond) { pthread_cond_destroy(cond); }
+static inline void thread_cond_wait(thread_cond* cond, thread_mutex* mutex) { pthread_cond_wait(cond, mutex); }
+static inline void thread_cond_broadcast(thread_cond* cond) { pthread_cond_broadcast(cond); }
+
+#endif
+
+#endif  // THREAD_H
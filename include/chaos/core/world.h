@@ -5,8 +5,14 @@
 #include <stdlib.h>
 #include <ubermath/ubermath.h>
 
+#include "chaos/core/articulation.h"
 #include "chaos/core/body.h"
+#include "chaos/core/bodypool.h"
+#include "chaos/core/contactarena.h"
 #include "chaos/core/contacts.h"
+#include "chaos/core/island.h"
+#include "chaos/core/jobs.h"
+#include "chaos/core/manifold.h"
 
 // TODO: Add this
 //const static real velocityLimit = (real)0.25f;
@@ -20,13 +26,68 @@
 //real chaos::getSleepEpsilon() {
 //    return chaos::sleepEpsilon;
 //}
+// Where one generator's contacts landed, so the merge can go in registration order
+struct ContactGenOutput {
+  struct Contact* contacts;
+  unsigned int count;
+  unsigned int dropped;
+};
+
+// Bodies are copied into the world's BodyPool when added and reached through their handle
+// from then on. The pointer world_get_body returns stays valid until the body is removed.
+//
+// With more than one substep, contacts are generated once at the start of a step and followed
+// through substeps that each integrate and resolve over duration / substeps. Most of the
+// stability comes from the short substeps, so the resolver usually needs fewer iterations.
+// Islands and, in sequential impulse mode, the packed constraints are built by the first
+// substep and refreshed by the others, the position passes still run in every substep.
+// Contacts a step runs into are only found by the next one, unless their generators reach
+// ahead through a tolerance.
+//
+// Contacts live in a ContactArena that grows as a step needs it, contacts points at this
+// step's contacts once they are generated. With use_manifolds set they are reduced to
+// persistent manifolds of at most CONTACT_MANIFOLD_POINTS per body pair first, and contacts
+// points at the manifold points.
 struct World {
   bool calculate_iterations;
-  struct BodyRegistration* first_body;
+  unsigned int substeps;
+  struct BodyPool bodies;
+  struct IslandBuilder islands;
   struct ContactResolver resolver;
-  struct ContactGenRegistration* first_contact_gen;
+  unsigned int generator_count;
+  unsigned int generator_capacity;
+  struct ContactGenerator* generators;
+  struct ContactGenOutput* generator_output;
+  struct ContactArena contact_arena;
   struct Contact* contacts;
-  unsigned int max_contacts;
+  unsigned int contact_shortfall;
+  bool use_manifolds;
+  struct ManifoldCache manifolds;
+  struct JobScheduler* scheduler;
+  unsigned int thread_arena_count;
+  struct ContactArena* thread_arenas;
+  unsigned int articulation_count;
+  unsigned int articulation_capacity;
+  struct Articulation** articulations;
 };
 
+void world_init(struct World* world, unsigned int contact_capacity, unsigned int iterations);
+void world_delete(struct World* world);
+struct BodyHandle world_add_body(struct World* world, const struct RigidBody* body);
+bool world_remove_body(struct World* world, struct BodyHandle handle);
+struct RigidBody* world_get_body(struct World* world, struct BodyHandle handle);
+void world_set_scheduler(struct World* world, struct JobScheduler* scheduler);
+void world_set_substeps(struct World* world, unsigned int substeps);
+void world_set_manifolds(struct World* world, bool use_manifolds);
+void world_set_joints(struct World* world, struct JointConstraint* joints, unsigned int joint_count);
+void world_add_articulation(struct World* world, struct Articulation* articulation);
+unsigned int world_add_contact_generator(struct World* world, contact_generator_function add_contacts, void* context);
+void world_clear_contact_generators(struct World* world);
+void world_reserve_contacts(struct World* world, unsigned int contact_capacity);
+unsigned int world_get_contact_high_water(struct World* world);
+unsigned int world_get_contact_shortfall(struct World* world);
+void world_start_frame(struct World* world);
+unsigned int world_generate_contacts(struct World* world);
+void world_run_physics(struct World* world, float duration);
+
 #endif  // WORLD_H
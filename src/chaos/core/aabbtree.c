@@ -0,0 +1,313 @@
+#include "chaos/core/aabbtree.h"
+
+#include "chaos/core/collidecoarse.h"
+
+struct AABB aabb_from_box(struct CollisionBox* box) {
+  vec3 centre = collision_primitive_get_axis(&box->collision_primitive, 3);
+  vec3 extent = {.data = {0.0f, 0.0f, 0.0f}};
+  for (unsigned int axis = 0; axis < 3; axis++) {
+    vec3 direction = collision_primitive_get_axis(&box->collision_primitive, axis);
+    for (unsigned int i = 0; i < 3; i++)
+      extent.data[i] += fabsf(direction.data[i]) * box->half_size.data[axis];
+  }
+  return (struct AABB){.min = vec3_sub(centre, extent), .max = vec3_add(centre, extent)};
+}
+
+struct AABB aabb_from_sphere(struct CollisionSphere* sphere) {
+  vec3 centre = collision_primitive_get_axis(&sphere->collision_primitive, 3);
+  vec3 extent = {.data = {sphere->radius, sphere->radius, sphere->radius}};
+  return (struct AABB){.min = vec3_sub(centre, extent), .max = vec3_add(centre, extent)};
+}
+
+static inline bool aabb_tree_is_leaf(struct AABBTreeNode* node) {
+  return node->children[0] == AABB_TREE_NULL;
+}
+
+static unsigned int aabb_tree_allocate_node(struct AABBTree* aabb_tree) {
+  if (aabb_tree->free_list == AABB_TREE_NULL) {
+    unsigned int old_capacity = aabb_tree->node_capacity;
+    aabb_tree->node_capacity = old_capacity ? old_capacity * 2 : 16;
+    aabb_tree->nodes = realloc(aabb_tree->nodes, sizeof(struct AABBTreeNode) * aabb_tree->node_capacity);
+    for (unsigned int node_num = old_capacity; node_num < aabb_tree->node_capacity; node_num++) {
+      aabb_tree->nodes[node_num].parent = node_num + 1 < aabb_tree->node_capacity ? node_num + 1 : AABB_TREE_NULL;
+      aabb_tree->nodes[node_num].height = -1;
+    }
+    aabb_tree->free_list = old_capacity;
+  }
+
+  unsigned int node_num = aabb_tree->free_list;
+  struct AABBTreeNode* node = &aabb_tree->nodes[node_num];
+  aabb_tree->free_list = node->parent;
+  node->parent = AABB_TREE_NULL;
+  node->children[0] = node->children[1] = AABB_TREE_NULL;
+  node->body = NULL;
+  node->height = 0;
+  aabb_tree->node_count++;
+  return node_num;
+}
+
+static void aabb_tree_free_node(struct AABBTree* aabb_tree, unsigned int node_num) {
+  aabb_tree->nodes[node_num].parent = aabb_tree->free_list;
+  aabb_tree->nodes[node_num].height = -1;
+  aabb_tree->free_list = node_num;
+  aabb_tree->node_count--;
+}
+
+// Lifts a grandchild when one side of a is more than one level taller than the other, and
+// returns the node now standing where a was
+static unsigned int aabb_tree_balance(struct AABBTree* aabb_tree, unsigned int a) {
+  struct AABBTreeNode* nodes = aabb_tree->nodes;
+  struct AABBTreeNode* node_a = &nodes[a];
+  if (aabb_tree_is_leaf(node_a) || node_a->height < 2)
+    return a;
+
+  int balance = nodes[node_a->children[1]].height - nodes[node_a->children[0]].height;
+  if (balance >= -1 && balance <= 1)
+    return a;
+
+  // NOTE: up is the taller child and stays is the other one, up takes a's place and a keeps
+  // the shorter of up's children
+  unsigned int side = balance > 1 ? 1 : 0;
+  unsigned int up = node_a->children[side];
+  unsigned int stays = node_a->children[1 - side];
+  struct AABBTreeNode* node_up = &nodes[up];
+  unsigned int f = node_up->children[0];
+  unsigned int g = node_up->children[1];
+
+  node_up->children[0] = a;
+  node_up->parent = node_a->parent;
+  node_a->parent = up;
+  if (node_up->parent == AABB_TREE_NULL)
+    aabb_tree->root = up;
+  else if (nodes[node_up->parent].children[0] == a)
+    nodes[node_up->parent].children[0] = up;
+  else
+    nodes[node_up->parent].children[1] = up;
+
+  unsigned int taller = nodes[f].height > nodes[g].height ? f : g;
+  unsigned int shorter = taller == f ? g : f;
+  node_up->children[1] = taller;
+  node_a->children[side] = shorter;
+  nodes[shorter].parent = a;
+
+  node_a->aabb = aabb_union(nodes[stays].aabb, nodes[shorter].aabb);
+  node_a->height = 1 + (nodes[stays].height > nodes[shorter].height ? nodes[stays].height : nodes[shorter].height);
+  node_up->aabb = aabb_union(node_a->aabb, nodes[taller].aabb);
+  node_up->height = 1 + (node_a->height > nodes[taller].height ? node_a->height : nodes[taller].height);
+  return up;
+}
+
+// Rebalances and refits from node_num up, stopping at the first node that keeps its box and
+// height. The first node is always refit, its children are new.
+static void aabb_tree_refit(struct AABBTree* aabb_tree, unsigned int node_num) {
+  bool first = true;
+  while (node_num != AABB_TREE_NULL) {
+    unsigned int balanced = aabb_tree_balance(aabb_tree, node_num);
+    struct AABBTreeNode* node = &aabb_tree->nodes[balanced];
+    struct AABBTreeNode* one = &aabb_tree->nodes[node->children[0]];
+    struct AABBTreeNode* two = &aabb_tree->nodes[node->children[1]];
+
+    struct AABB aabb = aabb_union(one->aabb, two->aabb);
+    int height = 1 + (one->height > two->height ? one->height : two->height);
+    bool changed = first || balanced != node_num || height != node->height || memcmp(&aabb, &node->aabb, sizeof(struct AABB)) != 0;
+    node->aabb = aabb;
+    node->height = height;
+    if (!changed)
+      return;
+
+    first = false;
+    node_num = node->parent;
+  }
+}
+
+static void aabb_tree_insert_leaf(struct AABBTree* aabb_tree, unsigned int leaf) {
+  aabb_tree->leaf_count++;
+  if (aabb_tree->root == AABB_TREE_NULL) {
+    aabb_tree->root = leaf;
+    aabb_tree->nodes[leaf].parent = AABB_TREE_NULL;
+    return;
+  }
+
+  // NOTE: Descends towards the cheapest sibling, a node's cost is the area it would get plus
+  // the area every ancestor grows by to take the leaf in
+  struct AABB leaf_aabb = aabb_tree->nodes[leaf].aabb;
+  unsigned int sibling = aabb_tree->root;
+  while (!aabb_tree_is_leaf(&aabb_tree->nodes[sibling])) {
+    struct AABBTreeNode* node = &aabb_tree->nodes[sibling];
+    float area = aabb_surface_area(node->aabb);
+    float combined_area = aabb_surface_area(aabb_union(node->aabb, leaf_aabb));
+    float cost = 2.0f * combined_area;
+    float inheritance_cost = 2.0f * (combined_area - area);
+
+    float child_cost[2];
+    for (unsigned int c = 0; c < 2; c++) {
+      struct AABBTreeNode* child = &aabb_tree->nodes[node->children[c]];
+      child_cost[c] = aabb_surface_area(aabb_union(leaf_aabb, child->aabb)) + inheritance_cost;
+      if (!aabb_tree_is_leaf(child))
+        child_cost[c] -= aabb_surface_area(child->aabb);
+    }
+
+    if (cost < child_cost[0] && cost < child_cost[1])
+      break;
+    sibling = node->children[child_cost[0] < child_cost[1] ? 0 : 1];
+  }
+
+  unsigned int parent = aabb_tree_allocate_node(aabb_tree);
+  struct AABBTreeNode* nodes = aabb_tree->nodes;
+  unsigned int old_parent = nodes[sibling].parent;
+  nodes[parent].parent = old_parent;
+  nodes[parent].children[0] = sibling;
+  nodes[parent].children[1] = leaf;
+  nodes[sibling].parent = parent;
+  nodes[leaf].parent = parent;
+
+  if (old_parent == AABB_TREE_NULL)
+    aabb_tree->root = parent;
+  else if (nodes[old_parent].children[0] == sibling)
+    nodes[old_parent].children[0] = parent;
+  else
+    nodes[old_parent].children[1] = parent;
+
+  aabb_tree_refit(aabb_tree, parent);
+}
+
+static void aabb_tree_remove_leaf(struct AABBTree* aabb_tree, unsigned int leaf) {
+  aabb_tree->leaf_count--;
+  struct AABBTreeNode* nodes = aabb_tree->nodes;
+  if (leaf == aabb_tree->root) {
+    aabb_tree->root = AABB_TREE_NULL;
+    return;
+  }
+
+  unsigned int parent = nodes[leaf].parent;
+  unsigned int grand_parent = nodes[parent].parent;
+  unsigned int sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+  aabb_tree_free_node(aabb_tree, parent);
+
+  nodes[sibling].parent = grand_parent;
+  if (grand_parent == AABB_TREE_NULL) {
+    aabb_tree->root = sibling;
+    return;
+  }
+
+  if (nodes[grand_parent].children[0] == parent)
+    nodes[grand_parent].children[0] = sibling;
+  else
+    nodes[grand_parent].children[1] = sibling;
+  aabb_tree_refit(aabb_tree, grand_parent);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+void aabb_tree_init(struct AABBTree* aabb_tree, float margin) {
+  aabb_tree->root = AABB_TREE_NULL;
+  aabb_tree->node_count = 0;
+  aabb_tree->node_capacity = 0;
+  aabb_tree->nodes = NULL;
+  aabb_tree->free_list = AABB_TREE_NULL;
+  aabb_tree->leaf_count = 0;
+  aabb_tree->margin = margin;
+  aabb_tree->stack_capacity = 0;
+  aabb_tree->stack = NULL;
+}
+
+void aabb_tree_delete(struct AABBTree* aabb_tree) {
+  free(aabb_tree->nodes);
+  free(aabb_tree->stack);
+}
+
+// Returns the proxy that stands for body until it is removed
+unsigned int aabb_tree_insert(struct AABBTree* aabb_tree, struct RigidBody* body, struct AABB aabb) {
+  unsigned int leaf = aabb_tree_allocate_node(aabb_tree);
+  vec3 margin = {.data = {aabb_tree->margin, aabb_tree->margin, aabb_tree->margin}};
+  aabb_tree->nodes[leaf].aabb = (struct AABB){.min = vec3_sub(aabb.min, margin), .max = vec3_add(aabb.max, margin)};
+  aabb_tree->nodes[leaf].body = body;
+  aabb_tree_insert_leaf(aabb_tree, leaf);
+  return leaf;
+}
+
+void aabb_tree_remove(struct AABBTree* aabb_tree, unsigned int proxy) {
+  aabb_tree_remove_leaf(aabb_tree, proxy);
+  aabb_tree_free_node(aabb_tree, proxy);
+}
+
+// Reinserts the proxy when aabb has left its fat box and returns whether it did
+bool aabb_tree_move(struct AABBTree* aabb_tree, unsigned int proxy, struct AABB aabb) {
+  if (aabb_contains(aabb_tree->nodes[proxy].aabb, aabb))
+    return false;
+
+  aabb_tree_remove_leaf(aabb_tree, proxy);
+  vec3 margin = {.data = {aabb_tree->margin, aabb_tree->margin, aabb_tree->margin}};
+  aabb_tree->nodes[proxy].aabb = (struct AABB){.min = vec3_sub(aabb.min, margin), .max = vec3_add(aabb.max, margin)};
+  aabb_tree_insert_leaf(aabb_tree, proxy);
+  return true;
+}
+
+struct AABB aabb_tree_get_fat_aabb(struct AABBTree* aabb_tree, unsigned int proxy) {
+  return aabb_tree->nodes[proxy].aabb;
+}
+
+int aabb_tree_get_height(struct AABBTree* aabb_tree) {
+  return aabb_tree->root == AABB_TREE_NULL ? 0 : aabb_tree->nodes[aabb_tree->root].height;
+}
+
+static inline void aabb_tree_push(struct AABBTree* aabb_tree, unsigned int* stack_size, unsigned int one, unsigned int two) {
+  if (*stack_size + 2 > aabb_tree->stack_capacity) {
+    aabb_tree->stack_capacity = aabb_tree->stack_capacity ? aabb_tree->stack_capacity * 2 : 64;
+    aabb_tree->stack = realloc(aabb_tree->stack, sizeof(unsigned int) * aabb_tree->stack_capacity);
+  }
+  aabb_tree->stack[(*stack_size)++] = one;
+  aabb_tree->stack[(*stack_size)++] = two;
+}
+
+// Writes at most limit pairs of leaves whose fat boxes overlap, needed is set to how many
+// there are in all. The stack holds node pairs to test, a node paired with itself stands for
+// the pairs inside its subtree.
+unsigned int aabb_tree_get_potential_contacts(struct AABBTree* aabb_tree, struct PotentialContact* contacts, unsigned int limit, unsigned int* needed) {
+  *needed = 0;
+  if (aabb_tree->root == AABB_TREE_NULL)
+    return 0;
+
+  struct AABBTreeNode* nodes = aabb_tree->nodes;
+  unsigned int used = 0;
+  unsigned int stack_size = 0;
+  aabb_tree_push(aabb_tree, &stack_size, aabb_tree->root, aabb_tree->root);
+
+  while (stack_size > 0) {
+    unsigned int two = aabb_tree->stack[--stack_size];
+    unsigned int one = aabb_tree->stack[--stack_size];
+    struct AABBTreeNode* node_one = &nodes[one];
+    struct AABBTreeNode* node_two = &nodes[two];
+
+    if (one == two) {
+      if (!aabb_tree_is_leaf(node_one)) {
+        aabb_tree_push(aabb_tree, &stack_size, node_one->children[0], node_one->children[1]);
+        aabb_tree_push(aabb_tree, &stack_size, node_one->children[1], node_one->children[1]);
+        aabb_tree_push(aabb_tree, &stack_size, node_one->children[0], node_one->children[0]);
+      }
+      continue;
+    }
+
+    if (!aabb_overlaps(node_one->aabb, node_two->aabb))
+      continue;
+
+    bool one_leaf = aabb_tree_is_leaf(node_one);
+    bool two_leaf = aabb_tree_is_leaf(node_two);
+    if (one_leaf && two_leaf) {
+      if (used < limit) {
+        contacts[used].body[0] = node_one->body;
+        contacts[used].body[1] = node_two->body;
+        used++;
+      }
+      (*needed)++;
+    } else if (two_leaf || (!one_leaf && aabb_surface_area(node_one->aabb) >= aabb_surface_area(node_two->aabb))) {
+      aabb_tree_push(aabb_tree, &stack_size, node_one->children[1], two);
+      aabb_tree_push(aabb_tree, &stack_size, node_one->children[0], two);
+    } else {
+      aabb_tree_push(aabb_tree, &stack_size, one, node_two->children[1]);
+      aabb_tree_push(aabb_tree, &stack_size, one, node_two->children[0]);
+    }
+  }
+
+  return used;
+}
@@ -0,0 +1,561 @@
+#include "chaos/core/articulation.h"
+
+static const struct SpatialVector spatial_zero = {.angular = {.data = {0.0f, 0.0f, 0.0f}}, .linear = {.data = {0.0f, 0.0f, 0.0f}}};
+
+static inline float spatial_get(struct SpatialVector vector, unsigned int k) {
+  return (k < 3) ? vector.angular.data[k] : vector.linear.data[k - 3];
+}
+
+static inline void spatial_set(struct SpatialVector* vector, unsigned int k, float value) {
+  if (k < 3)
+    vector->angular.data[k] = value;
+  else
+    vector->linear.data[k - 3] = value;
+}
+
+static inline struct SpatialVector spatial_add(struct SpatialVector a, struct SpatialVector b) {
+  return (struct SpatialVector){.angular = vec3_add(a.angular, b.angular), .linear = vec3_add(a.linear, b.linear)};
+}
+
+static inline struct SpatialVector spatial_scale(struct SpatialVector vector, float scale) {
+  return (struct SpatialVector){.angular = vec3_scale(vector.angular, scale), .linear = vec3_scale(vector.linear, scale)};
+}
+
+static inline float spatial_dot(struct SpatialVector a, struct SpatialVector b) {
+  return vec3_dot(a.angular, b.angular) + vec3_dot(a.linear, b.linear);
+}
+
+static inline struct SpatialVector spatial_cross_motion(struct SpatialVector velocity, struct SpatialVector motion) {
+  return (struct SpatialVector){.angular = vec3_cross_product(velocity.angular, motion.angular), .linear = vec3_add(vec3_cross_product(velocity.angular, motion.linear), vec3_cross_product(velocity.linear, motion.angular))};
+}
+
+static inline struct SpatialVector spatial_cross_force(struct SpatialVector velocity, struct SpatialVector force) {
+  return (struct SpatialVector){.angular = vec3_add(vec3_cross_product(velocity.angular, force.angular), vec3_cross_product(velocity.linear, force.linear)), .linear = vec3_cross_product(velocity.angular, force.linear)};
+}
+
+static struct SpatialVector spatial_transform(const float* matrix, struct SpatialVector vector) {
+  struct SpatialVector result;
+  for (unsigned int row = 0; row < 6; row++) {
+    float sum = 0.0f;
+    for (unsigned int column = 0; column < 6; column++)
+      sum += matrix[row * 6 + column] * spatial_get(vector, column);
+    spatial_set(&result, row, sum);
+  }
+  return result;
+}
+
+// Inertia of a body with its centre of mass at center, relative to the origin
+static void spatial_inertia(float* matrix, float mass, mat3 inertia, vec3 center) {
+  float skew[9] = {0.0f, -center.data[2], center.data[1], center.data[2], 0.0f, -center.data[0], -center.data[1], center.data[0], 0.0f};
+  float square = vec3_dot(center, center);
+
+  for (unsigned int row = 0; row < 3; row++)
+    for (unsigned int column = 0; column < 3; column++) {
+      float identity = (row == column) ? 1.0f : 0.0f;
+      matrix[row * 6 + column] = inertia.data[row * 3 + column] + mass * (square * identity - center.data[row] * center.data[column]);
+      matrix[row * 6 + column + 3] = mass * skew[row * 3 + column];
+      matrix[(row + 3) * 6 + column] = -mass * skew[row * 3 + column];
+      matrix[(row + 3) * 6 + column + 3] = mass * identity;
+    }
+}
+
+// Cholesky solve of a symmetric positive definite 6x6 system, zero when it does not factor
+static struct SpatialVector spatial_solve(const float* matrix, struct SpatialVector rhs) {
+  float l[ARTICULATION_SPATIAL_FLOATS];
+  float x[6];
+  memcpy(l, matrix, sizeof(l));
+
+  for (unsigned int j = 0; j < 6; j++) {
+    float d = l[j * 6 + j];
+    for (unsigned int k = 0; k < j; k++)
+      d -= l[j * 6 + k] * l[j * 6 + k];
+    if (d <= 0.0f)
+      return spatial_zero;
+
+    d = sqrtf(d);
+    l[j * 6 + j] = d;
+    for (unsigned int i = j + 1; i < 6; i++) {
+      float s = l[i * 6 + j];
+      for (unsigned int k = 0; k < j; k++)
+        s -= l[i * 6 + k] * l[j * 6 + k];
+      l[i * 6 + j] = s / d;
+    }
+  }
+
+  for (unsigned int i = 0; i < 6; i++) {
+    float s = spatial_get(rhs, i);
+    for (unsigned int k = 0; k < i; k++)
+      s -= l[i * 6 + k] * x[k];
+    x[i] = s / l[i * 6 + i];
+  }
+  for (unsigned int i = 6; i-- > 0;) {
+    float s = x[i];
+    for (unsigned int k = i + 1; k < 6; k++)
+      s -= l[k * 6 + i] * x[k];
+    x[i] = s / l[i * 6 + i];
+  }
+
+  struct SpatialVector result;
+  for (unsigned int i = 0; i < 6; i++)
+    spatial_set(&result, i, x[i]);
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static inline quat articulation_quaternion_multiply(quat a, quat b) {
+  return (quat){.data[0] = a.data[3] * b.data[0] + a.data[0] * b.data[3] + a.data[1] * b.data[2] - a.data[2] * b.data[1],
+                .data[1] = a.data[3] * b.data[1] - a.data[0] * b.data[2] + a.data[1] * b.data[3] + a.data[2] * b.data[0],
+                .data[2] = a.data[3] * b.data[2] + a.data[0] * b.data[1] - a.data[1] * b.data[0] + a.data[2] * b.data[3],
+                .data[3] = a.data[3] * b.data[3] - a.data[0] * b.data[0] - a.data[1] * b.data[1] - a.data[2] * b.data[2]};
+}
+
+static inline quat articulation_axis_angle(vec3 axis, float angle) {
+  float s = sinf(angle * 0.5f);
+  return (quat){.data[0] = axis.data[0] * s, .data[1] = axis.data[1] * s, .data[2] = axis.data[2] * s, .data[3] = cosf(angle * 0.5f)};
+}
+
+// Small rotation taking from onto to
+static inline vec3 articulation_rotation_between(quat from, quat to) {
+  quat conjugate = {.data[0] = -from.data[0], .data[1] = -from.data[1], .data[2] = -from.data[2], .data[3] = from.data[3]};
+  quat delta = articulation_quaternion_multiply(to, conjugate);
+  float sign = (delta.data[3] < 0.0f) ? -2.0f : 2.0f;
+  return (vec3){.data[0] = delta.data[0] * sign, .data[1] = delta.data[1] * sign, .data[2] = delta.data[2] * sign};
+}
+
+static inline vec3 articulation_unit(unsigned int k) {
+  vec3 unit = VEC3_ZERO;
+  unit.data[k] = 1.0f;
+  return unit;
+}
+
+static inline mat3 articulation_rotation_matrix(mat4 transform) {
+  return (mat3){.data = {transform.data[0], transform.data[1], transform.data[2], transform.data[4], transform.data[5], transform.data[6], transform.data[8], transform.data[9], transform.data[10]}};
+}
+
+static inline bool articulation_joint_is_movable(struct ArticulationLink* link) {
+  return link->joint_type == ARTICULATION_JOINT_REVOLUTE || link->joint_type == ARTICULATION_JOINT_PRISMATIC;
+}
+
+void articulation_init(struct Articulation* articulation, unsigned int link_capacity) {
+  articulation->link_count = 0;
+  articulation->link_capacity = link_capacity;
+  articulation->links = calloc(link_capacity, sizeof(struct ArticulationLink));
+  articulation->gravity = VEC3_ZERO;
+  articulation->origin = VEC3_ZERO;
+  articulation->root_position = VEC3_ZERO;
+  articulation->root_orientation = (quat){.data = {0.0f, 0.0f, 0.0f, 1.0f}};
+  articulation->root_velocity = VEC3_ZERO;
+  articulation->root_rotation = VEC3_ZERO;
+}
+
+void articulation_delete(struct Articulation* articulation) {
+  free(articulation->links);
+}
+
+static unsigned int articulation_push_link(struct Articulation* articulation, unsigned int parent, enum ArticulationJointType joint_type, float mass, mat3 inertia) {
+  if (articulation->link_count >= articulation->link_capacity)
+    return ARTICULATION_NO_LINK;
+
+  unsigned int index = articulation->link_count++;
+  struct ArticulationLink* link = &articulation->links[index];
+  memset(link, 0, sizeof(struct ArticulationLink));
+  link->parent = parent;
+  link->joint_type = joint_type;
+  link->mass = mass;
+  link->inertia = inertia;
+  link->orientation = (quat){.data = {0.0f, 0.0f, 0.0f, 1.0f}};
+
+  // NOTE: The stand in body never sleeps on its own, the articulation moves it every step
+  rigid_body_set_damping(&link->body, 1.0f, 1.0f);
+  link->body.orientation = link->orientation;
+  link->body.is_awake = true;
+  link->body.can_sleep = false;
+  return index;
+}
+
+// The root is fixed in place or free, with position its centre of mass
+unsigned int articulation_add_root(struct Articulation* articulation, enum ArticulationJointType joint_type, float mass, mat3 inertia, vec3 position, quat orientation) {
+  if (articulation->link_count != 0)
+    return ARTICULATION_NO_LINK;
+
+  unsigned int index = articulation_push_link(articulation, ARTICULATION_NO_LINK, (joint_type == ARTICULATION_JOINT_FREE) ? ARTICULATION_JOINT_FREE : ARTICULATION_JOINT_FIXED, mass, inertia);
+  articulation->root_position = position;
+  articulation->root_orientation = quaternion_normalise(orientation);
+  return index;
+}
+
+// NOTE: Free joints are only allowed at the root, the parent has to be added first
+unsigned int articulation_add_link(struct Articulation* articulation, unsigned int parent, enum ArticulationJointType joint_type, float mass, mat3 inertia, vec3 parent_anchor, vec3 child_anchor, vec3 axis) {
+  if (parent >= articulation->link_count || joint_type == ARTICULATION_JOINT_FREE)
+    return ARTICULATION_NO_LINK;
+
+  unsigned int index = articulation_push_link(articulation, parent, joint_type, mass, inertia);
+  if (index == ARTICULATION_NO_LINK)
+    return index;
+
+  struct ArticulationLink* link = &articulation->links[index];
+  link->parent_anchor = parent_anchor;
+  link->child_anchor = child_anchor;
+  link->axis = vec3_normalise(axis);
+  return index;
+}
+
+struct RigidBody* articulation_get_body(struct Articulation* articulation, unsigned int link) {
+  return (link < articulation->link_count) ? &articulation->links[link].body : NULL;
+}
+
+void articulation_set_gravity(struct Articulation* articulation, vec3 gravity) {
+  articulation->gravity = gravity;
+}
+
+// NOTE: A torque for a revolute joint and a force for a prismatic one, kept until changed
+void articulation_set_joint_force(struct Articulation* articulation, unsigned int link, float force) {
+  if (link < articulation->link_count)
+    articulation->links[link].force = force;
+}
+
+void articulation_set_joint_damping(struct Articulation* articulation, unsigned int link, float damping) {
+  if (link < articulation->link_count)
+    articulation->links[link].damping = damping;
+}
+
+// Poses, joint motion and spatial velocities from the joint coordinates, outward from the root.
+// The origin follows the root so the spatial quantities stay small.
+static void articulation_update_kinematics(struct Articulation* articulation) {
+  struct ArticulationLink* root = &articulation->links[0];
+  articulation->origin = articulation->root_position;
+  root->orientation = articulation->root_orientation;
+  root->center = articulation->root_position;
+  root->transform = rigid_body_calculate_transform_matrix(root->center, root->orientation);
+  root->motion = spatial_zero;
+  root->spatial_velocity = (struct SpatialVector){.angular = articulation->root_rotation, .linear = articulation->root_velocity};
+
+  for (unsigned int link_num = 1; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    struct ArticulationLink* parent = &articulation->links[link->parent];
+
+    vec3 anchor = link->parent_anchor;
+    link->orientation = parent->orientation;
+    if (link->joint_type == ARTICULATION_JOINT_REVOLUTE)
+      link->orientation = quaternion_normalise(articulation_quaternion_multiply(parent->orientation, articulation_axis_angle(link->axis, link->position)));
+    else if (link->joint_type == ARTICULATION_JOINT_PRISMATIC)
+      anchor = vec3_add_scaled_vector(anchor, link->axis, link->position);
+
+    vec3 joint = mat4_transform(parent->transform, anchor);
+    vec3 axis = mat4_transform_direction(parent->transform, link->axis);
+    link->transform = rigid_body_calculate_transform_matrix(VEC3_ZERO, link->orientation);
+    link->center = vec3_sub(joint, mat4_transform_direction(link->transform, link->child_anchor));
+    link->transform = rigid_body_calculate_transform_matrix(link->center, link->orientation);
+
+    if (link->joint_type == ARTICULATION_JOINT_REVOLUTE)
+      link->motion = (struct SpatialVector){.angular = axis, .linear = vec3_cross_product(vec3_sub(joint, articulation->origin), axis)};
+    else if (link->joint_type == ARTICULATION_JOINT_PRISMATIC)
+      link->motion = (struct SpatialVector){.angular = VEC3_ZERO, .linear = axis};
+    else
+      link->motion = spatial_zero;
+    link->spatial_velocity = spatial_add(parent->spatial_velocity, spatial_scale(link->motion, link->velocity));
+  }
+}
+
+static void articulation_link_inertia(struct Articulation* articulation, struct ArticulationLink* link, float* matrix) {
+  mat3 inertia = rigid_body_transform_inertia_tensor(link->inertia, link->transform);
+  spatial_inertia(matrix, link->mass, inertia, vec3_sub(link->center, articulation->origin));
+}
+
+// Articulated inertias inward from the leaves, children come after their parents so a
+// reverse sweep sees every child first. Joint damping over duration is implicit, it adds to the
+// inertia along the joint.
+static void articulation_update_inertias(struct Articulation* articulation, float duration) {
+  for (unsigned int link_num = 0; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    articulation_link_inertia(articulation, link, link->articulated_inertia);
+  }
+
+  for (unsigned int link_num = articulation->link_count; link_num-- > 1;) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    struct ArticulationLink* parent = &articulation->links[link->parent];
+
+    if (!articulation_joint_is_movable(link)) {
+      for (unsigned int k = 0; k < ARTICULATION_SPATIAL_FLOATS; k++)
+        parent->articulated_inertia[k] += link->articulated_inertia[k];
+      continue;
+    }
+
+    link->projected_inertia = spatial_transform(link->articulated_inertia, link->motion);
+    link->projected_mass = fmaxf(spatial_dot(link->motion, link->projected_inertia) + link->damping * duration, FLT_MIN);
+    for (unsigned int row = 0; row < 6; row++)
+      for (unsigned int column = 0; column < 6; column++)
+        parent->articulated_inertia[row * 6 + column] += link->articulated_inertia[row * 6 + column] - spatial_get(link->projected_inertia, row) * spatial_get(link->projected_inertia, column) / link->projected_mass;
+  }
+}
+
+// How each link's velocity answers an impulse on that same link, outward from the root:
+// response = P^T parent P + S S^T / D with P = 1 - U S^T / D
+static void articulation_update_response(struct Articulation* articulation) {
+  struct ArticulationLink* root = &articulation->links[0];
+  memset(root->response, 0, sizeof(root->response));
+  if (root->joint_type == ARTICULATION_JOINT_FREE)
+    for (unsigned int column = 0; column < 6; column++) {
+      struct SpatialVector unit = spatial_zero;
+      spatial_set(&unit, column, 1.0f);
+      struct SpatialVector answer = spatial_solve(root->articulated_inertia, unit);
+      for (unsigned int row = 0; row < 6; row++)
+        root->response[row * 6 + column] = spatial_get(answer, row);
+    }
+
+  for (unsigned int link_num = 1; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    struct ArticulationLink* parent = &articulation->links[link->parent];
+    if (!articulation_joint_is_movable(link)) {
+      memcpy(link->response, parent->response, sizeof(link->response));
+      continue;
+    }
+
+    float projected[ARTICULATION_SPATIAL_FLOATS];
+    struct SpatialVector parent_u = spatial_transform(parent->response, link->projected_inertia);
+    for (unsigned int row = 0; row < 6; row++)
+      for (unsigned int column = 0; column < 6; column++)
+        projected[row * 6 + column] = parent->response[row * 6 + column] - spatial_get(parent_u, row) * spatial_get(link->motion, column) / link->projected_mass;
+
+    for (unsigned int column = 0; column < 6; column++) {
+      float u_projected = 0.0f;
+      for (unsigned int k = 0; k < 6; k++)
+        u_projected += spatial_get(link->projected_inertia, k) * projected[k * 6 + column];
+      for (unsigned int row = 0; row < 6; row++)
+        link->response[row * 6 + column] = projected[row * 6 + column] + spatial_get(link->motion, row) * (spatial_get(link->motion, column) - u_projected) / link->projected_mass;
+    }
+  }
+}
+
+// The inward and outward sweeps of the articulated body algorithm. bias_force holds each link's
+// own bias force on entry, acceleration and acceleration_joint the results on exit. Without
+// the velocity terms the same sweeps turn impulses into velocity changes.
+static struct SpatialVector articulation_propagate(struct Articulation* articulation, bool velocity_terms) {
+  for (unsigned int link_num = articulation->link_count; link_num-- > 1;) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    struct ArticulationLink* parent = &articulation->links[link->parent];
+    struct SpatialVector passed = link->bias_force;
+
+    if (articulation_joint_is_movable(link)) {
+      float force = velocity_terms ? link->force - link->damping * link->velocity : 0.0f;
+      link->projected_force = force - spatial_dot(link->motion, link->bias_force);
+      passed = spatial_add(passed, spatial_scale(link->projected_inertia, link->projected_force / link->projected_mass));
+
+      if (velocity_terms) {
+        struct SpatialVector bias = spatial_transform(link->articulated_inertia, link->bias_acceleration);
+        float along = spatial_dot(link->projected_inertia, link->bias_acceleration) / link->projected_mass;
+        passed = spatial_add(passed, spatial_add(bias, spatial_scale(link->projected_inertia, -along)));
+      }
+    }
+    parent->bias_force = spatial_add(parent->bias_force, passed);
+  }
+
+  struct ArticulationLink* root = &articulation->links[0];
+  root->acceleration = spatial_zero;
+  if (root->joint_type == ARTICULATION_JOINT_FREE)
+    root->acceleration = spatial_solve(root->articulated_inertia, spatial_scale(root->bias_force, -1.0f));
+
+  for (unsigned int link_num = 1; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    struct ArticulationLink* parent = &articulation->links[link->parent];
+
+    link->acceleration = parent->acceleration;
+    if (velocity_terms)
+      link->acceleration = spatial_add(link->acceleration, link->bias_acceleration);
+
+    link->acceleration_joint = 0.0f;
+    if (articulation_joint_is_movable(link)) {
+      link->acceleration_joint = (link->projected_force - spatial_dot(link->projected_inertia, link->acceleration)) / link->projected_mass;
+      link->acceleration = spatial_add(link->acceleration, spatial_scale(link->motion, link->acceleration_joint));
+    }
+  }
+  return root->acceleration;
+}
+
+// Writes the poses and velocities into the stand in bodies, with each link's response inside
+// the articulation as its mass and inertia, taken at its centre of mass
+static void articulation_write_bodies(struct Articulation* articulation) {
+  for (unsigned int link_num = 0; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    struct RigidBody* body = &link->body;
+    vec3 center = vec3_sub(link->center, articulation->origin);
+
+    float inverse_mass = 0.0f;
+    mat3 inverse_inertia;
+    for (unsigned int k = 0; k < 3; k++) {
+      struct SpatialVector push = {.angular = vec3_cross_product(center, articulation_unit(k)), .linear = articulation_unit(k)};
+      struct SpatialVector answer = spatial_transform(link->response, push);
+      inverse_mass += vec3_sub(answer.linear, vec3_cross_product(center, answer.angular)).data[k] / 3.0f;
+      for (unsigned int row = 0; row < 3; row++)
+        inverse_inertia.data[row * 3 + k] = link->response[row * 6 + k];
+    }
+
+    mat3 rotation = articulation_rotation_matrix(link->transform);
+    body->inverse_mass = fmaxf(inverse_mass, 0.0f);
+    body->inverse_inertia_tensor = mat3_mul_mat3(mat3_mul_mat3(mat3_transpose(rotation), inverse_inertia), rotation);
+    body->position = link->center;
+    body->orientation = link->orientation;
+    body->velocity = vec3_add(link->spatial_velocity.linear, vec3_cross_product(link->spatial_velocity.angular, center));
+    body->rotation = link->spatial_velocity.angular;
+    body->is_awake = true;
+    rigid_body_calculate_derived_data(body);
+
+    link->written_position = body->position;
+    link->written_orientation = body->orientation;
+    link->written_velocity = body->velocity;
+    link->written_rotation = body->rotation;
+  }
+}
+
+void articulation_update_bodies(struct Articulation* articulation) {
+  if (articulation->link_count == 0)
+    return;
+
+  articulation_update_kinematics(articulation);
+  articulation_update_inertias(articulation, 0.0f);
+  articulation_update_response(articulation);
+  articulation_write_bodies(articulation);
+}
+
+// One semi-implicit Euler step of the joint coordinates, with the external forces stored on
+// the links
+static void articulation_step(struct Articulation* articulation, float duration) {
+  articulation_update_kinematics(articulation);
+  articulation_update_inertias(articulation, duration);
+
+  float inertia[ARTICULATION_SPATIAL_FLOATS];
+  for (unsigned int link_num = 0; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    vec3 center = vec3_sub(link->center, articulation->origin);
+    struct SpatialVector external = {.angular = vec3_add(link->external_torque, vec3_cross_product(center, link->external_force)), .linear = link->external_force};
+
+    articulation_link_inertia(articulation, link, inertia);
+    struct SpatialVector momentum = spatial_transform(inertia, link->spatial_velocity);
+    link->bias_force = spatial_add(spatial_cross_force(link->spatial_velocity, momentum), spatial_scale(external, -1.0f));
+    link->bias_acceleration = spatial_cross_motion(link->spatial_velocity, spatial_scale(link->motion, link->velocity));
+  }
+
+  struct SpatialVector root_acceleration = articulation_propagate(articulation, true);
+
+  if (articulation->links[0].joint_type == ARTICULATION_JOINT_FREE) {
+    // NOTE: The origin sits on the root's centre of mass, which also picks up the
+    // rotation carrying its velocity around
+    vec3 acceleration = vec3_add(root_acceleration.linear, vec3_cross_product(articulation->root_rotation, articulation->root_velocity));
+    articulation->root_velocity = vec3_add_scaled_vector(articulation->root_velocity, acceleration, duration);
+    articulation->root_rotation = vec3_add_scaled_vector(articulation->root_rotation, root_acceleration.angular, duration);
+    articulation->root_position = vec3_add_scaled_vector(articulation->root_position, articulation->root_velocity, duration);
+    articulation->root_orientation = quaternion_normalise(quaternion_add_scaled_vector(articulation->root_orientation, articulation->root_rotation, duration));
+  }
+
+  for (unsigned int link_num = 1; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    link->velocity += link->acceleration_joint * duration;
+    link->velocity = fmaxf(fminf(link->velocity, ARTICULATION_MAX_JOINT_SPEED), -ARTICULATION_MAX_JOINT_SPEED);
+    link->position += link->velocity * duration;
+  }
+}
+
+// Forces on the stand in bodies count as external forces, and are cleared with
+// clear_accumulators so substeps can keep them for the whole step. The velocity product
+// terms grow with the square of the spin, so the step is split until no link turns more than
+// ARTICULATION_MAX_STEP_ANGLE in one part.
+void articulation_integrate(struct Articulation* articulation, float duration, bool clear_accumulators) {
+  if (articulation->link_count == 0)
+    return;
+
+  float fastest = 0.0f;
+  for (unsigned int link_num = 0; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    link->external_force = vec3_add_scaled_vector(link->body.force_accum, articulation->gravity, link->mass);
+    link->external_torque = link->body.torque_accum;
+    if (clear_accumulators)
+      rigid_body_clear_accumulators(&link->body);
+    fastest = fmaxf(fastest, vec3_magnitude(link->spatial_velocity.angular));
+  }
+
+  float steps = fminf(ceilf(fastest * duration / ARTICULATION_MAX_STEP_ANGLE), (float)ARTICULATION_MAX_SUBSTEPS);
+  unsigned int substeps = (steps > 1.0f) ? (unsigned int)steps : 1;
+  for (unsigned int substep = 0; substep < substeps; substep++)
+    articulation_step(articulation, duration / (float)substeps);
+
+  articulation_update_bodies(articulation);
+}
+
+// Impulse that gives the stand in body the change it went through, through the mass and
+// inertia it was written with
+static struct SpatialVector articulation_body_impulse(struct Articulation* articulation, struct ArticulationLink* link, vec3 linear_change, vec3 angular_change) {
+  struct RigidBody* body = &link->body;
+  vec3 force = VEC3_ZERO;
+  vec3 torque = VEC3_ZERO;
+
+  if (body->inverse_mass > 0.0f)
+    force = vec3_scale(linear_change, 1.0f / body->inverse_mass);
+
+  mat3 inverse_inertia = body->inverse_inertia_tensor_world;
+  float trace = inverse_inertia.data[0] + inverse_inertia.data[4] + inverse_inertia.data[8];
+  if (trace > 0.0f) {
+    for (unsigned int k = 0; k < 3; k++)
+      inverse_inertia.data[k * 4] += trace * ARTICULATION_REGULARISE;
+    torque = mat3_transform(mat3_inverse(inverse_inertia), angular_change);
+  }
+
+  vec3 center = vec3_sub(link->center, articulation->origin);
+  return (struct SpatialVector){.angular = vec3_add(torque, vec3_cross_product(center, force)), .linear = force};
+}
+
+// Adds what articulation_propagate left behind to the velocities or to the positions
+static void articulation_apply_change(struct Articulation* articulation, struct SpatialVector root_change, bool velocity) {
+  if (articulation->links[0].joint_type == ARTICULATION_JOINT_FREE) {
+    if (velocity) {
+      articulation->root_velocity = vec3_add(articulation->root_velocity, root_change.linear);
+      articulation->root_rotation = vec3_add(articulation->root_rotation, root_change.angular);
+    } else {
+      articulation->root_position = vec3_add(articulation->root_position, root_change.linear);
+      articulation->root_orientation = quaternion_normalise(quaternion_add_scaled_vector(articulation->root_orientation, root_change.angular, 1.0f));
+    }
+  }
+
+  for (unsigned int link_num = 1; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    if (velocity)
+      link->velocity += link->acceleration_joint;
+    else
+      link->position += link->acceleration_joint;
+  }
+}
+
+// Reads back what the contacts did to the stand in bodies. Velocity changes go through the
+// tree as impulses and position changes as pseudo impulses, so every link moves consistently
+// with its joints, then the bodies are rewritten.
+void articulation_apply_contacts(struct Articulation* articulation) {
+  if (articulation->link_count == 0)
+    return;
+
+  bool velocity_changed = false;
+  bool position_changed = false;
+  for (unsigned int link_num = 0; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    struct RigidBody* body = &link->body;
+    link->bias_force = articulation_body_impulse(articulation, link, vec3_sub(body->velocity, link->written_velocity), vec3_sub(body->rotation, link->written_rotation));
+    velocity_changed |= spatial_dot(link->bias_force, link->bias_force) > 0.0f;
+    link->bias_force = spatial_scale(link->bias_force, -1.0f);
+  }
+  if (velocity_changed)
+    articulation_apply_change(articulation, articulation_propagate(articulation, false), true);
+
+  for (unsigned int link_num = 0; link_num < articulation->link_count; link_num++) {
+    struct ArticulationLink* link = &articulation->links[link_num];
+    struct RigidBody* body = &link->body;
+    link->bias_force = articulation_body_impulse(articulation, link, vec3_sub(body->position, link->written_position), articulation_rotation_between(link->written_orientation, body->orientation));
+    position_changed |= spatial_dot(link->bias_force, link->bias_force) > 0.0f;
+    link->bias_force = spatial_scale(link->bias_force, -1.0f);
+  }
+  if (position_changed)
+    articulation_apply_change(articulation, articulation_propagate(articulation, false), false);
+
+  if (velocity_changed || position_changed) {
+    articulation_update_kinematics(articulation);
+    articulation_write_bodies(articulation);
+  }
+}
@@ -1,5 +1,7 @@
 #include "chaos/core/body.h"
 
+#include "chaos/core/simd.h"
+
 mat3 rigid_body_transform_inertia_tensor(mat3 iit_body, mat4 rotmat) {
   float t4 = rotmat.data[0] * iit_body.data[0] + rotmat.data[1] * iit_body.data[3] + rotmat.data[2] * iit_body.data[6];
   float t9 = rotmat.data[0] * iit_body.data[1] + rotmat.data[1] * iit_body.data[4] + rotmat.data[2] * iit_body.data[7];
@@ -49,6 +51,89 @@ void rigid_body_calculate_derived_data(struct RigidBody* rigid_body) {
   rigid_body->orientation = quaternion_normalise(rigid_body->orientation);
   rigid_body->transform_matrix = rigid_body_calculate_transform_matrix(rigid_body->position, rigid_body->orientation);
   rigid_body->inverse_inertia_tensor_world = rigid_body_transform_inertia_tensor(rigid_body->inverse_inertia_tensor, rigid_body->transform_matrix);
+  rigid_body->is_dirty = false;
+}
+
+unsigned int rigid_body_get_batch_width(void) {
+  return SIMD_WIDTH;
+}
+
+// NOTE: Same arithmetic as rigid_body_calculate_derived_data, SIMD_WIDTH bodies per pass
+void rigid_body_calculate_derived_data_batch(struct RigidBody** bodies, unsigned int count) {
+  float q[4][SIMD_WIDTH], length_squared[SIMD_WIDTH], iit[9][SIMD_WIDTH], tm[9][SIMD_WIDTH], iitw[9][SIMD_WIDTH];
+
+  for (unsigned int first = 0; first < count; first += SIMD_WIDTH) {
+    unsigned int lanes = (count - first < SIMD_WIDTH) ? count - first : SIMD_WIDTH;
+
+    for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++) {
+      struct RigidBody* body = bodies[first + (lane < lanes ? lane : 0)];
+      for (unsigned int i = 0; i < 4; i++)
+        q[i][lane] = body->orientation.data[i];
+      for (unsigned int i = 0; i < 9; i++)
+        iit[i][lane] = body->inverse_inertia_tensor.data[i];
+    }
+
+    simd_float one = simd_set(1.0f);
+    simd_float two = simd_set(2.0f);
+
+    simd_float x = simd_load(q[0]), y = simd_load(q[1]), z = simd_load(q[2]), w = simd_load(q[3]);
+    simd_float d = simd_add(simd_add(simd_add(simd_mul(x, x), simd_mul(y, y)), simd_mul(z, z)), simd_mul(w, w));
+    simd_store(length_squared, d);
+    simd_float scale = simd_div(one, simd_sqrt(d));
+    x = simd_mul(x, scale);
+    y = simd_mul(y, scale);
+    z = simd_mul(z, scale);
+    w = simd_mul(w, scale);
+    simd_store(q[0], x);
+    simd_store(q[1], y);
+    simd_store(q[2], z);
+    simd_store(q[3], w);
+
+    simd_float r[9];
+    r[0] = simd_sub(simd_sub(one, simd_mul(simd_mul(two, y), y)), simd_mul(simd_mul(two, z), z));
+    r[1] = simd_sub(simd_mul(simd_mul(two, x), y), simd_mul(simd_mul(two, w), z));
+    r[2] = simd_add(simd_mul(simd_mul(two, x), z), simd_mul(simd_mul(two, w), y));
+    r[3] = simd_add(simd_mul(simd_mul(two, x), y), simd_mul(simd_mul(two, w), z));
+    r[4] = simd_sub(simd_sub(one, simd_mul(simd_mul(two, x), x)), simd_mul(simd_mul(two, z), z));
+    r[5] = simd_sub(simd_mul(simd_mul(two, y), z), simd_mul(simd_mul(two, w), x));
+    r[6] = simd_sub(simd_mul(simd_mul(two, x), z), simd_mul(simd_mul(two, w), y));
+    r[7] = simd_add(simd_mul(simd_mul(two, y), z), simd_mul(simd_mul(two, w), x));
+    r[8] = simd_sub(simd_sub(one, simd_mul(simd_mul(two, x), x)), simd_mul(simd_mul(two, y), y));
+    for (unsigned int i = 0; i < 9; i++)
+      simd_store(tm[i], r[i]);
+
+    simd_float t[9];
+    for (unsigned int row = 0; row < 3; row++)
+      for (unsigned int col = 0; col < 3; col++)
+        t[row * 3 + col] = simd_add(simd_add(simd_mul(r[row * 3 + 0], simd_load(iit[col])), simd_mul(r[row * 3 + 1], simd_load(iit[3 + col]))), simd_mul(r[row * 3 + 2], simd_load(iit[6 + col])));
+
+    for (unsigned int row = 0; row < 3; row++)
+      for (unsigned int col = 0; col < 3; col++)
+        simd_store(iitw[row * 3 + col], simd_add(simd_add(simd_mul(t[row * 3 + 0], r[col * 3 + 0]), simd_mul(t[row * 3 + 1], r[col * 3 + 1])), simd_mul(t[row * 3 + 2], r[col * 3 + 2])));
+
+    for (unsigned int lane = 0; lane < lanes; lane++) {
+      struct RigidBody* body = bodies[first + lane];
+
+      // Degenerate orientations take the scalar path so they normalise exactly as before
+      if (!(length_squared[lane] > FLT_EPSILON)) {
+        rigid_body_calculate_derived_data(body);
+        continue;
+      }
+
+      for (unsigned int i = 0; i < 4; i++)
+        body->orientation.data[i] = q[i][lane];
+      for (unsigned int row = 0; row < 3; row++) {
+        for (unsigned int col = 0; col < 3; col++)
+          body->transform_matrix.data[row * 4 + col] = tm[row * 3 + col][lane];
+        body->transform_matrix.data[row * 4 + 3] = body->position.data[row];
+      }
+      body->transform_matrix.data[12] = body->transform_matrix.data[13] = body->transform_matrix.data[14] = 0.0f;
+      body->transform_matrix.data[15] = 1.0f;
+      for (unsigned int i = 0; i < 9; i++)
+        body->inverse_inertia_tensor_world.data[i] = iitw[i][lane];
+      body->is_dirty = false;
+    }
+  }
 }
 
 void rigid_body_integrate(struct RigidBody* rigid_body, float duration) {
@@ -71,19 +156,27 @@ void rigid_body_integrate(struct RigidBody* rigid_body, float duration) {
 
   rigid_body_calculate_derived_data(rigid_body);
   rigid_body_clear_accumulators(rigid_body);
+  rigid_body_update_sleep_state(rigid_body, duration);
+}
 
+void rigid_body_update_motion(struct RigidBody* rigid_body, float duration) {
   if (rigid_body->can_sleep) {
     float current_motion = vec3_magnitude(rigid_body->velocity) + vec3_magnitude(rigid_body->rotation);
     float bias = powf(0.5, duration);
     rigid_body->motion = bias * rigid_body->motion + (1 - bias) * current_motion;
 
-    if (rigid_body->motion < SLEEP_EPSILON)
-      rigid_body_set_awake(rigid_body, false);
-    else if (rigid_body->motion > 10 * SLEEP_EPSILON)
+    if (rigid_body->motion > 10 * SLEEP_EPSILON)
       rigid_body->motion = 10 * SLEEP_EPSILON;
   }
 }
 
+void rigid_body_update_sleep_state(struct RigidBody* rigid_body, float duration) {
+  rigid_body_update_motion(rigid_body, duration);
+
+  if (rigid_body->can_sleep && rigid_body->motion < SLEEP_EPSILON)
+    rigid_body_set_awake(rigid_body, false);
+}
+
 void rigid_body_set_mass(struct RigidBody* rigid_body, float mass) {
   rigid_body->inverse_mass = 1.0f / mass;
 }
@@ -105,6 +198,7 @@ bool rigid_body_has_finite_mass(struct RigidBody* rigid_body) {
 
 void rigid_body_set_inertia_tensor(struct RigidBody* rigid_body, mat3 inertia_tensor) {
   rigid_body->inverse_inertia_tensor = mat3_inverse(inertia_tensor);
+  rigid_body->is_dirty = true;
 }
 
 mat3 rigid_body_get_inertia_tensor(struct RigidBody* rigid_body) {
@@ -120,10 +214,12 @@ void rigid_body_set_position_xyz(struct RigidBody* rigid_body, float x, float y,
   rigid_body->position.x = x;
   rigid_body->position.y = y;
   rigid_body->position.z = z;
+  rigid_body->is_dirty = true;
 }
 
 void rigid_body_set_orientation_rijk(struct RigidBody* rigid_body, float r, float i, float j, float k) {
   rigid_body->orientation = quaternion_normalise((quat){.data[0] = r, .data[1] = i, .data[2] = j, .data[3] = k});
+  rigid_body->is_dirty = true;
 }
 
 void rigid_body_get_transform_4x4(struct RigidBody* rigid_body, mat4 matrix) {
@@ -197,6 +293,11 @@ void rigid_body_set_awake(struct RigidBody* rigid_body, bool awake) {
   }
 }
 
+// NOTE: Call after writing position, orientation or the inertia tensor directly
+void rigid_body_mark_dirty(struct RigidBody* rigid_body) {
+  rigid_body->is_dirty = true;
+}
+
 void rigid_body_set_can_sleep(struct RigidBody* rigid_body, bool can_sleep) {
   rigid_body->can_sleep = can_sleep;
 
@@ -0,0 +1,412 @@
+#include "chaos/core/bodypool.h"
+
+#include "chaos/core/simd.h"
+
+#define BODY_POOL_LANE_FLOATS 37
+// NOTE: Lane capacities are powers of two, without padding every lane array would start on the
+// same cache set and the gather and scatter would keep evicting their own lines
+#define BODY_POOL_LANE_PADDING 16
+
+static inline void body_pool_resize(struct BodyPool* body_pool, unsigned int capacity) {
+  struct RigidBody** new_bodies = realloc(body_pool->bodies, sizeof(struct RigidBody*) * capacity);
+  if (new_bodies)
+    body_pool->bodies = new_bodies;
+
+  unsigned int* new_body_slot = realloc(body_pool->body_slot, sizeof(unsigned int) * capacity);
+  if (new_body_slot)
+    body_pool->body_slot = new_body_slot;
+
+  struct BodySlot* new_slots = realloc(body_pool->slots, sizeof(struct BodySlot) * capacity);
+  if (new_slots)
+    body_pool->slots = new_slots;
+
+  if (new_bodies && new_body_slot && new_slots)
+    body_pool->capacity = capacity;
+}
+
+static inline void body_pool_resize_lanes(struct BodyPool* body_pool, unsigned int lane_capacity) {
+  free(body_pool->lane_body);
+  free(body_pool->lane_data);
+
+  body_pool->lane_capacity = lane_capacity;
+  body_pool->lane_body = malloc(sizeof(struct RigidBody*) * lane_capacity);
+  body_pool->lane_stride = lane_capacity + BODY_POOL_LANE_PADDING;
+  body_pool->lane_data = calloc((size_t)body_pool->lane_stride * BODY_POOL_LANE_FLOATS, sizeof(float));
+
+  float* lane = body_pool->lane_data;
+  body_pool->inverse_mass = lane;
+  body_pool->linear_damping = (lane += body_pool->lane_stride);
+  body_pool->angular_damping = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 3; i++)
+    body_pool->position[i] = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 4; i++)
+    body_pool->orientation[i] = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 3; i++)
+    body_pool->velocity[i] = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 3; i++)
+    body_pool->rotation[i] = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 3; i++)
+    body_pool->force_accum[i] = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 3; i++)
+    body_pool->torque_accum[i] = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 3; i++)
+    body_pool->acceleration[i] = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 3; i++)
+    body_pool->last_frame_acceleration[i] = (lane += body_pool->lane_stride);
+  for (unsigned int i = 0; i < 9; i++)
+    body_pool->inverse_inertia_tensor_world[i] = (lane += body_pool->lane_stride);
+}
+
+void body_pool_init(struct BodyPool* body_pool) {
+  body_pool->size = 0;
+  body_pool->capacity = 0;
+  body_pool->bodies = NULL;
+  body_pool->body_slot = NULL;
+  body_pool->slot_count = 0;
+  body_pool->free_slot = BODY_POOL_NO_SLOT;
+  body_pool->slots = NULL;
+  body_pool->block_count = 0;
+  body_pool->blocks = NULL;
+  body_pool->lane_count = 0;
+  body_pool->lane_capacity = 0;
+  body_pool->lane_body = NULL;
+  body_pool->lane_data = NULL;
+  body_pool->chunk_capacity = 0;
+  body_pool->chunk_lane = NULL;
+
+  body_pool_resize(body_pool, BODY_POOL_INIT_CAPACITY);
+  body_pool_resize_lanes(body_pool, simd_round_up(BODY_POOL_INIT_CAPACITY));
+}
+
+void body_pool_delete(struct BodyPool* body_pool) {
+  free(body_pool->bodies);
+  free(body_pool->body_slot);
+  free(body_pool->slots);
+  for (unsigned int block_num = 0; block_num < body_pool->block_count; block_num++)
+    free(body_pool->blocks[block_num]);
+  free(body_pool->blocks);
+  free(body_pool->lane_body);
+  free(body_pool->lane_data);
+  free(body_pool->chunk_lane);
+}
+
+static inline struct RigidBody* body_pool_storage(struct BodyPool* body_pool, unsigned int slot) {
+  return &body_pool->blocks[slot / BODY_POOL_BLOCK_SIZE][slot % BODY_POOL_BLOCK_SIZE];
+}
+
+// Blocks are only ever added, the bodies already stored keep their addresses
+static inline void body_pool_add_block(struct BodyPool* body_pool) {
+  body_pool->blocks = realloc(body_pool->blocks, sizeof(struct RigidBody*) * (body_pool->block_count + 1));
+  body_pool->blocks[body_pool->block_count++] = malloc(sizeof(struct RigidBody) * BODY_POOL_BLOCK_SIZE);
+}
+
+struct BodyHandle body_pool_add(struct BodyPool* body_pool, const struct RigidBody* body) {
+  if (body_pool->size == body_pool->capacity)
+    body_pool_resize(body_pool, body_pool->capacity * BODY_POOL_RESIZE_FACTOR);
+
+  unsigned int slot = body_pool->free_slot;
+  if (slot != BODY_POOL_NO_SLOT)
+    body_pool->free_slot = body_pool->slots[slot].index;
+  else {
+    slot = body_pool->slot_count++;
+    body_pool->slots[slot].generation = 1;
+    if (slot / BODY_POOL_BLOCK_SIZE == body_pool->block_count)
+      body_pool_add_block(body_pool);
+  }
+
+  struct RigidBody* stored = body_pool_storage(body_pool, slot);
+  *stored = *body;
+
+  unsigned int index = body_pool->size++;
+  body_pool->slots[slot].index = index;
+  body_pool->bodies[index] = stored;
+  body_pool->body_slot[index] = slot;
+
+  return (struct BodyHandle){.slot = slot, .generation = body_pool->slots[slot].generation};
+}
+
+// NOTE: Swaps the last body into the freed index so the registry stays dense
+bool body_pool_remove(struct BodyPool* body_pool, struct BodyHandle handle) {
+  if (!body_pool_is_valid(body_pool, handle))
+    return false;
+
+  struct BodySlot* slot = &body_pool->slots[handle.slot];
+  unsigned int index = slot->index;
+  unsigned int last = --body_pool->size;
+
+  body_pool->bodies[index] = body_pool->bodies[last];
+  body_pool->body_slot[index] = body_pool->body_slot[last];
+  body_pool->slots[body_pool->body_slot[index]].index = index;
+
+  slot->generation++;
+  slot->index = body_pool->free_slot;
+  body_pool->free_slot = handle.slot;
+
+  return true;
+}
+
+void body_pool_clear(struct BodyPool* body_pool) {
+  for (unsigned int body_num = 0; body_num < body_pool->size; body_num++) {
+    struct BodySlot* slot = &body_pool->slots[body_pool->body_slot[body_num]];
+    slot->generation++;
+    slot->index = body_pool->free_slot;
+    body_pool->free_slot = body_pool->body_slot[body_num];
+  }
+
+  body_pool->size = 0;
+  body_pool->lane_count = 0;
+}
+
+bool body_pool_is_valid(struct BodyPool* body_pool, struct BodyHandle handle) {
+  if (handle.slot >= body_pool->slot_count)
+    return false;
+
+  struct BodySlot* slot = &body_pool->slots[handle.slot];
+  return slot->generation == handle.generation && slot->index < body_pool->size && body_pool->body_slot[slot->index] == handle.slot;
+}
+
+struct RigidBody* body_pool_get(struct BodyPool* body_pool, struct BodyHandle handle) {
+  if (body_pool_is_valid(body_pool, handle))
+    return body_pool_storage(body_pool, handle.slot);
+  return NULL;
+}
+
+unsigned int body_pool_get_index(struct BodyPool* body_pool, struct BodyHandle handle) {
+  if (body_pool_is_valid(body_pool, handle))
+    return body_pool->slots[handle.slot].index;
+  return BODY_POOL_NO_SLOT;
+}
+
+struct BodyPoolStep {
+  struct BodyPool* body_pool;
+  float duration;
+  bool clear_accumulators;
+};
+
+static void body_pool_derived_data_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct BodyPool* body_pool = data;
+  struct RigidBody* dirty[BODY_POOL_BATCH_SIZE];
+  unsigned int dirty_count = 0;
+
+  for (unsigned int body_num = begin; body_num < end; body_num++) {
+    if (!body_pool->bodies[body_num]->is_dirty)
+      continue;
+
+    dirty[dirty_count++] = body_pool->bodies[body_num];
+    if (dirty_count == BODY_POOL_BATCH_SIZE) {
+      rigid_body_calculate_derived_data_batch(dirty, dirty_count);
+      dirty_count = 0;
+    }
+  }
+  rigid_body_calculate_derived_data_batch(dirty, dirty_count);
+}
+
+// Only bodies whose position, orientation or inertia changed since their last update are recalculated
+void body_pool_calculate_derived_data(struct BodyPool* body_pool, struct JobScheduler* scheduler) {
+  job_scheduler_parallel_for(scheduler, body_pool->size, BODY_POOL_CHUNK_SIZE, body_pool_derived_data_range, body_pool);
+}
+
+static void body_pool_count_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct BodyPool* body_pool = data;
+
+  for (unsigned int chunk = begin; chunk < end; chunk++) {
+    unsigned int last = (chunk + 1) * BODY_POOL_CHUNK_SIZE < body_pool->size ? (chunk + 1) * BODY_POOL_CHUNK_SIZE : body_pool->size;
+    unsigned int awake = 0;
+    for (unsigned int body_num = chunk * BODY_POOL_CHUNK_SIZE; body_num < last; body_num++)
+      awake += body_pool->bodies[body_num]->is_awake;
+    body_pool->chunk_lane[chunk] = awake;
+  }
+}
+
+// Chunks in one range are consecutive, so their lanes follow on from the first chunk's. Returns
+// the lane after the last one written.
+static unsigned int body_pool_gather_chunks(struct BodyPool* body_pool, unsigned int begin, unsigned int end, float duration) {
+  unsigned int lane = body_pool->chunk_lane[begin];
+
+  // NOTE: Bodies mostly share a few damping values, so the last power of each is kept
+  float linear_damping = 1.0f, linear_power = 1.0f;
+  float angular_damping = 1.0f, angular_power = 1.0f;
+
+  for (unsigned int chunk = begin; chunk < end; chunk++) {
+    unsigned int last = (chunk + 1) * BODY_POOL_CHUNK_SIZE < body_pool->size ? (chunk + 1) * BODY_POOL_CHUNK_SIZE : body_pool->size;
+    for (unsigned int body_num = chunk * BODY_POOL_CHUNK_SIZE; body_num < last; body_num++) {
+      struct RigidBody* body = body_pool->bodies[body_num];
+      if (!body->is_awake)
+        continue;
+
+      body_pool->lane_body[lane] = body;
+      body_pool->inverse_mass[lane] = body->inverse_mass;
+      if (body->linear_damping != linear_damping) {
+        linear_damping = body->linear_damping;
+        linear_power = powf(linear_damping, duration);
+      }
+      if (body->angular_damping != angular_damping) {
+        angular_damping = body->angular_damping;
+        angular_power = powf(angular_damping, duration);
+      }
+      body_pool->linear_damping[lane] = linear_power;
+      body_pool->angular_damping[lane] = angular_power;
+      for (unsigned int i = 0; i < 3; i++) {
+        body_pool->position[i][lane] = body->position.data[i];
+        body_pool->velocity[i][lane] = body->velocity.data[i];
+        body_pool->rotation[i][lane] = body->rotation.data[i];
+        body_pool->force_accum[i][lane] = body->force_accum.data[i];
+        body_pool->torque_accum[i][lane] = body->torque_accum.data[i];
+        body_pool->acceleration[i][lane] = body->acceleration.data[i];
+      }
+      for (unsigned int i = 0; i < 4; i++)
+        body_pool->orientation[i][lane] = body->orientation.data[i];
+      for (unsigned int i = 0; i < 9; i++)
+        body_pool->inverse_inertia_tensor_world[i][lane] = body->inverse_inertia_tensor_world.data[i];
+      lane++;
+    }
+  }
+  return lane;
+}
+
+static void body_pool_gather_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  body_pool_gather_chunks(((struct BodyPoolStep*)data)->body_pool, begin, end, ((struct BodyPoolStep*)data)->duration);
+}
+
+// Awake bodies are packed into lanes in registry order. Each chunk counts its awake bodies,
+// a prefix sum turns the counts into lane offsets and then the chunks gather independently.
+// On one thread the chunks are gathered in one pass instead, without counting first.
+void body_pool_gather(struct BodyPool* body_pool, struct JobScheduler* scheduler, float duration) {
+  if (body_pool->lane_capacity < simd_round_up(body_pool->size))
+    body_pool_resize_lanes(body_pool, simd_round_up(body_pool->capacity));
+
+  unsigned int chunks = (body_pool->size + BODY_POOL_CHUNK_SIZE - 1) / BODY_POOL_CHUNK_SIZE;
+  if (body_pool->chunk_capacity < chunks) {
+    free(body_pool->chunk_lane);
+    body_pool->chunk_capacity = chunks;
+    body_pool->chunk_lane = malloc(sizeof(unsigned int) * chunks);
+  }
+
+  unsigned int lane = 0;
+  if (job_scheduler_thread_count(scheduler) == 1) {
+    if (chunks > 0) {
+      body_pool->chunk_lane[0] = 0;
+      lane = body_pool_gather_chunks(body_pool, 0, chunks, duration);
+    }
+    body_pool->lane_count = lane;
+  } else {
+    job_scheduler_parallel_for(scheduler, chunks, 1, body_pool_count_range, body_pool);
+
+    for (unsigned int chunk = 0; chunk < chunks; chunk++) {
+      unsigned int awake = body_pool->chunk_lane[chunk];
+      body_pool->chunk_lane[chunk] = lane;
+      lane += awake;
+    }
+    body_pool->lane_count = lane;
+
+    struct BodyPoolStep step = {.body_pool = body_pool, .duration = duration};
+    job_scheduler_parallel_for(scheduler, chunks, 1, body_pool_gather_range, &step);
+  }
+
+  // Padding lanes are integrated with the rest of the register but never scattered back
+  for (unsigned int i = 0; i < BODY_POOL_LANE_FLOATS; i++)
+    for (unsigned int pad = lane; pad < simd_round_up(lane); pad++)
+      body_pool->lane_data[(size_t)i * body_pool->lane_stride + pad] = 0.0f;
+}
+
+// NOTE: Mirrors rigid_body_integrate operation for operation so batched bodies match scalar ones,
+// except that sleeping is left to the world's island pass
+void body_pool_integrate_lanes(struct BodyPool* body_pool, unsigned int first_lane, unsigned int last_lane, float duration) {
+  simd_float dt = simd_set(duration);
+  simd_float half = simd_set(0.5f);
+
+  for (unsigned int lane = first_lane; lane < last_lane; lane += SIMD_WIDTH) {
+    simd_float inverse_mass = simd_load(body_pool->inverse_mass + lane);
+    simd_float linear_damping = simd_load(body_pool->linear_damping + lane);
+    simd_float angular_damping = simd_load(body_pool->angular_damping + lane);
+
+    simd_float torque[3], velocity[3], rotation[3];
+    for (unsigned int i = 0; i < 3; i++)
+      torque[i] = simd_load(body_pool->torque_accum[i] + lane);
+
+    for (unsigned int i = 0; i < 3; i++) {
+      simd_float last_frame_acceleration = simd_add(simd_load(body_pool->acceleration[i] + lane), simd_mul(simd_load(body_pool->force_accum[i] + lane), inverse_mass));
+      simd_store(body_pool->last_frame_acceleration[i] + lane, last_frame_acceleration);
+
+      simd_float angular_acceleration = simd_mul(torque[0], simd_load(body_pool->inverse_inertia_tensor_world[i * 3 + 0] + lane));
+      angular_acceleration = simd_add(angular_acceleration, simd_mul(torque[1], simd_load(body_pool->inverse_inertia_tensor_world[i * 3 + 1] + lane)));
+      angular_acceleration = simd_add(angular_acceleration, simd_mul(torque[2], simd_load(body_pool->inverse_inertia_tensor_world[i * 3 + 2] + lane)));
+
+      velocity[i] = simd_add(simd_load(body_pool->velocity[i] + lane), simd_mul(last_frame_acceleration, dt));
+      rotation[i] = simd_add(simd_load(body_pool->rotation[i] + lane), simd_mul(angular_acceleration, dt));
+
+      velocity[i] = simd_mul(velocity[i], linear_damping);
+      rotation[i] = simd_mul(rotation[i], angular_damping);
+
+      simd_store(body_pool->velocity[i] + lane, velocity[i]);
+      simd_store(body_pool->rotation[i] + lane, rotation[i]);
+      simd_store(body_pool->position[i] + lane, simd_add(simd_load(body_pool->position[i] + lane), simd_mul(velocity[i], dt)));
+    }
+
+    // Quaternion (x, y, z, w) += 0.5 * (0, rotation * duration) * orientation
+    simd_float qx = simd_load(body_pool->orientation[0] + lane);
+    simd_float qy = simd_load(body_pool->orientation[1] + lane);
+    simd_float qz = simd_load(body_pool->orientation[2] + lane);
+    simd_float qw = simd_load(body_pool->orientation[3] + lane);
+    simd_float i = simd_mul(rotation[0], dt);
+    simd_float j = simd_mul(rotation[1], dt);
+    simd_float k = simd_mul(rotation[2], dt);
+
+    simd_float r = simd_sub(simd_sub(simd_sub(simd_zero(), simd_mul(i, qx)), simd_mul(j, qy)), simd_mul(k, qz));
+    simd_float x = simd_sub(simd_add(simd_mul(i, qw), simd_mul(j, qz)), simd_mul(k, qy));
+    simd_float y = simd_sub(simd_add(simd_mul(j, qw), simd_mul(k, qx)), simd_mul(i, qz));
+    simd_float z = simd_sub(simd_add(simd_mul(k, qw), simd_mul(i, qy)), simd_mul(j, qx));
+
+    simd_store(body_pool->orientation[0] + lane, simd_add(qx, simd_mul(x, half)));
+    simd_store(body_pool->orientation[1] + lane, simd_add(qy, simd_mul(y, half)));
+    simd_store(body_pool->orientation[2] + lane, simd_add(qz, simd_mul(z, half)));
+    simd_store(body_pool->orientation[3] + lane, simd_add(qw, simd_mul(r, half)));
+  }
+}
+
+// NOTE: With substeps the forces have to last the whole step, so only the last substep clears them
+void body_pool_scatter(struct BodyPool* body_pool, unsigned int first_lane, unsigned int last_lane, float duration, bool clear_accumulators) {
+  if (last_lane > body_pool->lane_count)
+    last_lane = body_pool->lane_count;
+
+  for (unsigned int lane = first_lane; lane < last_lane; lane++) {
+    struct RigidBody* body = body_pool->lane_body[lane];
+
+    for (unsigned int i = 0; i < 3; i++) {
+      body->position.data[i] = body_pool->position[i][lane];
+      body->velocity.data[i] = body_pool->velocity[i][lane];
+      body->rotation.data[i] = body_pool->rotation[i][lane];
+      body->last_frame_acceleration.data[i] = body_pool->last_frame_acceleration[i][lane];
+    }
+    for (unsigned int i = 0; i < 4; i++)
+      body->orientation.data[i] = body_pool->orientation[i][lane];
+  }
+
+  if (first_lane < last_lane)
+    rigid_body_calculate_derived_data_batch(body_pool->lane_body + first_lane, last_lane - first_lane);
+
+  for (unsigned int lane = first_lane; lane < last_lane; lane++) {
+    if (clear_accumulators)
+      rigid_body_clear_accumulators(body_pool->lane_body[lane]);
+    rigid_body_update_motion(body_pool->lane_body[lane], duration);
+  }
+}
+
+// Integrates and scatters a batch at a time, so the lanes and the bodies written back are still
+// in cache when the scatter and the derived data reach them
+static void body_pool_integrate_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct BodyPoolStep* step = data;
+
+  for (unsigned int first_lane = begin * SIMD_WIDTH; first_lane < end * SIMD_WIDTH; first_lane += BODY_POOL_BATCH_SIZE) {
+    unsigned int last_lane = first_lane + BODY_POOL_BATCH_SIZE < end * SIMD_WIDTH ? first_lane + BODY_POOL_BATCH_SIZE : end * SIMD_WIDTH;
+    body_pool_integrate_lanes(step->body_pool, first_lane, last_lane, step->duration);
+    body_pool_scatter(step->body_pool, first_lane, last_lane, step->duration, step->clear_accumulators);
+  }
+}
+
+void body_pool_integrate(struct BodyPool* body_pool, struct JobScheduler* scheduler, float duration, bool clear_accumulators) {
+  body_pool_gather(body_pool, scheduler, duration);
+
+  struct BodyPoolStep step = {.body_pool = body_pool, .duration = duration, .clear_accumulators = clear_accumulators};
+  job_scheduler_parallel_for(scheduler, simd_round_up(body_pool->lane_count) / SIMD_WIDTH, BODY_POOL_CHUNK_SIZE / SIMD_WIDTH, body_pool_integrate_range, &step);
+}
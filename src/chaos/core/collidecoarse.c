@@ -1,163 +1,343 @@
 #include "chaos/core/collidecoarse.h"
 
-static inline void bounding_sphere_init(struct BoundingSphere* bounding_sphere, vec3 centre, float radius) {
-  bounding_sphere->centre = centre;
-  bounding_sphere->radius = radius;
-}
-
-static inline void bounding_sphere_init_two(struct BoundingSphere* bounding_sphere, struct BoundingSphere* one, struct BoundingSphere* two) {
-  vec3 centre_offset;
-  centre_offset = vec3_sub(two->centre, one->centre);
-  float distance = vec3_square_magnitude(centre_offset);
-  float radius_diff = two->radius - one->radius;
-
-  if (radius_diff * radius_diff >= distance) {
-    if (one->radius > two->radius) {
-      bounding_sphere->centre = one->centre;
-      bounding_sphere->radius = one->radius;
-    } else {
-      bounding_sphere->centre = two->centre;
-      bounding_sphere->radius = two->radius;
-    }
-  }
-
-  else {
-    distance = sqrtf(distance);
-    bounding_sphere->radius = (distance + one->radius + two->radius) * 0.5f;
-
-    bounding_sphere->centre = one->centre;
-    if (distance > 0)
-      bounding_sphere->centre = vec3_add(bounding_sphere->centre, vec3_scale(centre_offset, ((bounding_sphere->radius - one->radius) / distance)));
-  }
+static inline bool bvh_tree_is_leaf(struct BVHNode* node) {
+  return node->children[0] == BVH_NULL;
 }
 
-static inline bool bounding_sphere_overlaps(struct BoundingSphere* bounding_sphere, struct BoundingSphere* other) {
-  float distance_squared = vec3_square_magnitude(vec3_sub(bounding_sphere->centre, other->centre));
-  return distance_squared < (bounding_sphere->radius + other->radius) * (bounding_sphere->radius + other->radius);
+static void bvh_tree_grow(struct BVHTree* bvh_tree, uint32_t node_capacity) {
+  uint32_t old_capacity = bvh_tree->node_capacity;
+  bvh_tree->node_capacity = node_capacity;
+  bvh_tree->nodes = realloc(bvh_tree->nodes, sizeof(struct BVHNode) * node_capacity);
+  for (uint32_t node_num = old_capacity; node_num < node_capacity; node_num++)
+    bvh_tree->nodes[node_num].parent = node_num + 1 < node_capacity ? node_num + 1 : bvh_tree->free_list;
+  bvh_tree->free_list = old_capacity;
 }
 
-static inline float bounding_sphere_get_growth(struct BoundingSphere* bounding_sphere, struct BoundingSphere* other) {
-  struct BoundingSphere new_sphere;
-  bounding_sphere_init_two(&new_sphere, bounding_sphere, other);
-
-  return new_sphere.radius * new_sphere.radius - bounding_sphere->radius * bounding_sphere->radius;
+static uint32_t bvh_tree_allocate_node(struct BVHTree* bvh_tree) {
+  if (bvh_tree->free_list == BVH_NULL)
+    bvh_tree_grow(bvh_tree, bvh_tree->node_capacity ? bvh_tree->node_capacity * 2 : 16);
+
+  uint32_t node_num = bvh_tree->free_list;
+  struct BVHNode* node = &bvh_tree->nodes[node_num];
+  bvh_tree->free_list = node->parent;
+  node->parent = BVH_NULL;
+  node->children[0] = node->children[1] = BVH_NULL;
+  node->body = NULL;
+  bvh_tree->node_count++;
+  return node_num;
 }
 
-static inline float bounding_sphere_get_size(struct BoundingSphere* bounding_sphere) {
-  return 1.333333f * UM_PI * bounding_sphere->radius * bounding_sphere->radius * bounding_sphere->radius;
+static void bvh_tree_free_node(struct BVHTree* bvh_tree, uint32_t node_num) {
+  bvh_tree->nodes[node_num].parent = bvh_tree->free_list;
+  bvh_tree->free_list = node_num;
+  bvh_tree->node_count--;
 }
 
-static inline void bvh_node_init(struct BVHNode* bvh_node, struct BVHNode* parent, struct BoundingSphere* volume, struct RigidBody* body) {
-  bvh_node->children[0] = bvh_node->children[1] = NULL;
-  bvh_node->parent = parent;
-  bvh_node->volume = volume;
-  bvh_node->body = body;
+// Walks up from node_num recomputing volumes, stopping at the first one that did not change
+static void bvh_tree_refit(struct BVHTree* bvh_tree, uint32_t node_num) {
+  struct BVHNode* nodes = bvh_tree->nodes;
+  while (node_num != BVH_NULL) {
+    struct BVHNode* node = &nodes[node_num];
+    struct BoundingSphere volume;
+    bounding_sphere_init_two(&volume, &nodes[node->children[0]].volume, &nodes[node->children[1]].volume);
+    if (memcmp(&volume, &node->volume, sizeof(struct BoundingSphere)) == 0)
+      return;
+    node->volume = volume;
+    node_num = node->parent;
+  }
 }
 
-// Note: Check deletion on this function
-static inline void bvh_node_delete(struct BVHNode* bvh_node) {
-  if (bvh_node->parent) {
-    struct BVHNode* sibling;
-    if (bvh_node->parent->children[0] == bvh_node)
-      sibling = bvh_node->parent->children[1];
-    else
-      sibling = bvh_node->parent->children[0];
+// Goes down the child whose sphere grows least, then pairs the leaf with the node it reached
+// under a new parent, so existing leaves keep their index
+static void bvh_tree_insert_leaf(struct BVHTree* bvh_tree, uint32_t leaf) {
+  bvh_tree->leaf_count++;
+  if (bvh_tree->root == BVH_NULL) {
+    bvh_tree->root = leaf;
+    bvh_tree->nodes[leaf].parent = BVH_NULL;
+    return;
+  }
 
-    bvh_node->parent->volume = sibling->volume;
-    bvh_node->parent->body = sibling->body;
-    bvh_node->parent->children[0] = sibling->children[0];
-    bvh_node->parent->children[1] = sibling->children[1];
+  struct BVHNode* nodes = bvh_tree->nodes;
+  uint32_t sibling = bvh_tree->root;
+  while (!bvh_tree_is_leaf(&nodes[sibling])) {
+    struct BVHNode* node = &nodes[sibling];
+    if (bounding_sphere_get_growth(&nodes[node->children[0]].volume, &nodes[leaf].volume) < bounding_sphere_get_growth(&nodes[node->children[1]].volume, &nodes[leaf].volume))
+      sibling = node->children[0];
+    else
+      sibling = node->children[1];
+  }
 
-    sibling->parent = NULL;
-    sibling->body = NULL;
-    sibling->children[0] = NULL;
-    sibling->children[1] = NULL;
-    bvh_node_delete(sibling);
+  uint32_t parent = bvh_tree_allocate_node(bvh_tree);
+  nodes = bvh_tree->nodes;
+  uint32_t grandparent = nodes[sibling].parent;
+  nodes[parent].parent = grandparent;
+  nodes[parent].children[0] = sibling;
+  nodes[parent].children[1] = leaf;
+  bounding_sphere_init_two(&nodes[parent].volume, &nodes[sibling].volume, &nodes[leaf].volume);
+  nodes[sibling].parent = parent;
+  nodes[leaf].parent = parent;
+
+  if (grandparent == BVH_NULL) {
+    bvh_tree->root = parent;
+    return;
+  }
+  nodes[grandparent].children[nodes[grandparent].children[0] == sibling ? 0 : 1] = parent;
+  bvh_tree_refit(bvh_tree, grandparent);
+}
 
-    bvh_node_recalculate_bounding_volume(bvh_node->parent, true);
+// The sibling takes the parent's place and the parent goes back on the free list
+static void bvh_tree_remove_leaf(struct BVHTree* bvh_tree, uint32_t leaf) {
+  struct BVHNode* nodes = bvh_tree->nodes;
+  bvh_tree->leaf_count--;
+  if (leaf == bvh_tree->root) {
+    bvh_tree->root = BVH_NULL;
+    return;
   }
 
-  if (bvh_node->children[0]) {
-    bvh_node->children[0]->parent = NULL;
-    bvh_node_delete(bvh_node->children[0]);
+  uint32_t parent = nodes[leaf].parent;
+  uint32_t grandparent = nodes[parent].parent;
+  uint32_t sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+  nodes[sibling].parent = grandparent;
+  bvh_tree_free_node(bvh_tree, parent);
+
+  if (grandparent == BVH_NULL) {
+    bvh_tree->root = sibling;
+    return;
   }
-  if (bvh_node->children[1]) {
-    bvh_node->children[1]->parent = NULL;
-    bvh_node_delete(bvh_node->children[1]);
+  nodes[grandparent].children[nodes[grandparent].children[0] == parent ? 0 : 1] = sibling;
+  bvh_tree_refit(bvh_tree, grandparent);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+// NOTE: A tree of n bodies uses 2n - 1 nodes, reserving that up front avoids regrowing the pool
+void bvh_tree_init(struct BVHTree* bvh_tree, uint32_t node_capacity) {
+  memset(bvh_tree, 0, sizeof(struct BVHTree));
+  bvh_tree->root = BVH_NULL;
+  bvh_tree->free_list = BVH_NULL;
+  if (node_capacity > 0)
+    bvh_tree_grow(bvh_tree, node_capacity);
+}
+
+void bvh_tree_delete(struct BVHTree* bvh_tree) {
+  free(bvh_tree->nodes);
+  free(bvh_tree->tasks);
+  free(bvh_tree->next_tasks);
+  for (unsigned int thread_num = 0; thread_num < bvh_tree->thread_pairs_count; thread_num++) {
+    free(bvh_tree->thread_pairs[thread_num].pairs);
+    free(bvh_tree->thread_pairs[thread_num].stack);
   }
+  free(bvh_tree->thread_pairs);
+  free(bvh_tree->pairs);
+}
 
-  free(bvh_node);
+// Puts every node back on the free list while keeping the pool
+void bvh_tree_clear(struct BVHTree* bvh_tree) {
+  for (uint32_t node_num = 0; node_num < bvh_tree->node_capacity; node_num++)
+    bvh_tree->nodes[node_num].parent = node_num + 1 < bvh_tree->node_capacity ? node_num + 1 : BVH_NULL;
+  bvh_tree->free_list = bvh_tree->node_capacity > 0 ? 0 : BVH_NULL;
+  bvh_tree->root = BVH_NULL;
+  bvh_tree->node_count = 0;
+  bvh_tree->leaf_count = 0;
 }
 
-static inline bool bvh_node_is_leaf(struct BVHNode* bvh_node) {
-  return (bvh_node->body != NULL);
+uint32_t bvh_tree_insert(struct BVHTree* bvh_tree, struct RigidBody* body, struct BoundingSphere volume) {
+  uint32_t leaf = bvh_tree_allocate_node(bvh_tree);
+  bvh_tree->nodes[leaf].body = body;
+  bvh_tree->nodes[leaf].volume = volume;
+  bvh_tree_insert_leaf(bvh_tree, leaf);
+  return leaf;
 }
 
-static inline bool bvh_node_overlaps(struct BVHNode* bvh_node, struct BVHNode* other) {
-  return bounding_sphere_overlaps(bvh_node->volume, other->volume);
+void bvh_tree_remove(struct BVHTree* bvh_tree, uint32_t proxy) {
+  bvh_tree_remove_leaf(bvh_tree, proxy);
+  bvh_tree_free_node(bvh_tree, proxy);
 }
 
-static inline void bvh_node_insert(struct BVHNode* bvh_node, struct RigidBody* new_body, struct BoundingSphere* new_volume) {
-  if (bvh_node_is_leaf(bvh_node)) {
-    bvh_node->children[0] = calloc(1, sizeof(struct BVHNode));
-    bvh_node_init(bvh_node->children[0], bvh_node, new_volume, new_body);
+void bvh_tree_move(struct BVHTree* bvh_tree, uint32_t proxy, struct BoundingSphere volume) {
+  bvh_tree_remove_leaf(bvh_tree, proxy);
+  bvh_tree->nodes[proxy].volume = volume;
+  bvh_tree_insert_leaf(bvh_tree, proxy);
+}
 
-    bvh_node->children[1] = calloc(1, sizeof(struct BVHNode));
-    bvh_node_init(bvh_node->children[1], bvh_node, new_volume, new_body);
+// Splits a pair of nodes into the pairs under it, written to sub_pairs in traversal order. A
+// node paired with itself stands for every pair inside its subtree, which is its two children
+// against each other and each child with itself. Two different nodes are only opened while
+// their spheres overlap, the larger one first. Returns BVH_TREE_LEAF_PAIR for two overlapping
+// leaves.
+static unsigned int bvh_tree_open_pair(struct BVHNode* nodes, uint32_t one, uint32_t two, uint32_t sub_pairs[6]) {
+  struct BVHNode* node_one = &nodes[one];
+  struct BVHNode* node_two = &nodes[two];
+
+  if (one == two) {
+    if (bvh_tree_is_leaf(node_one))
+      return 0;
+    uint32_t children[6] = {node_one->children[0], node_one->children[1], node_one->children[0], node_one->children[0], node_one->children[1], node_one->children[1]};
+    memcpy(sub_pairs, children, sizeof(children));
+    return 3;
+  }
+
+  if (!bounding_sphere_overlaps(&node_one->volume, &node_two->volume))
+    return 0;
 
-    bvh_node->body = NULL;
+  if (bvh_tree_is_leaf(node_one) && bvh_tree_is_leaf(node_two))
+    return BVH_TREE_LEAF_PAIR;
 
-    bvh_node_recalculate_bounding_volume(bvh_node->parent, true);
+  if (bvh_tree_is_leaf(node_two) || (!bvh_tree_is_leaf(node_one) && node_one->volume.radius >= node_two->volume.radius)) {
+    uint32_t children[4] = {node_one->children[0], two, node_one->children[1], two};
+    memcpy(sub_pairs, children, sizeof(children));
+  } else {
+    uint32_t children[4] = {one, node_two->children[0], one, node_two->children[1]};
+    memcpy(sub_pairs, children, sizeof(children));
   }
+  return 2;
+}
 
-  else {
-    if (bounding_sphere_get_growth(bvh_node->children[0]->volume, new_volume) < bounding_sphere_get_growth(bvh_node->children[1]->volume, new_volume))
-      bvh_node_insert(bvh_node->children[0], new_body, new_volume);
-    else
-      bvh_node_insert(bvh_node->children[1], new_body, new_volume);
+static inline void bvh_tree_push_pair(struct BVHThreadPairs* thread_pairs, struct RigidBody* one, struct RigidBody* two) {
+  if (thread_pairs->count == thread_pairs->capacity) {
+    thread_pairs->capacity = thread_pairs->capacity ? thread_pairs->capacity * 2 : 256;
+    thread_pairs->pairs = realloc(thread_pairs->pairs, sizeof(struct PotentialContact) * thread_pairs->capacity);
   }
+  thread_pairs->pairs[thread_pairs->count].body[0] = one;
+  thread_pairs->pairs[thread_pairs->count].body[1] = two;
+  thread_pairs->count++;
 }
 
-static inline void bvh_node_recalculate_bounding_volume(struct BVHNode* bvh_node, bool recurse) {
-  if (bvh_node_is_leaf(bvh_node))
-    return;
+// Depth first from one task's node pair on the thread's own stack
+static void bvh_tree_collect_pairs(struct BVHNode* nodes, struct BVHThreadPairs* thread_pairs, uint32_t one, uint32_t two) {
+  uint32_t stack_size = 0;
+  uint32_t sub_pairs[6];
+  if (thread_pairs->stack_capacity < 64) {
+    thread_pairs->stack_capacity = 64;
+    thread_pairs->stack = realloc(thread_pairs->stack, sizeof(uint32_t) * thread_pairs->stack_capacity);
+  }
+  thread_pairs->stack[stack_size++] = one;
+  thread_pairs->stack[stack_size++] = two;
+
+  while (stack_size > 0) {
+    two = thread_pairs->stack[--stack_size];
+    one = thread_pairs->stack[--stack_size];
 
-  bounding_sphere_init_two(bvh_node->volume, bvh_node->children[0]->volume, bvh_node->children[1]->volume);
+    unsigned int count = bvh_tree_open_pair(nodes, one, two, sub_pairs);
+    if (count == BVH_TREE_LEAF_PAIR) {
+      bvh_tree_push_pair(thread_pairs, nodes[one].body, nodes[two].body);
+      continue;
+    }
 
-  if (bvh_node->parent)
-    bvh_node_recalculate_bounding_volume(bvh_node->parent, true);
+    if (stack_size + count * 2 > thread_pairs->stack_capacity) {
+      thread_pairs->stack_capacity *= 2;
+      thread_pairs->stack = realloc(thread_pairs->stack, sizeof(uint32_t) * thread_pairs->stack_capacity);
+    }
+    // NOTE: Pushed last first so the first sub pair is opened next
+    for (unsigned int sub_pair = count; sub_pair-- > 0;) {
+      thread_pairs->stack[stack_size++] = sub_pairs[sub_pair * 2];
+      thread_pairs->stack[stack_size++] = sub_pairs[sub_pair * 2 + 1];
+    }
+  }
 }
 
-static inline unsigned int bvh_node_get_potential_contacts(struct BVHNode* bvh_node, struct PotentialContact* contacts, unsigned int limit) {
-  if (bvh_node_is_leaf(bvh_node) || limit == 0)
-    return 0;
+static void bvh_tree_collect_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct BVHTree* bvh_tree = data;
+  struct BVHThreadPairs* thread_pairs = &bvh_tree->thread_pairs[thread_index];
 
-  return bvh_node_get_potential_contacts_with(bvh_node->children[0], bvh_node->children[1], contacts, limit);
+  for (unsigned int task_num = begin; task_num < end; task_num++) {
+    struct BVHTask* task = &bvh_tree->tasks[task_num];
+    task->thread_index = thread_index;
+    task->offset = thread_pairs->count;
+    bvh_tree_collect_pairs(bvh_tree->nodes, thread_pairs, task->node[0], task->node[1]);
+    task->count = thread_pairs->count - task->offset;
+  }
 }
 
-static inline unsigned int bvh_node_get_potential_contacts_with(struct BVHNode* bvh_node, struct BVHNode* other, struct PotentialContact* contacts, unsigned int limit) {
-  if (!bvh_node_overlaps(bvh_node, other) || limit == 0)
-    return 0;
+static void bvh_tree_reserve_tasks(struct BVHTree* bvh_tree, unsigned int task_count) {
+  if (bvh_tree->task_capacity >= task_count)
+    return;
+  bvh_tree->task_capacity = task_count * 2;
+  bvh_tree->tasks = realloc(bvh_tree->tasks, sizeof(struct BVHTask) * bvh_tree->task_capacity);
+  bvh_tree->next_tasks = realloc(bvh_tree->next_tasks, sizeof(struct BVHTask) * bvh_tree->task_capacity);
+}
+
+// Opens node pairs a level at a time from the root until there are enough to share out.
+// Leaf pairs stay tasks of their own and pairs that do not overlap are dropped on the way.
+static void bvh_tree_split_tasks(struct BVHTree* bvh_tree) {
+  bvh_tree_reserve_tasks(bvh_tree, 1);
+  bvh_tree->tasks[0] = (struct BVHTask){.node = {bvh_tree->root, bvh_tree->root}};
+  bvh_tree->task_count = 1;
+
+  bool opened = true;
+  while (opened && bvh_tree->task_count < BVH_TREE_TASK_TARGET) {
+    bvh_tree_reserve_tasks(bvh_tree, bvh_tree->task_count * 3);
+    unsigned int next_count = 0;
+    opened = false;
+
+    for (unsigned int task_num = 0; task_num < bvh_tree->task_count; task_num++) {
+      struct BVHTask* task = &bvh_tree->tasks[task_num];
+      uint32_t sub_pairs[6];
+      unsigned int count = bvh_tree_open_pair(bvh_tree->nodes, task->node[0], task->node[1], sub_pairs);
+      if (count == BVH_TREE_LEAF_PAIR) {
+        bvh_tree->next_tasks[next_count++] = *task;
+        continue;
+      }
+
+      opened = true;
+      for (unsigned int sub_pair = 0; sub_pair < count; sub_pair++)
+        bvh_tree->next_tasks[next_count++] = (struct BVHTask){.node = {sub_pairs[sub_pair * 2], sub_pairs[sub_pair * 2 + 1]}};
+    }
 
-  if (bvh_node_is_leaf(bvh_node) && bvh_node_is_leaf(other)) {
-    contacts->body[0] = bvh_node->body;
-    contacts->body[1] = other->body;
-    return 1;
+    struct BVHTask* swap = bvh_tree->tasks;
+    bvh_tree->tasks = bvh_tree->next_tasks;
+    bvh_tree->next_tasks = swap;
+    bvh_tree->task_count = next_count;
   }
+}
 
-  if (bvh_node_is_leaf(other) || (!bvh_node_is_leaf(bvh_node) && bounding_sphere_get_size(bvh_node->volume) >= bounding_sphere_get_size(other->volume))) {
-    unsigned int count = bvh_node_get_potential_contacts_with(bvh_node->children[0], other, contacts, limit);
+// Finds every pair of overlapping leaves into pairs, with no limit. The self test is split
+// into subtree tasks that run through the scheduler, each writing to the buffer of the thread
+// running it, and the buffers are then joined in task order. The tasks only depend on the
+// tree, so the pairs come out in the same order on any scheduler.
+unsigned int bvh_tree_find_pairs(struct BVHTree* bvh_tree, struct JobScheduler* scheduler) {
+  bvh_tree->pair_count = 0;
+  if (bvh_tree->root == BVH_NULL)
+    return 0;
 
-    if (limit > count)
-      return count + bvh_node_get_potential_contacts_with(bvh_node->children[1], other, contacts + count, limit - count);
-    else
-      return count;
-  } else {
-    unsigned int count = bvh_node_get_potential_contacts_with(bvh_node, other->children[0], contacts, limit);
+  bvh_tree_split_tasks(bvh_tree);
 
-    if (limit > count)
-      return count + bvh_node_get_potential_contacts_with(bvh_node, other->children[1], contacts + count, limit - count);
-    else
-      return count;
+  unsigned int thread_count = job_scheduler_thread_count(scheduler);
+  if (bvh_tree->thread_pairs_count < thread_count) {
+    bvh_tree->thread_pairs = realloc(bvh_tree->thread_pairs, sizeof(struct BVHThreadPairs) * thread_count);
+    memset(bvh_tree->thread_pairs + bvh_tree->thread_pairs_count, 0, sizeof(struct BVHThreadPairs) * (thread_count - bvh_tree->thread_pairs_count));
+    bvh_tree->thread_pairs_count = thread_count;
+  }
+  for (unsigned int thread_num = 0; thread_num < bvh_tree->thread_pairs_count; thread_num++)
+    bvh_tree->thread_pairs[thread_num].count = 0;
+
+  job_scheduler_parallel_for(scheduler, bvh_tree->task_count, 1, bvh_tree_collect_range, bvh_tree);
+
+  unsigned int pair_count = 0;
+  for (unsigned int task_num = 0; task_num < bvh_tree->task_count; task_num++)
+    pair_count += bvh_tree->tasks[task_num].count;
+  if (bvh_tree->pair_capacity < pair_count) {
+    free(bvh_tree->pairs);
+    bvh_tree->pair_capacity = pair_count + pair_count / 2;
+    bvh_tree->pairs = malloc(sizeof(struct PotentialContact) * bvh_tree->pair_capacity);
+  }
+
+  for (unsigned int task_num = 0; task_num < bvh_tree->task_count; task_num++) {
+    struct BVHTask* task = &bvh_tree->tasks[task_num];
+    if (task->count == 0)
+      continue;
+    memcpy(bvh_tree->pairs + bvh_tree->pair_count, bvh_tree->thread_pairs[task->thread_index].pairs + task->offset, sizeof(struct PotentialContact) * task->count);
+    bvh_tree->pair_count += task->count;
   }
+  return bvh_tree->pair_count;
+}
+
+// Runs bvh_tree_find_pairs inline and writes at most limit of the pairs, needed is set to how
+// many overlap
+unsigned int bvh_tree_get_potential_contacts(struct BVHTree* bvh_tree, struct PotentialContact* contacts, unsigned int limit, unsigned int* needed) {
+  *needed = bvh_tree_find_pairs(bvh_tree, NULL);
+  unsigned int used = *needed < limit ? *needed : limit;
+  if (used > 0)
+    memcpy(contacts, bvh_tree->pairs, sizeof(struct PotentialContact) * used);
+  return used;
 }
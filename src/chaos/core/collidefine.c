@@ -1,17 +1,88 @@
 #include "chaos/core/collidefine.h"
 
+#include "chaos/core/simd.h"
+
 float transform_to_axis(struct CollisionBox* box, vec3 axis) {
-  return box->half_size.data[0] * fabsf(vec3_magnitude(vec3_component_product(axis, collision_primitive_get_axis(&box->collision_primitive, 0)))) + box->half_size.data[1] * fabsf(vec3_magnitude(vec3_component_product(axis, collision_primitive_get_axis(&box->collision_primitive, 1)))) + box->half_size.data[2] * fabsf(vec3_magnitude(vec3_component_product(axis, collision_primitive_get_axis(&box->collision_primitive, 2))));
+  return box->half_size.data[0] * fabsf(vec3_dot(axis, collision_primitive_get_axis(&box->collision_primitive, 0))) + box->half_size.data[1] * fabsf(vec3_dot(axis, collision_primitive_get_axis(&box->collision_primitive, 1))) + box->half_size.data[2] * fabsf(vec3_dot(axis, collision_primitive_get_axis(&box->collision_primitive, 2)));
 }
 
 bool overlap_on_axis(struct CollisionBox* one, struct CollisionBox* two, vec3 axis, vec3 to_centre) {
   float one_project = transform_to_axis(one, axis);
   float two_project = transform_to_axis(two, axis);
-  float distance = fabsf(vec3_magnitude(vec3_component_product(to_centre, axis)));
+  float distance = fabsf(vec3_dot(to_centre, axis));
 
   return (distance < one_project + two_project);
 }
 
+// Penetration along every separating axis of the two boxes, lanes of skipped axes get FLT_MAX.
+// The axes are laid out as rows of lanes, so each register projects both boxes and the centre
+// line onto SIMD_WIDTH axes at once. Returns the smallest penetration.
+static float box_and_box_penetrations(struct CollisionBox* one, struct CollisionBox* two, vec3 to_centre, float penetration[COLLISION_BOX_AXIS_LANES]) {
+  vec3 one_axis[3], two_axis[3];
+  for (unsigned int i = 0; i < 3; i++) {
+    one_axis[i] = collision_primitive_get_axis(&one->collision_primitive, i);
+    two_axis[i] = collision_primitive_get_axis(&two->collision_primitive, i);
+  }
+
+  float axis[3][COLLISION_BOX_AXIS_LANES] = {{0.0f}};
+  for (unsigned int i = 0; i < 3; i++) {
+    for (unsigned int c = 0; c < 3; c++) {
+      axis[c][i] = one_axis[i].data[c];
+      axis[c][3 + i] = two_axis[i].data[c];
+    }
+    for (unsigned int j = 0; j < 3; j++) {
+      vec3 edge_axis = vec3_cross_product(one_axis[i], two_axis[j]);
+      for (unsigned int c = 0; c < 3; c++)
+        axis[c][6 + i * 3 + j] = edge_axis.data[c];
+    }
+  }
+
+  simd_float one_rows[3][3], two_rows[3][3], one_half[3], two_half[3], centre[3];
+  for (unsigned int i = 0; i < 3; i++) {
+    for (unsigned int c = 0; c < 3; c++) {
+      one_rows[i][c] = simd_set(one_axis[i].data[c]);
+      two_rows[i][c] = simd_set(two_axis[i].data[c]);
+    }
+    one_half[i] = simd_set(one->half_size.data[i]);
+    two_half[i] = simd_set(two->half_size.data[i]);
+    centre[i] = simd_set(to_centre.data[i]);
+  }
+
+  float square_length[COLLISION_BOX_AXIS_LANES];
+  simd_float zero = simd_zero();
+  for (unsigned int lane = 0; lane < COLLISION_BOX_AXIS_LANES; lane += SIMD_WIDTH) {
+    simd_float x = simd_load(&axis[0][lane]);
+    simd_float y = simd_load(&axis[1][lane]);
+    simd_float z = simd_load(&axis[2][lane]);
+    simd_float length = simd_add(simd_add(simd_mul(x, x), simd_mul(y, y)), simd_mul(z, z));
+    simd_store(&square_length[lane], length);
+
+    simd_float inverse = simd_div(simd_set(1.0f), simd_sqrt(simd_max(length, simd_set(COLLISION_BOX_PARALLEL))));
+    x = simd_mul(x, inverse);
+    y = simd_mul(y, inverse);
+    z = simd_mul(z, inverse);
+
+    simd_float project = simd_zero();
+    for (unsigned int i = 0; i < 3; i++) {
+      simd_float one_dot = simd_add(simd_add(simd_mul(x, one_rows[i][0]), simd_mul(y, one_rows[i][1])), simd_mul(z, one_rows[i][2]));
+      simd_float two_dot = simd_add(simd_add(simd_mul(x, two_rows[i][0]), simd_mul(y, two_rows[i][1])), simd_mul(z, two_rows[i][2]));
+      project = simd_add(project, simd_mul(one_half[i], simd_max(one_dot, simd_sub(zero, one_dot))));
+      project = simd_add(project, simd_mul(two_half[i], simd_max(two_dot, simd_sub(zero, two_dot))));
+    }
+    simd_float distance = simd_add(simd_add(simd_mul(x, centre[0]), simd_mul(y, centre[1])), simd_mul(z, centre[2]));
+    simd_store(&penetration[lane], simd_sub(project, simd_max(distance, simd_sub(zero, distance))));
+  }
+
+  float smallest = FLT_MAX;
+  for (unsigned int lane = 0; lane < COLLISION_BOX_AXIS_LANES; lane++) {
+    if (lane >= COLLISION_BOX_AXES || square_length[lane] < COLLISION_BOX_PARALLEL)
+      penetration[lane] = FLT_MAX;
+    if (penetration[lane] < smallest)
+      smallest = penetration[lane];
+  }
+  return smallest;
+}
+
 void collision_primitive_calculate_internals(struct CollisionPrimitive* collision_primitive) {
   collision_primitive->transform = mat4_mul(collision_primitive->body->transform_matrix, collision_primitive->offset);
 }
@@ -21,7 +92,7 @@ vec3 collision_primitive_get_axis(struct CollisionPrimitive* collision_primitive
 }
 
 bool intersection_test_sphere_and_half_space(struct CollisionSphere* sphere, struct CollisionPlane* plane) {
-  float ball_distance = vec3_magnitude(vec3_component_product(plane->direction, collision_primitive_get_axis(&sphere->collision_primitive, 3))) - sphere->radius;
+  float ball_distance = vec3_dot(plane->direction, collision_primitive_get_axis(&sphere->collision_primitive, 3)) - sphere->radius;
 
   return ball_distance <= plane->offset;
 }
@@ -32,11 +103,18 @@ bool intersection_test_sphere_and_sphere(struct CollisionSphere* one, struct Col
 
 bool intersection_test_box_and_half_space(struct CollisionBox* box, struct CollisionPlane* plane) {
   float projected_radius = transform_to_axis(box, plane->direction);
-  float box_distance = vec3_magnitude(vec3_component_product(plane->direction, collision_primitive_get_axis(&box->collision_primitive, 3))) - projected_radius;
+  float box_distance = vec3_dot(plane->direction, collision_primitive_get_axis(&box->collision_primitive, 3)) - projected_radius;
 
   return box_distance <= plane->offset;
 }
 
+bool intersection_test_box_and_box(struct CollisionBox* one, struct CollisionBox* two) {
+  vec3 to_centre = vec3_sub(collision_primitive_get_axis(&two->collision_primitive, 3), collision_primitive_get_axis(&one->collision_primitive, 3));
+  float penetration[COLLISION_BOX_AXIS_LANES];
+
+  return box_and_box_penetrations(one, two, to_centre, penetration) > 0.0f;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
 bool collision_data_has_more_contacts(struct CollisionData* collision_data) {
@@ -46,6 +124,7 @@ bool collision_data_has_more_contacts(struct CollisionData* collision_data) {
 void collision_data_reset(struct CollisionData* collision_data, unsigned int max_contacts) {
   collision_data->contacts_left = max_contacts;
   collision_data->contact_count = 0;
+  collision_data->contacts_needed = 0;
   collision_data->contacts = collision_data->contact_array;
 }
 
@@ -55,13 +134,23 @@ void collision_data_add_contacts(struct CollisionData* collision_data, unsigned
   collision_data->contacts += count;
 }
 
+// Counts contacts a detector found, true when there is room to write them
+static inline bool collision_data_claim(struct CollisionData* collision_data, unsigned int count) {
+  collision_data->contacts_needed += count;
+  return collision_data->contacts_left >= (int)count;
+}
+
+static inline bool collision_data_skips(struct CollisionData* collision_data, struct RigidBody* one, struct RigidBody* two) {
+  return collision_data->skip_sleeping && contact_pair_is_sleeping(one, two);
+}
+
 unsigned int collision_detector_sphere_and_true_plane(struct CollisionSphere* sphere, struct CollisionPlane* plane, struct CollisionData* data) {
-  if (data->contacts_left <= 0)
+  if (collision_data_skips(data, sphere->collision_primitive.body, NULL))
     return 0;
 
   vec3 position = collision_primitive_get_axis(&sphere->collision_primitive, 3);
 
-  float centre_distance = vec3_magnitude(vec3_component_product(plane->direction, position)) - plane->offset;
+  float centre_distance = vec3_dot(plane->direction, position) - plane->offset;
   if (centre_distance * centre_distance > sphere->radius * sphere->radius)
     return 0;
 
@@ -74,6 +163,9 @@ unsigned int collision_detector_sphere_and_true_plane(struct CollisionSphere* sp
   }
   penetration += sphere->radius;
 
+  if (!collision_data_claim(data, 1))
+    return 0;
+
   struct Contact* contact = data->contacts;
   contact->contact_normal = normal;
   contact->penetration = penetration;
@@ -86,15 +178,18 @@ unsigned int collision_detector_sphere_and_true_plane(struct CollisionSphere* sp
 }
 
 unsigned int collision_detector_sphere_and_half_space(struct CollisionSphere* sphere, struct CollisionPlane* plane, struct CollisionData* data) {
-  if (data->contacts_left <= 0)
+  if (collision_data_skips(data, sphere->collision_primitive.body, NULL))
     return 0;
 
   vec3 position = collision_primitive_get_axis(&sphere->collision_primitive, 3);
 
-  float ball_distance = vec3_magnitude(vec3_component_product(plane->direction, position)) - sphere->radius - plane->offset;
+  float ball_distance = vec3_dot(plane->direction, position) - sphere->radius - plane->offset;
   if (ball_distance >= 0)
     return 0;
 
+  if (!collision_data_claim(data, 1))
+    return 0;
+
   struct Contact* contact = data->contacts;
   contact->contact_normal = plane->direction;
   contact->penetration = -ball_distance;
@@ -107,7 +202,7 @@ unsigned int collision_detector_sphere_and_half_space(struct CollisionSphere* sp
 }
 
 unsigned int collision_detector_sphere_and_sphere(struct CollisionSphere* one, struct CollisionSphere* two, struct CollisionData* data) {
-  if (data->contacts_left <= 0)
+  if (collision_data_skips(data, one->collision_primitive.body, two->collision_primitive.body))
     return 0;
 
   vec3 position_one = collision_primitive_get_axis(&one->collision_primitive, 3);
@@ -120,6 +215,9 @@ unsigned int collision_detector_sphere_and_sphere(struct CollisionSphere* one, s
 
   vec3 normal = vec3_scale(midline, 1.0f / size);
 
+  if (!collision_data_claim(data, 1))
+    return 0;
+
   struct Contact* contact = data->contacts;
   contact->contact_normal = normal;
   contact->contact_point = vec3_add(position_one, vec3_scale(midline, 0.5f));
@@ -134,7 +232,7 @@ unsigned int collision_detector_sphere_and_sphere(struct CollisionSphere* one, s
 float penetration_on_axis(struct CollisionBox* one, struct CollisionBox* two, vec3 axis, vec3 to_centre) {
   float one_project = transform_to_axis(one, axis);
   float two_project = transform_to_axis(two, axis);
-  float distance = fabsf(vec3_magnitude(vec3_component_product(to_centre, axis)));
+  float distance = fabsf(vec3_dot(to_centre, axis));
 
   return one_project + two_project - distance;
 }
@@ -161,22 +259,24 @@ void fill_point_face_box_box(struct CollisionBox* one, struct CollisionBox* two,
 
   vec3 normal = collision_primitive_get_axis(&one->collision_primitive, best);
 
-  if (vec3_magnitude(vec3_component_product(collision_primitive_get_axis(&one->collision_primitive, best), to_centre)) > 0)
+  if (vec3_dot(collision_primitive_get_axis(&one->collision_primitive, best), to_centre) > 0)
     normal = vec3_scale(normal, -1.0f);
 
   vec3 vertex = two->half_size;
 
-  if (vec3_magnitude(vec3_component_product(collision_primitive_get_axis(&two->collision_primitive, 0), normal)) < 0)
+  if (vec3_dot(collision_primitive_get_axis(&two->collision_primitive, 0), normal) < 0)
     vertex.data[0] = -vertex.data[0];
-  if (vec3_magnitude(vec3_component_product(collision_primitive_get_axis(&two->collision_primitive, 1), normal)) < 0)
+  if (vec3_dot(collision_primitive_get_axis(&two->collision_primitive, 1), normal) < 0)
     vertex.data[1] = -vertex.data[1];
-  if (vec3_magnitude(vec3_component_product(collision_primitive_get_axis(&two->collision_primitive, 2), normal)) < 0)
+  if (vec3_dot(collision_primitive_get_axis(&two->collision_primitive, 2), normal) < 0)
     vertex.data[2] = -vertex.data[2];
 
   contact->contact_normal = normal;
   contact->penetration = pen;
   contact->contact_point = mat4_transform(two->collision_primitive.transform, vertex);
   contact_set_body_data(contact, one->collision_primitive.body, two->collision_primitive.body, data->friction, data->restitution);
+  // Face of one and the vertex of two, by the signs picked above
+  contact->feature = best << 3 | (vertex.data[0] < 0) | (vertex.data[1] < 0) << 1 | (vertex.data[2] < 0) << 2;
 }
 
 vec3 contact_point(vec3 p_one, vec3 d_one, float one_size, vec3 p_two, vec3 d_two, float two_size, bool use_one) {
@@ -186,18 +286,18 @@ vec3 contact_point(vec3 p_one, vec3 d_one, float one_size, vec3 p_two, vec3 d_tw
 
   sm_one = vec3_square_magnitude(d_one);
   sm_two = vec3_square_magnitude(d_two);
-  dp_one_two = vec3_magnitude(vec3_component_product(d_two, d_one));
+  dp_one_two = vec3_dot(d_two, d_one);
 
   to_st = vec3_sub(p_one, p_two);
-  dp_sta_one = vec3_magnitude(vec3_component_product(d_one, to_st));
-  dp_sta_two = vec3_magnitude(vec3_component_product(d_two, to_st));
+  dp_sta_one = vec3_dot(d_one, to_st);
+  dp_sta_two = vec3_dot(d_two, to_st);
 
   denom = sm_one * sm_two - dp_one_two * dp_one_two;
 
   if (fabsf(denom) < 0.0001f)
     return use_one ? p_one : p_two;
 
-  mua = (dp_one_two * dp_sta_one - sm_two * dp_sta_one) / denom;
+  mua = (dp_one_two * dp_sta_two - sm_two * dp_sta_one) / denom;
   mub = (sm_one * dp_sta_two - dp_one_two * dp_sta_one) / denom;
 
   if (mua > one_size || mua < -one_size || mub > two_size || mub < -two_size) {
@@ -210,7 +310,90 @@ vec3 contact_point(vec3 p_one, vec3 d_one, float one_size, vec3 p_two, vec3 d_tw
   }
 }
 
+// The normal points from two towards one and body one comes first, whichever box the face
+// belongs to. Features are one's face and two's vertex below 24, two's face and one's vertex
+// below 48, and the axis case with the signs of both edges from there on.
+unsigned int collision_detector_box_and_box(struct CollisionBox* one, struct CollisionBox* two, struct CollisionData* data) {
+  if (collision_data_skips(data, one->collision_primitive.body, two->collision_primitive.body))
+    return 0;
+
+  vec3 to_centre = vec3_sub(collision_primitive_get_axis(&two->collision_primitive, 3), collision_primitive_get_axis(&one->collision_primitive, 3));
+
+  float penetration[COLLISION_BOX_AXIS_LANES];
+  if (box_and_box_penetrations(one, two, to_centre, penetration) < 0.0f)
+    return 0;
+
+  unsigned int best = 0;
+  for (unsigned int axis = 1; axis < 6; axis++)
+    if (penetration[axis] < penetration[best])
+      best = axis;
+  unsigned int best_single_axis = best;
+
+  // NOTE: The bias applies once, between the best face and the best edge axis
+  unsigned int best_edge = 6;
+  for (unsigned int axis = 7; axis < COLLISION_BOX_AXES; axis++)
+    if (penetration[axis] < penetration[best_edge])
+      best_edge = axis;
+  if (penetration[best_edge] < penetration[best] * COLLISION_BOX_EDGE_BIAS)
+    best = best_edge;
+
+  if (!collision_data_claim(data, 1))
+    return 0;
+
+  if (best < 3) {
+    fill_point_face_box_box(one, two, to_centre, data, best, penetration[best]);
+  } else if (best < 6) {
+    fill_point_face_box_box(two, one, vec3_invert(to_centre), data, best - 3, penetration[best]);
+    contact_swap_bodies(data->contacts);
+    data->contacts->feature += 3 << 3;
+  } else {
+    unsigned int one_axis_index = (best - 6) / 3;
+    unsigned int two_axis_index = (best - 6) % 3;
+    vec3 one_axis = collision_primitive_get_axis(&one->collision_primitive, one_axis_index);
+    vec3 two_axis = collision_primitive_get_axis(&two->collision_primitive, two_axis_index);
+    vec3 axis = vec3_normalise(vec3_cross_product(one_axis, two_axis));
+
+    if (vec3_dot(axis, to_centre) > 0)
+      axis = vec3_invert(axis);
+
+    // NOTE: The edges are the ones of each box closest to the other, picked by the signs
+    vec3 pt_on_one_edge = one->half_size;
+    vec3 pt_on_two_edge = two->half_size;
+    unsigned int signs = 0;
+    for (unsigned int i = 0; i < 3; i++) {
+      if (i == one_axis_index)
+        pt_on_one_edge.data[i] = 0;
+      else if (vec3_dot(collision_primitive_get_axis(&one->collision_primitive, i), axis) > 0)
+        pt_on_one_edge.data[i] = -pt_on_one_edge.data[i];
+
+      if (i == two_axis_index)
+        pt_on_two_edge.data[i] = 0;
+      else if (vec3_dot(collision_primitive_get_axis(&two->collision_primitive, i), axis) < 0)
+        pt_on_two_edge.data[i] = -pt_on_two_edge.data[i];
+
+      signs |= (pt_on_one_edge.data[i] < 0) << i | (pt_on_two_edge.data[i] < 0) << (i + 3);
+    }
+
+    pt_on_one_edge = mat4_transform(one->collision_primitive.transform, pt_on_one_edge);
+    pt_on_two_edge = mat4_transform(two->collision_primitive.transform, pt_on_two_edge);
+
+    struct Contact* contact = data->contacts;
+    contact->contact_normal = axis;
+    contact->penetration = penetration[best];
+    contact->contact_point = contact_point(pt_on_one_edge, one_axis, one->half_size.data[one_axis_index], pt_on_two_edge, two_axis, two->half_size.data[two_axis_index], best_single_axis > 2);
+    contact_set_body_data(contact, one->collision_primitive.body, two->collision_primitive.body, data->friction, data->restitution);
+    contact->feature = best << 6 | signs;
+  }
+
+  collision_data_add_contacts(data, 1);
+
+  return 1;
+}
+
 unsigned int collision_detector_box_and_point(struct CollisionBox* box, vec3 point, struct CollisionData* data) {
+  if (collision_data_skips(data, box->collision_primitive.body, NULL))
+    return 0;
+
   vec3 rel_pt = mat4_transform_inverse(box->collision_primitive.transform, point);
 
   vec3 normal;
@@ -237,6 +420,9 @@ unsigned int collision_detector_box_and_point(struct CollisionBox* box, vec3 poi
     normal = vec3_scale(collision_primitive_get_axis(&box->collision_primitive, 2), rel_pt.data[2] < 0 ? -1 : 1);
   }
 
+  if (!collision_data_claim(data, 1))
+    return 0;
+
   struct Contact* contact = data->contacts;
   contact->contact_normal = normal;
   contact->contact_point = point;
@@ -250,6 +436,9 @@ unsigned int collision_detector_box_and_point(struct CollisionBox* box, vec3 poi
 }
 
 unsigned int collision_detector_box_and_sphere(struct CollisionBox* box, struct CollisionSphere* sphere, struct CollisionData* data) {
+  if (collision_data_skips(data, box->collision_primitive.body, sphere->collision_primitive.body))
+    return 0;
+
   vec3 centre = collision_primitive_get_axis(&sphere->collision_primitive, 3);
 
   vec3 rel_centre = mat4_transform_inverse(box->collision_primitive.transform, centre);
@@ -287,6 +476,9 @@ unsigned int collision_detector_box_and_sphere(struct CollisionBox* box, struct
 
   vec3 closest_pt_world = mat4_transform(box->collision_primitive.transform, closest_pt);
 
+  if (!collision_data_claim(data, 1))
+    return 0;
+
   struct Contact* contact = data->contacts;
   contact->contact_normal = vec3_sub(closest_pt_world, centre);
   contact->contact_normal = vec3_normalise(contact->contact_normal);
@@ -300,7 +492,7 @@ unsigned int collision_detector_box_and_sphere(struct CollisionBox* box, struct
 }
 
 unsigned int collision_detector_box_and_half_space(struct CollisionBox* box, struct CollisionPlane* plane, struct CollisionData* data) {
-  if (data->contacts_left <= 0)
+  if (collision_data_skips(data, box->collision_primitive.body, NULL))
     return 0;
 
   if (!intersection_test_box_and_half_space(box, plane))
@@ -308,7 +500,6 @@ unsigned int collision_detector_box_and_half_space(struct CollisionBox* box, str
 
   static float mults[8][3] = {{1, 1, 1}, {-1, 1, 1}, {1, -1, 1}, {-1, -1, 1}, {1, 1, -1}, {-1, 1, -1}, {1, -1, -1}, {-1, -1, -1}};
 
-  struct Contact* contact = data->contacts;
   unsigned int contacts_used = 0;
   for (unsigned int i = 0; i < 8; i++) {
     vec3 vertex_pos = (vec3){.data[0] = mults[i][0], .data[1] = mults[i][1], .data[2] = mults[i][2]};
@@ -317,7 +508,8 @@ unsigned int collision_detector_box_and_half_space(struct CollisionBox* box, str
 
     float vertex_distance = vec3_dot(vertex_pos, plane->direction);
 
-    if (vertex_distance <= plane->offset) {
+    if (vertex_distance <= plane->offset && collision_data_claim(data, 1)) {
+      struct Contact* contact = data->contacts;
       contact->contact_point = plane->direction;
       contact->contact_point = vec3_scale(contact->contact_point, vertex_distance - plane->offset);
       contact->contact_point = vec3_add(contact->contact_point, vertex_pos);
@@ -325,15 +517,12 @@ unsigned int collision_detector_box_and_half_space(struct CollisionBox* box, str
       contact->penetration = plane->offset - vertex_distance;
 
       contact_set_body_data(contact, box->collision_primitive.body, NULL, data->friction, data->restitution);
+      contact->feature = i;
 
-      contact++;
+      collision_data_add_contacts(data, 1);
       contacts_used++;
-      if (contacts_used == (unsigned int)data->contacts_left)
-        return contacts_used;
     }
   }
 
-  collision_data_add_contacts(data, contacts_used);
-
   return contacts_used;
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "chaos/core/contactarena.h"
+
+static void contact_arena_add_chunk(struct ContactArena* contact_arena, unsigned int capacity) {
+  if (contact_arena->chunk_count == contact_arena->chunk_capacity) {
+    contact_arena->chunk_capacity = contact_arena->chunk_capacity ? contact_arena->chunk_capacity * 2 : 4;
+    contact_arena->chunks = realloc(contact_arena->chunks, sizeof(struct ContactChunk) * contact_arena->chunk_capacity);
+  }
+
+  struct ContactChunk* chunk = &contact_arena->chunks[contact_arena->chunk_count++];
+  chunk->contacts = malloc(sizeof(struct Contact) * capacity);
+  chunk->capacity = capacity;
+  chunk->size = 0;
+  contact_arena->capacity += capacity;
+}
+
+static void contact_arena_free_chunks(struct ContactArena* contact_arena) {
+  for (unsigned int chunk_num = 0; chunk_num < contact_arena->chunk_count; chunk_num++)
+    free(contact_arena->chunks[chunk_num].contacts);
+  contact_arena->chunk_count = 0;
+  contact_arena->capacity = 0;
+}
+
+void contact_arena_init(struct ContactArena* contact_arena, unsigned int capacity) {
+  contact_arena->chunk_count = 0;
+  contact_arena->chunk_capacity = 0;
+  contact_arena->chunks = NULL;
+  contact_arena->size = 0;
+  contact_arena->capacity = 0;
+  contact_arena->high_water = 0;
+  if (capacity > 0)
+    contact_arena_add_chunk(contact_arena, capacity);
+}
+
+void contact_arena_delete(struct ContactArena* contact_arena) {
+  contact_arena_free_chunks(contact_arena);
+  free(contact_arena->chunks);
+}
+
+// Makes room for capacity contacts in total, in one chunk when the arena is empty
+void contact_arena_reserve(struct ContactArena* contact_arena, unsigned int capacity) {
+  if (contact_arena->capacity >= capacity)
+    return;
+
+  if (contact_arena->size == 0)
+    contact_arena_free_chunks(contact_arena);
+  contact_arena_add_chunk(contact_arena, capacity - contact_arena->capacity);
+}
+
+// Empties the arena for the next step, folding its chunks into one of the same total size
+void contact_arena_reset(struct ContactArena* contact_arena) {
+  contact_arena->size = 0;
+  if (contact_arena->chunk_count > 1) {
+    unsigned int capacity = contact_arena->capacity;
+    contact_arena_free_chunks(contact_arena);
+    contact_arena_add_chunk(contact_arena, capacity);
+  }
+  if (contact_arena->chunk_count == 1)
+    contact_arena->chunks[0].size = 0;
+}
+
+// Span with room for at least count contacts, at least one, and limit is set to all the room
+// it has. Nothing is used until it is committed.
+struct Contact* contact_arena_begin(struct ContactArena* contact_arena, unsigned int count, unsigned int* limit) {
+  if (count == 0)
+    count = 1;
+  struct ContactChunk* chunk = contact_arena->chunk_count ? &contact_arena->chunks[contact_arena->chunk_count - 1] : NULL;
+
+  if (!chunk || chunk->capacity - chunk->size < count) {
+    unsigned int capacity = contact_arena->capacity > CONTACT_ARENA_MIN_CHUNK ? contact_arena->capacity : CONTACT_ARENA_MIN_CHUNK;
+    contact_arena_add_chunk(contact_arena, capacity > count ? capacity : count);
+    chunk = &contact_arena->chunks[contact_arena->chunk_count - 1];
+  }
+
+  *limit = chunk->capacity - chunk->size;
+  return chunk->contacts + chunk->size;
+}
+
+void contact_arena_commit(struct ContactArena* contact_arena, unsigned int count) {
+  contact_arena->chunks[contact_arena->chunk_count - 1].size += count;
+  contact_arena->size += count;
+  if (contact_arena->high_water < contact_arena->size)
+    contact_arena->high_water = contact_arena->size;
+}
+
+// Every committed contact in one array, in the order they were committed
+struct Contact* contact_arena_flatten(struct ContactArena* contact_arena) {
+  if (contact_arena->chunk_count == 0)
+    return NULL;
+  if (contact_arena->chunk_count == 1)
+    return contact_arena->chunks[0].contacts;
+
+  // NOTE: Only steps where the arena grew get here, the single chunk is kept from now on
+  struct ContactChunk flat = {.contacts = malloc(sizeof(struct Contact) * contact_arena->capacity), .capacity = contact_arena->capacity, .size = 0};
+  for (unsigned int chunk_num = 0; chunk_num < contact_arena->chunk_count; chunk_num++) {
+    struct ContactChunk* chunk = &contact_arena->chunks[chunk_num];
+    memcpy(flat.contacts + flat.size, chunk->contacts, sizeof(struct Contact) * chunk->size);
+    flat.size += chunk->size;
+  }
+
+  contact_arena_free_chunks(contact_arena);
+  contact_arena->chunks[0] = flat;
+  contact_arena->chunk_count = 1;
+  contact_arena->capacity = flat.capacity;
+  return flat.contacts;
+}
@@ -0,0 +1,318 @@
+#include "chaos/core/contactgraph.h"
+
+#include "chaos/core/contacts.h"
+
+static inline bool contact_graph_is_movable(struct RigidBody* body) {
+  return body && body->inverse_mass != 0.0f;
+}
+
+static inline unsigned int contact_graph_hash(struct ContactGraph* contact_graph, struct RigidBody* body) {
+  return (unsigned int)(((uintptr_t)body >> 4) * 2654435761u) & (contact_graph->table_capacity - 1);
+}
+
+static unsigned int contact_graph_insert_body(struct ContactGraph* contact_graph, struct RigidBody* body) {
+  unsigned int slot = contact_graph_hash(contact_graph, body);
+  while (contact_graph->table_body[slot]) {
+    if (contact_graph->table_body[slot] == body)
+      return contact_graph->table_index[slot];
+    slot = (slot + 1) & (contact_graph->table_capacity - 1);
+  }
+
+  unsigned int index = contact_graph->body_count++;
+  contact_graph->table_body[slot] = body;
+  contact_graph->table_index[slot] = index;
+  contact_graph->bodies[index] = body;
+  contact_graph->body_colors[index] = 0;
+  contact_graph->body_linear_change[index] = VEC3_ZERO;
+  contact_graph->body_angular_change[index] = VEC3_ZERO;
+  return index;
+}
+
+static void contact_graph_free(struct ContactGraph* contact_graph) {
+  free(contact_graph->order);
+  free(contact_graph->contact_color);
+  free(contact_graph->contact_body);
+  free(contact_graph->contact_visit);
+  free(contact_graph->neighbours);
+  free(contact_graph->table_body);
+  free(contact_graph->table_index);
+  free(contact_graph->bodies);
+  free(contact_graph->body_contact_start);
+  free(contact_graph->body_contacts);
+  free(contact_graph->body_colors);
+  free(contact_graph->body_linear_change);
+  free(contact_graph->body_angular_change);
+}
+
+static void contact_graph_reserve(struct ContactGraph* contact_graph, unsigned int num_contacts) {
+  if (contact_graph->contact_capacity >= num_contacts)
+    return;
+
+  contact_graph_free(contact_graph);
+
+  // NOTE: At most two bodies per contact, the table is kept at most half full
+  unsigned int max_bodies = num_contacts * 2;
+  contact_graph->contact_capacity = num_contacts;
+  contact_graph->table_capacity = 1;
+  while (contact_graph->table_capacity < max_bodies * 2)
+    contact_graph->table_capacity *= 2;
+
+  contact_graph->order = malloc(sizeof(unsigned int) * num_contacts);
+  contact_graph->contact_color = malloc(sizeof(unsigned int) * num_contacts);
+  contact_graph->contact_body = malloc(sizeof(unsigned int) * max_bodies);
+  contact_graph->contact_visit = calloc(num_contacts, sizeof(unsigned int));
+  contact_graph->visit = 0;
+  contact_graph->neighbours = malloc(sizeof(unsigned int) * num_contacts);
+  contact_graph->table_body = malloc(sizeof(struct RigidBody*) * contact_graph->table_capacity);
+  contact_graph->table_index = malloc(sizeof(unsigned int) * contact_graph->table_capacity);
+  contact_graph->bodies = malloc(sizeof(struct RigidBody*) * max_bodies);
+  contact_graph->body_contact_start = malloc(sizeof(unsigned int) * (max_bodies + 1));
+  contact_graph->body_contacts = malloc(sizeof(unsigned int) * max_bodies);
+  contact_graph->body_colors = malloc(sizeof(uint64_t) * max_bodies);
+  contact_graph->body_linear_change = malloc(sizeof(vec3) * max_bodies);
+  contact_graph->body_angular_change = malloc(sizeof(vec3) * max_bodies);
+
+  memset(contact_graph->table_body, 0, sizeof(struct RigidBody*) * contact_graph->table_capacity);
+  contact_graph->body_count = 0;
+}
+
+void contact_graph_init(struct ContactGraph* contact_graph) {
+  contact_graph->contact_count = 0;
+  contact_graph->contact_capacity = 0;
+  contact_graph->order = NULL;
+  contact_graph->contact_color = NULL;
+  contact_graph->contact_body = NULL;
+  contact_graph->contact_visit = NULL;
+  contact_graph->visit = 0;
+  contact_graph->neighbours = NULL;
+  contact_graph->color_count = 0;
+  contact_graph->body_count = 0;
+  contact_graph->table_capacity = 0;
+  contact_graph->table_body = NULL;
+  contact_graph->table_index = NULL;
+  contact_graph->bodies = NULL;
+  contact_graph->body_contact_start = NULL;
+  contact_graph->body_contacts = NULL;
+  contact_graph->body_colors = NULL;
+  contact_graph->body_linear_change = NULL;
+  contact_graph->body_angular_change = NULL;
+}
+
+void contact_graph_delete(struct ContactGraph* contact_graph) {
+  contact_graph_free(contact_graph);
+}
+
+unsigned int contact_graph_find_body(struct ContactGraph* contact_graph, struct RigidBody* body) {
+  if (!body || contact_graph->table_capacity == 0)
+    return CONTACT_GRAPH_NO_BODY;
+
+  unsigned int slot = contact_graph_hash(contact_graph, body);
+  while (contact_graph->table_body[slot]) {
+    if (contact_graph->table_body[slot] == body)
+      return contact_graph->table_index[slot];
+    slot = (slot + 1) & (contact_graph->table_capacity - 1);
+  }
+  return CONTACT_GRAPH_NO_BODY;
+}
+
+void contact_graph_index_bodies(struct ContactGraph* contact_graph, struct Contact* contacts, unsigned int num_contacts) {
+  contact_graph_reserve(contact_graph, num_contacts);
+
+  // NOTE: Only the slots of the previous bodies are cleared, so a small set indexed after a
+  // large one stays cheap. Newest first, every probe then still runs over the older entries.
+  for (unsigned int body_num = contact_graph->body_count; body_num-- > 0;) {
+    unsigned int slot = contact_graph_hash(contact_graph, contact_graph->bodies[body_num]);
+    while (contact_graph->table_body[slot] != contact_graph->bodies[body_num])
+      slot = (slot + 1) & (contact_graph->table_capacity - 1);
+    contact_graph->table_body[slot] = NULL;
+  }
+
+  contact_graph->contact_count = num_contacts;
+  contact_graph->body_count = 0;
+
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+    for (unsigned int b = 0; b < 2; b++) {
+      struct RigidBody* body = contacts[contact_num].body[b];
+      contact_graph->contact_body[contact_num * 2 + b] = contact_graph_is_movable(body) ? contact_graph_insert_body(contact_graph, body) : CONTACT_GRAPH_NO_BODY;
+    }
+}
+
+// Compressed per-body contact lists, each list in contact order
+void contact_graph_build_adjacency(struct ContactGraph* contact_graph) {
+  unsigned int* start = contact_graph->body_contact_start;
+
+  memset(start, 0, sizeof(unsigned int) * (contact_graph->body_count + 1));
+  for (unsigned int entry = 0; entry < contact_graph->contact_count * 2; entry++)
+    if (contact_graph->contact_body[entry] != CONTACT_GRAPH_NO_BODY)
+      start[contact_graph->contact_body[entry] + 1]++;
+
+  for (unsigned int body_num = 0; body_num < contact_graph->body_count; body_num++)
+    start[body_num + 1] += start[body_num];
+
+  // NOTE: Filling shifts every start down by one list, the pass after puts them back
+  for (unsigned int entry = 0; entry < contact_graph->contact_count * 2; entry++) {
+    unsigned int body_index = contact_graph->contact_body[entry];
+    if (body_index != CONTACT_GRAPH_NO_BODY)
+      contact_graph->body_contacts[start[body_index]++] = entry / 2;
+  }
+  for (unsigned int body_num = contact_graph->body_count; body_num > 0; body_num--)
+    start[body_num] = start[body_num - 1];
+  start[0] = 0;
+}
+
+// Collects every contact sharing a movable body with the given one, itself included, each once
+unsigned int contact_graph_gather_neighbours(struct ContactGraph* contact_graph, unsigned int contact_index) {
+  if (++contact_graph->visit == 0) {
+    memset(contact_graph->contact_visit, 0, sizeof(unsigned int) * contact_graph->contact_capacity);
+    contact_graph->visit = 1;
+  }
+
+  unsigned int count = 0;
+  for (unsigned int b = 0; b < 2; b++) {
+    unsigned int body_index = contact_graph->contact_body[contact_index * 2 + b];
+    if (body_index == CONTACT_GRAPH_NO_BODY)
+      continue;
+
+    for (unsigned int entry = contact_graph->body_contact_start[body_index]; entry < contact_graph->body_contact_start[body_index + 1]; entry++) {
+      unsigned int neighbour = contact_graph->body_contacts[entry];
+      if (contact_graph->contact_visit[neighbour] != contact_graph->visit) {
+        contact_graph->contact_visit[neighbour] = contact_graph->visit;
+        contact_graph->neighbours[count++] = neighbour;
+      }
+    }
+  }
+  return count;
+}
+
+void contact_graph_build(struct ContactGraph* contact_graph, struct Contact* contacts, unsigned int num_contacts) {
+  contact_graph_index_bodies(contact_graph, contacts, num_contacts);
+  contact_graph->color_count = 0;
+
+  unsigned int color_size[CONTACT_GRAPH_MAX_COLORS + 1] = {0};
+
+  // Colors go in contact order, so the batches only depend on the contact array
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    unsigned int* body_index = &contact_graph->contact_body[contact_num * 2];
+
+    uint64_t used = 0;
+    for (unsigned int b = 0; b < 2; b++)
+      if (body_index[b] != CONTACT_GRAPH_NO_BODY)
+        used |= contact_graph->body_colors[body_index[b]];
+
+    unsigned int color = 0;
+    while (color < CONTACT_GRAPH_MAX_COLORS && (used >> color) & 1)
+      color++;
+
+    if (color < CONTACT_GRAPH_MAX_COLORS) {
+      for (unsigned int b = 0; b < 2; b++)
+        if (body_index[b] != CONTACT_GRAPH_NO_BODY)
+          contact_graph->body_colors[body_index[b]] |= (uint64_t)1 << color;
+      if (color >= contact_graph->color_count)
+        contact_graph->color_count = color + 1;
+    }
+
+    contact_graph->contact_color[contact_num] = color;
+    color_size[color]++;
+  }
+
+  // Overflow contacts go after the last color
+  unsigned int start = 0;
+  for (unsigned int color = 0; color < contact_graph->color_count; color++) {
+    contact_graph->color_start[color] = start;
+    start += color_size[color];
+  }
+  contact_graph->color_start[contact_graph->color_count] = start;
+
+  unsigned int next[CONTACT_GRAPH_MAX_COLORS + 1];
+  memcpy(next, contact_graph->color_start, sizeof(unsigned int) * (contact_graph->color_count + 1));
+  next[CONTACT_GRAPH_MAX_COLORS] = start;
+
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+    contact_graph->order[next[contact_graph->contact_color[contact_num]]++] = contact_num;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static inline bool contact_heap_before(struct ContactHeap* contact_heap, unsigned int a, unsigned int b) {
+  return contact_heap->key[a] > contact_heap->key[b] || (contact_heap->key[a] == contact_heap->key[b] && a < b);
+}
+
+static inline void contact_heap_place(struct ContactHeap* contact_heap, unsigned int slot, unsigned int index) {
+  contact_heap->heap[slot] = index;
+  contact_heap->position[index] = slot;
+}
+
+static void contact_heap_sift_up(struct ContactHeap* contact_heap, unsigned int slot) {
+  unsigned int index = contact_heap->heap[slot];
+  while (slot > 0) {
+    unsigned int parent = (slot - 1) / 2;
+    if (!contact_heap_before(contact_heap, index, contact_heap->heap[parent]))
+      break;
+    contact_heap_place(contact_heap, slot, contact_heap->heap[parent]);
+    slot = parent;
+  }
+  contact_heap_place(contact_heap, slot, index);
+}
+
+static void contact_heap_sift_down(struct ContactHeap* contact_heap, unsigned int slot) {
+  unsigned int index = contact_heap->heap[slot];
+  for (;;) {
+    unsigned int child = slot * 2 + 1;
+    if (child >= contact_heap->size)
+      break;
+    if (child + 1 < contact_heap->size && contact_heap_before(contact_heap, contact_heap->heap[child + 1], contact_heap->heap[child]))
+      child++;
+    if (!contact_heap_before(contact_heap, contact_heap->heap[child], index))
+      break;
+    contact_heap_place(contact_heap, slot, contact_heap->heap[child]);
+    slot = child;
+  }
+  contact_heap_place(contact_heap, slot, index);
+}
+
+void contact_heap_init(struct ContactHeap* contact_heap) {
+  contact_heap->size = 0;
+  contact_heap->capacity = 0;
+  contact_heap->heap = NULL;
+  contact_heap->position = NULL;
+  contact_heap->key = NULL;
+}
+
+void contact_heap_delete(struct ContactHeap* contact_heap) {
+  free(contact_heap->heap);
+  free(contact_heap->position);
+  free(contact_heap->key);
+}
+
+// Sizes the heap for count contacts, the caller fills key and then builds
+void contact_heap_reset(struct ContactHeap* contact_heap, unsigned int count) {
+  if (contact_heap->capacity < count) {
+    contact_heap_delete(contact_heap);
+    contact_heap->capacity = count;
+    contact_heap->heap = malloc(sizeof(unsigned int) * count);
+    contact_heap->position = malloc(sizeof(unsigned int) * count);
+    contact_heap->key = malloc(sizeof(float) * count);
+  }
+  contact_heap->size = count;
+}
+
+void contact_heap_build(struct ContactHeap* contact_heap) {
+  for (unsigned int index = 0; index < contact_heap->size; index++)
+    contact_heap_place(contact_heap, index, index);
+  for (unsigned int slot = contact_heap->size / 2; slot > 0; slot--)
+    contact_heap_sift_down(contact_heap, slot - 1);
+}
+
+// Returns size when empty
+unsigned int contact_heap_top(struct ContactHeap* contact_heap) {
+  return contact_heap->size ? contact_heap->heap[0] : contact_heap->size;
+}
+
+void contact_heap_update(struct ContactHeap* contact_heap, unsigned int index, float key) {
+  float old_key = contact_heap->key[index];
+  contact_heap->key[index] = key;
+  if (key > old_key)
+    contact_heap_sift_up(contact_heap, contact_heap->position[index]);
+  else
+    contact_heap_sift_down(contact_heap, contact_heap->position[index]);
+}
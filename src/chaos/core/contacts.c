@@ -5,6 +5,7 @@ void contact_set_body_data(struct Contact* contact, struct RigidBody* one, struc
   contact->body[1] = two;
   contact->friction = friction;
   contact->restitution = restitution;
+  contact->feature = 0;
 }
 
 void contact_match_awake_state(struct Contact* contact) {
@@ -28,6 +29,10 @@ void contact_swap_bodies(struct Contact* contact) {
   struct RigidBody* temp = contact->body[0];
   contact->body[0] = contact->body[1];
   contact->body[1] = temp;
+
+  vec3 local_position = contact->local_position[0];
+  contact->local_position[0] = contact->local_position[1];
+  contact->local_position[1] = local_position;
 }
 
 void contact_calculate_contact_basis(struct Contact* contact) {
@@ -127,10 +132,12 @@ void contact_calculate_internals(struct Contact* contact, float duration) {
 
 // NOTE: Watch out for this typedef pointer
 void contact_apply_velocity_change(struct Contact* contact, vec3 velocity_change[2], vec3 rotation_change[2]) {
+  // NOTE: A body with infinite mass is immovable outright, so its inertia takes no part in the
+  // impulse either, whatever its inverse inertia tensor holds
   mat3 inverse_inertia_tensor[2];
-  inverse_inertia_tensor[0] = contact->body[0]->inverse_inertia_tensor_world;
+  inverse_inertia_tensor[0] = contact->body[0]->inverse_mass != 0.0f ? contact->body[0]->inverse_inertia_tensor_world : MAT3_ZERO;
   if (contact->body[1])
-    inverse_inertia_tensor[1] = contact->body[1]->inverse_inertia_tensor_world;
+    inverse_inertia_tensor[1] = contact->body[1]->inverse_mass != 0.0f ? contact->body[1]->inverse_inertia_tensor_world : MAT3_ZERO;
 
   vec3 impulse_contact;
   if (contact->friction == 0.0f)
@@ -141,22 +148,29 @@ void contact_apply_velocity_change(struct Contact* contact, vec3 velocity_change
   vec3 impulse = mat3_transform(contact->contact_to_world, impulse_contact);
   vec3 impulsive_torque = vec3_cross_product(contact->relative_contact_position[0], impulse);
 
-  rotation_change[0] = mat3_transform(inverse_inertia_tensor[0], impulsive_torque);
+  // NOTE: Bodies with infinite mass are never written, the colored resolver shares them across threads
+  rotation_change[0] = VEC3_ZERO;
   velocity_change[0] = VEC3_ZERO;
-  velocity_change[0] = vec3_add_scaled_vector(velocity_change[0], impulse, contact->body[0]->inverse_mass);
+  if (contact->body[0]->inverse_mass != 0.0f) {
+    rotation_change[0] = mat3_transform(inverse_inertia_tensor[0], impulsive_torque);
+    velocity_change[0] = vec3_add_scaled_vector(velocity_change[0], impulse, contact->body[0]->inverse_mass);
 
-  rigid_body_add_velocity(contact->body[0], velocity_change[0]);
-  rigid_body_add_rotation(contact->body[0], rotation_change[0]);
+    rigid_body_add_velocity(contact->body[0], velocity_change[0]);
+    rigid_body_add_rotation(contact->body[0], rotation_change[0]);
+  }
 
   if (contact->body[1]) {
     vec3 impulsive_torque = vec3_cross_product(impulse, contact->relative_contact_position[1]);
 
-    rotation_change[1] = mat3_transform(inverse_inertia_tensor[1], impulsive_torque);
+    rotation_change[1] = VEC3_ZERO;
     velocity_change[1] = VEC3_ZERO;
-    velocity_change[1] = vec3_add_scaled_vector(velocity_change[1], impulse, -contact->body[1]->inverse_mass);
+    if (contact->body[1]->inverse_mass != 0.0f) {
+      rotation_change[1] = mat3_transform(inverse_inertia_tensor[1], impulsive_torque);
+      velocity_change[1] = vec3_add_scaled_vector(velocity_change[1], impulse, -contact->body[1]->inverse_mass);
 
-    rigid_body_add_velocity(contact->body[1], velocity_change[1]);
-    rigid_body_add_rotation(contact->body[1], rotation_change[1]);
+      rigid_body_add_velocity(contact->body[1], velocity_change[1]);
+      rigid_body_add_rotation(contact->body[1], rotation_change[1]);
+    }
   }
 }
 
@@ -241,6 +255,13 @@ void contact_apply_position_change(struct Contact* contact, vec3 linear_change[2
 
   for (unsigned int i = 0; i < 2; i++)
     if (contact->body[i]) {
+      // Immovable bodies take none of the correction, linear or angular
+      if (contact->body[i]->inverse_mass == 0.0f) {
+        angular_inertia[i] = 0.0f;
+        linear_inertia[i] = 0.0f;
+        continue;
+      }
+
       mat3 inverse_inertia_tensor = contact->body[i]->inverse_inertia_tensor_world;
 
       vec3 angular_inertia_world = vec3_cross_product(contact->relative_contact_position[i], contact->contact_normal);
@@ -254,6 +275,12 @@ void contact_apply_position_change(struct Contact* contact, vec3 linear_change[2
 
   for (unsigned int i = 0; i < 2; i++)
     if (contact->body[i]) {
+      if (contact->body[i]->inverse_mass == 0.0f) {
+        linear_change[i] = VEC3_ZERO;
+        angular_change[i] = VEC3_ZERO;
+        continue;
+      }
+
       float sign = (i == 0) ? 1 : -1;
       angular_move[i] = sign * penetration * (angular_inertia[i] / total_inertia);
       linear_move[i] = sign * penetration * (linear_inertia[i] / total_inertia);
@@ -288,18 +315,90 @@ void contact_apply_position_change(struct Contact* contact, vec3 linear_change[2
 
       if (!contact->body[i]->is_awake)
         rigid_body_calculate_derived_data(contact->body[i]);
+      else
+        rigid_body_mark_dirty(contact->body[i]);
     }
 }
 
+// Expects the body transforms to match the moment the contact was generated
+void contact_store_anchors(struct Contact* contact) {
+  for (unsigned int b = 0; b < 2; b++)
+    contact->local_position[b] = contact->body[b] ? rigid_body_get_point_in_local_space(contact->body[b], contact->contact_point) : contact->contact_point;
+  contact->anchor_penetration = contact->penetration;
+}
+
+// Moves the contact point and penetration along with the bodies since the anchors were stored.
+// The normal is kept, which holds as long as the bodies turn little in between.
+void contact_follow_anchors(struct Contact* contact) {
+  vec3 anchor[2];
+  for (unsigned int b = 0; b < 2; b++)
+    anchor[b] = contact->body[b] ? rigid_body_get_point_in_world_space(contact->body[b], contact->local_position[b]) : contact->local_position[b];
+
+  contact->contact_point = vec3_scale(vec3_add(anchor[0], anchor[1]), 0.5f);
+  contact->penetration = contact->anchor_penetration - vec3_dot(vec3_sub(anchor[0], anchor[1]), contact->contact_normal);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 
 void contact_resolver_init(struct ContactResolver* contact_resolver, unsigned int velocity_iterations, unsigned int position_iterations, float velocity_epsilon, float position_epsilon) {
+  contact_resolver->mode = CONTACT_RESOLVER_WORST_FIRST;
+  contact_resolver->scheduler = NULL;
+  contact_resolver->iterations_per_contact = 0;
+  contact_resolver->velocity_iterations_used = 0;
+  contact_resolver->position_iterations_used = 0;
+  contact_resolver->time_budget = 0.0f;
+  contact_resolver->position_deadline = 0.0;
+  contact_resolver->velocity_deadline = 0.0;
+  contact_resolver->velocity_error = 0.0f;
+  contact_resolver->position_error = 0.0f;
+  contact_resolver->out_of_time = false;
+  contact_resolver->impulse_iterations = IMPULSE_SOLVER_ITERATIONS;
+  contact_resolver->warm_starting = true;
+  impulse_cache_init(&contact_resolver->impulse_cache);
+  contact_resolver->joints = NULL;
+  contact_resolver->joint_count = 0;
+  joint_solver_init(&contact_resolver->joint_solver);
+  contact_resolver->workspace_count = 0;
+  contact_resolver->workspaces = NULL;
+  contact_graph_init(&contact_resolver->impulse_workspace.graph);
+  contact_heap_init(&contact_resolver->impulse_workspace.heap);
+  impulse_solver_init(&contact_resolver->impulse_workspace.impulse_solver);
+  island_builder_init(&contact_resolver->island_builder);
+  contact_resolver->island_count = 0;
+  contact_resolver->island_capacity = 0;
+  contact_resolver->islands = NULL;
+  contact_resolver->root_capacity = 0;
+  contact_resolver->root_island = NULL;
+  contact_resolver->contact_capacity = 0;
+  contact_resolver->contact_island = NULL;
+  contact_resolver->island_contacts = NULL;
   contact_resolver_set_iterations(contact_resolver, velocity_iterations, position_iterations);
   contact_resolver_set_epsilon(contact_resolver, velocity_epsilon, position_epsilon);
 }
 
+void contact_resolver_delete(struct ContactResolver* contact_resolver) {
+  impulse_cache_delete(&contact_resolver->impulse_cache);
+  joint_solver_delete(&contact_resolver->joint_solver);
+  for (unsigned int workspace_num = 0; workspace_num < contact_resolver->workspace_count; workspace_num++) {
+    struct ContactResolverWorkspace* workspace = &contact_resolver->workspaces[workspace_num];
+    contact_graph_delete(&workspace->graph);
+    contact_heap_delete(&workspace->heap);
+    impulse_solver_delete(&workspace->impulse_solver);
+  }
+  free(contact_resolver->workspaces);
+  contact_graph_delete(&contact_resolver->impulse_workspace.graph);
+  contact_heap_delete(&contact_resolver->impulse_workspace.heap);
+  impulse_solver_delete(&contact_resolver->impulse_workspace.impulse_solver);
+  island_builder_delete(&contact_resolver->island_builder);
+  free(contact_resolver->islands);
+  free(contact_resolver->root_island);
+  free(contact_resolver->contact_island);
+  free(contact_resolver->island_contacts);
+}
+
 bool contact_resolver_is_valid(struct ContactResolver* contact_resolver) {
-  return (contact_resolver->velocity_iterations > 0) && (contact_resolver->position_iterations > 0) && (contact_resolver->velocity_epsilon >= 0.0f) && (contact_resolver->position_epsilon >= 0.0f);
+  bool has_budget = contact_resolver->iterations_per_contact > 0 || ((contact_resolver->velocity_iterations > 0) && (contact_resolver->position_iterations > 0));
+  return has_budget && (contact_resolver->velocity_epsilon >= 0.0f) && (contact_resolver->position_epsilon >= 0.0f);
 }
 
 void contact_resolver_set_iterations(struct ContactResolver* contact_resolver, unsigned int velocity_iterations, unsigned int position_iterations) {
@@ -307,49 +406,305 @@ void contact_resolver_set_iterations(struct ContactResolver* contact_resolver, u
   contact_resolver->position_iterations = position_iterations;
 }
 
+// NOTE: Zero goes back to the fixed iteration counts
+void contact_resolver_set_iterations_per_contact(struct ContactResolver* contact_resolver, unsigned int iterations_per_contact) {
+  contact_resolver->iterations_per_contact = iterations_per_contact;
+}
+
+// NOTE: Zero leaves only the iteration counts in charge
+void contact_resolver_set_time_budget(struct ContactResolver* contact_resolver, float time_budget) {
+  contact_resolver->time_budget = time_budget;
+}
+
 void contact_resolver_set_epsilon(struct ContactResolver* contact_resolver, float velocity_epsilon, float position_epsilon) {
   contact_resolver->velocity_epsilon = velocity_epsilon;
   contact_resolver->position_epsilon = position_epsilon;
 }
 
-void contact_resolver_resolve_contacts(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration) {
-  if (num_contacts == 0)
-    return;
-  if (!contact_resolver_is_valid(contact_resolver))
+void contact_resolver_set_mode(struct ContactResolver* contact_resolver, enum ContactResolverMode mode) {
+  contact_resolver->mode = mode;
+}
+
+// NOTE: NULL resolves on the calling thread
+void contact_resolver_set_scheduler(struct ContactResolver* contact_resolver, struct JobScheduler* scheduler) {
+  contact_resolver->scheduler = scheduler;
+}
+
+// NOTE: The joints are not copied, they need to stay alive while the resolver uses them
+void contact_resolver_set_joints(struct ContactResolver* contact_resolver, struct JointConstraint* joints, unsigned int joint_count) {
+  contact_resolver->joints = joints;
+  contact_resolver->joint_count = joint_count;
+}
+
+static void contact_resolver_reserve_workspaces(struct ContactResolver* contact_resolver, unsigned int workspace_count) {
+  if (contact_resolver->workspace_count >= workspace_count)
     return;
 
-  contact_resolver_prepare_contacts(contact_resolver, contacts, num_contacts, duration);
-  contact_resolver_adjust_positions(contact_resolver, contacts, num_contacts, duration);
-  contact_resolver_adjust_velocities(contact_resolver, contacts, num_contacts, duration);
+  contact_resolver->workspaces = realloc(contact_resolver->workspaces, sizeof(struct ContactResolverWorkspace) * workspace_count);
+  for (unsigned int workspace_num = contact_resolver->workspace_count; workspace_num < workspace_count; workspace_num++) {
+    struct ContactResolverWorkspace* workspace = &contact_resolver->workspaces[workspace_num];
+    contact_graph_init(&workspace->graph);
+    contact_heap_init(&workspace->heap);
+    impulse_solver_init(&workspace->impulse_solver);
+  }
+  contact_resolver->workspace_count = workspace_count;
+}
+
+static inline double contact_resolver_clock(void) {
+  struct timespec time;
+  timespec_get(&time, TIME_UTC);
+  return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
 }
 
-void contact_resolver_prepare_contacts(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration) {
+static inline bool contact_resolver_past_deadline(struct ContactResolver* contact_resolver, double deadline) {
+  return contact_resolver->time_budget > 0.0f && contact_resolver_clock() > deadline;
+}
+
+// NOTE: Reading the clock costs about as much as a worst first iteration, so it is only read
+// every CONTACT_RESOLVER_CLOCK_INTERVAL iterations
+static inline bool contact_resolver_past_deadline_every(struct ContactResolver* contact_resolver, double deadline, unsigned int iterations_used) {
+  return iterations_used % CONTACT_RESOLVER_CLOCK_INTERVAL == 0 && contact_resolver_past_deadline(contact_resolver, deadline);
+}
+
+static inline unsigned int contact_resolver_budget(struct ContactResolver* contact_resolver, unsigned int iterations, unsigned int num_contacts) {
+  return contact_resolver->iterations_per_contact > 0 ? contact_resolver->iterations_per_contact * num_contacts : iterations;
+}
+
+static void contact_resolver_prepare_workspace(struct ContactResolver* contact_resolver, struct ContactResolverWorkspace* workspace, struct Contact* contacts, unsigned int num_contacts, float duration) {
   struct Contact* last_contact = contacts + num_contacts;
   for (struct Contact* contact = contacts; contact < last_contact; contact++) {
     contact_calculate_internals(contact, duration);
   }
+
+  // Waking writes to both bodies, so the colored mode does it up front instead of per batch
+  if (contact_resolver->mode == CONTACT_RESOLVER_GRAPH_COLORED) {
+    for (struct Contact* contact = contacts; contact < last_contact; contact++)
+      contact_match_awake_state(contact);
+    contact_graph_build(&workspace->graph, contacts, num_contacts);
+  } else {
+    contact_graph_index_bodies(&workspace->graph, contacts, num_contacts);
+  }
+  contact_graph_build_adjacency(&workspace->graph);
 }
 
-void contact_resolver_adjust_velocities(struct ContactResolver* contact_resolver, struct Contact* contact, unsigned int num_contacts, float duration) {
-  vec3 velocity_change[2], rotation_change[2];
+// Colors the graph and packs the constraints, the body indices and adjacency stay as they were.
+// The impulse solver visits every contact anyway, so they are all woken here.
+static void contact_resolver_prepare_impulses(struct ContactResolver* contact_resolver, struct ContactResolverWorkspace* workspace, struct Contact* contacts, unsigned int num_contacts, float duration) {
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+    contact_match_awake_state(&contacts[contact_num]);
 
-  contact_resolver->velocity_iterations_used = 0;
-  while (contact_resolver->velocity_iterations_used < contact_resolver->velocity_iterations) {
-    float max = contact_resolver->velocity_epsilon;
-    unsigned index = num_contacts;
-    for (unsigned i = 0; i < num_contacts; i++) {
-      if (contact[i].desired_delta_velocity > max) {
-        max = contact[i].desired_delta_velocity;
-        index = i;
+  contact_graph_build(&workspace->graph, contacts, num_contacts);
+  impulse_solver_prepare(&workspace->impulse_solver, &workspace->graph, contact_resolver->warm_starting ? &contact_resolver->impulse_cache : NULL, contacts, num_contacts, duration);
+}
+
+struct ContactResolverBatch {
+  struct ContactResolver* contact_resolver;
+  struct ContactGraph* contact_graph;
+  struct Contact* contacts;
+  float duration;
+  unsigned int first;
+  atomic_uint resolved;
+};
+
+// Sweeps the colors until a sweep resolves nothing or the iteration budget runs out. Overflow
+// contacts share bodies with each other, so they run in order on the calling thread.
+static unsigned int contact_resolver_sweep_colors(struct JobScheduler* scheduler, struct ContactResolverBatch* batch, job_range_function function, unsigned int iterations, double deadline, bool* out_of_time) {
+  struct ContactGraph* contact_graph = batch->contact_graph;
+
+  unsigned int iterations_used = 0;
+  while (iterations_used < iterations) {
+    unsigned int sweep_resolved = 0;
+    for (unsigned int color = 0; color <= contact_graph->color_count && iterations_used < iterations; color++) {
+      unsigned int first = contact_graph->color_start[color];
+      unsigned int last = (color < contact_graph->color_count) ? contact_graph->color_start[color + 1] : contact_graph->contact_count;
+      if (first == last)
+        continue;
+      if (contact_resolver_past_deadline(batch->contact_resolver, deadline)) {
+        *out_of_time = true;
+        return iterations_used;
       }
+
+      batch->first = first;
+      atomic_store(&batch->resolved, 0);
+      if (color < contact_graph->color_count)
+        job_scheduler_parallel_for(scheduler, last - first, CONTACT_RESOLVER_GRAIN, function, batch);
+      else
+        function(batch, 0, last - first, 0);
+
+      unsigned int resolved = atomic_load(&batch->resolved);
+      sweep_resolved += resolved;
+      iterations_used += resolved;
+    }
+    if (sweep_resolved == 0)
+      break;
+  }
+  return iterations_used;
+}
+
+// Penetration left after the moves made so far this pass, the same sum the worst first
+// resolver keeps up to date one change at a time
+static float contact_resolver_current_penetration(struct ContactGraph* contact_graph, struct Contact* contact, unsigned int contact_index) {
+  float penetration = contact->penetration;
+  for (unsigned int b = 0; b < 2; b++) {
+    unsigned int body_index = contact_graph->contact_body[contact_index * 2 + b];
+    if (body_index != CONTACT_GRAPH_NO_BODY) {
+      vec3 delta_position = vec3_add(contact_graph->body_linear_change[body_index], vec3_cross_product(contact_graph->body_angular_change[body_index], contact->relative_contact_position[b]));
+      penetration += vec3_dot(delta_position, contact->contact_normal) * (b ? 1 : -1);
+    }
+  }
+  return penetration;
+}
+
+static void contact_resolver_position_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct ContactResolverBatch* batch = data;
+  struct ContactGraph* contact_graph = batch->contact_graph;
+  vec3 linear_change[2], angular_change[2];
+  unsigned int resolved = 0;
+
+  for (unsigned int order_num = batch->first + begin; order_num < batch->first + end; order_num++) {
+    unsigned int contact_index = contact_graph->order[order_num];
+    struct Contact* contact = &batch->contacts[contact_index];
+
+    float penetration = contact_resolver_current_penetration(contact_graph, contact, contact_index);
+    if (penetration <= batch->contact_resolver->position_epsilon)
+      continue;
+
+    contact_apply_position_change(contact, linear_change, angular_change, penetration);
+    for (unsigned int b = 0; b < 2; b++) {
+      unsigned int body_index = contact_graph->contact_body[contact_index * 2 + b];
+      if (body_index != CONTACT_GRAPH_NO_BODY) {
+        contact_graph->body_linear_change[body_index] = vec3_add(contact_graph->body_linear_change[body_index], linear_change[b]);
+        contact_graph->body_angular_change[body_index] = vec3_add(contact_graph->body_angular_change[body_index], angular_change[b]);
+      }
+    }
+    resolved++;
+  }
+  atomic_fetch_add(&batch->resolved, resolved);
+}
+
+static void contact_resolver_store_penetration_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct ContactResolverBatch* batch = data;
+
+  for (unsigned int contact_num = begin; contact_num < end; contact_num++)
+    batch->contacts[contact_num].penetration = contact_resolver_current_penetration(batch->contact_graph, &batch->contacts[contact_num], contact_num);
+}
+
+// Contact velocities are rebuilt from the bodies, which earlier colors may have changed
+static void contact_resolver_velocity_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct ContactResolverBatch* batch = data;
+  struct ContactGraph* contact_graph = batch->contact_graph;
+  vec3 velocity_change[2], rotation_change[2];
+  unsigned int resolved = 0;
+
+  for (unsigned int order_num = batch->first + begin; order_num < batch->first + end; order_num++) {
+    struct Contact* contact = &batch->contacts[contact_graph->order[order_num]];
+
+    contact->contact_velocity = contact_calculate_local_velocity(contact, 0, batch->duration);
+    if (contact->body[1])
+      contact->contact_velocity = vec3_sub(contact->contact_velocity, contact_calculate_local_velocity(contact, 1, batch->duration));
+    contact_calculate_desired_delta_velocity(contact, batch->duration);
+
+    if (contact->desired_delta_velocity <= batch->contact_resolver->velocity_epsilon)
+      continue;
+
+    contact_apply_velocity_change(contact, velocity_change, rotation_change);
+    resolved++;
+  }
+  atomic_fetch_add(&batch->resolved, resolved);
+}
+
+static inline float contact_resolver_heap_error(struct ContactHeap* contact_heap, unsigned int num_contacts) {
+  unsigned int index = contact_heap_top(contact_heap);
+  return (index == num_contacts) ? 0.0f : fmaxf(contact_heap->key[index], 0.0f);
+}
+
+// Velocity error measured against the current body velocities, for the passes that do not
+// keep the desired changes up to date
+static float contact_resolver_velocity_error(struct Contact* contacts, unsigned int num_contacts, float duration) {
+  float error = 0.0f;
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    struct Contact* contact = &contacts[contact_num];
+    contact->contact_velocity = contact_calculate_local_velocity(contact, 0, duration);
+    if (contact->body[1])
+      contact->contact_velocity = vec3_sub(contact->contact_velocity, contact_calculate_local_velocity(contact, 1, duration));
+    contact_calculate_desired_delta_velocity(contact, duration);
+    error = fmaxf(error, contact->desired_delta_velocity);
+  }
+  return error;
+}
+
+static float contact_resolver_position_error(struct Contact* contacts, unsigned int num_contacts) {
+  float error = 0.0f;
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+    error = fmaxf(error, contacts[contact_num].penetration);
+  return error;
+}
+
+// Runs the impulse passes that fit in the budget and leaves the impulses in the contacts. The
+// joints work on the same body velocities, each pass sweeps them after the contacts.
+static void contact_resolver_solve_impulses(struct ContactResolver* contact_resolver, struct ContactResolverWorkspace* workspace, struct JobScheduler* scheduler, struct Contact* contacts, unsigned int num_contacts, float duration, struct ContactIsland* island) {
+  struct JointSolver* joint_solver = &contact_resolver->joint_solver;
+  joint_solver_prepare(joint_solver, contact_resolver->joints, contact_resolver->joint_count, &workspace->graph, workspace->impulse_solver.body_state, duration);
+
+  island->velocity_iterations_used = 0;
+  while (island->velocity_iterations_used < contact_resolver->impulse_iterations) {
+    if (contact_resolver_past_deadline(contact_resolver, contact_resolver->velocity_deadline)) {
+      island->out_of_time = true;
+      break;
+    }
+    impulse_solver_iterate(&workspace->impulse_solver, scheduler);
+    joint_solver_iterate(joint_solver);
+    island->velocity_iterations_used++;
+  }
+  impulse_solver_finish(&workspace->impulse_solver, &workspace->graph, contacts);
+  joint_solver_finish(joint_solver);
+  island->velocity_error = contact_resolver_velocity_error(contacts, num_contacts, duration);
+}
+
+// Joint passes on their own, for the modes that resolve contacts one at a time
+static void contact_resolver_solve_joints(struct ContactResolver* contact_resolver, float duration) {
+  if (contact_resolver->joint_count == 0)
+    return;
+
+  struct JointSolver* joint_solver = &contact_resolver->joint_solver;
+  joint_solver_prepare(joint_solver, contact_resolver->joints, contact_resolver->joint_count, NULL, NULL, duration);
+  for (unsigned int iteration = 0; iteration < contact_resolver->impulse_iterations; iteration++) {
+    if (contact_resolver_past_deadline(contact_resolver, contact_resolver->velocity_deadline)) {
+      contact_resolver->out_of_time = true;
+      break;
     }
-    if (index == num_contacts)
+    joint_solver_iterate(joint_solver);
+  }
+  joint_solver_finish(joint_solver);
+}
+
+static void contact_resolver_adjust_velocities_worst_first(struct ContactResolver* contact_resolver, struct ContactResolverWorkspace* workspace, struct Contact* contact, unsigned int num_contacts, float duration, unsigned int iterations, struct ContactIsland* island) {
+  struct ContactGraph* contact_graph = &workspace->graph;
+  struct ContactHeap* contact_heap = &workspace->heap;
+  vec3 velocity_change[2], rotation_change[2];
+
+  contact_heap_reset(contact_heap, num_contacts);
+  for (unsigned int i = 0; i < num_contacts; i++)
+    contact_heap->key[i] = contact[i].desired_delta_velocity;
+  contact_heap_build(contact_heap);
+
+  unsigned int iterations_used = 0;
+  while (iterations_used < iterations) {
+    unsigned int index = contact_heap_top(contact_heap);
+    if (index == num_contacts || contact_heap->key[index] <= contact_resolver->velocity_epsilon)
+      break;
+    if (contact_resolver_past_deadline_every(contact_resolver, contact_resolver->velocity_deadline, iterations_used)) {
+      island->out_of_time = true;
       break;
+    }
 
     contact_match_awake_state(&contact[index]);
     contact_apply_velocity_change(&contact[index], velocity_change, rotation_change);
 
-    for (unsigned int i = 0; i < num_contacts; i++) {
+    // NOTE: Only contacts sharing a movable body can change, infinite mass bodies never move
+    unsigned int num_neighbours = contact_graph_gather_neighbours(contact_graph, index);
+    for (unsigned int neighbour = 0; neighbour < num_neighbours; neighbour++) {
+      unsigned int i = contact_graph->neighbours[neighbour];
       for (unsigned int b = 0; b < 2; b++)
         if (contact[i].body[b]) {
           for (unsigned int d = 0; d < 2; d++) {
@@ -360,34 +715,48 @@ void contact_resolver_adjust_velocities(struct ContactResolver* contact_resolver
             }
           }
         }
+      contact_heap_update(contact_heap, i, contact[i].desired_delta_velocity);
     }
-    contact_resolver->velocity_iterations_used++;
+    iterations_used++;
   }
+
+  island->velocity_iterations_used = iterations_used;
+  island->velocity_error = contact_resolver_heap_error(contact_heap, num_contacts);
 }
 
-void contact_resolver_adjust_positions(struct ContactResolver* contact_resolver, struct Contact* contact, unsigned int num_contacts, float duration) {
-  unsigned int i, index;
+static void contact_resolver_adjust_positions_worst_first(struct ContactResolver* contact_resolver, struct ContactResolverWorkspace* workspace, struct Contact* contact, unsigned int num_contacts, unsigned int iterations, struct ContactIsland* island) {
+  struct ContactGraph* contact_graph = &workspace->graph;
+  struct ContactHeap* contact_heap = &workspace->heap;
   vec3 linear_change[2], angular_change[2];
-  float max;
   vec3 delta_position;
 
-  contact_resolver->position_iterations_used = 0;
-  while (contact_resolver->position_iterations_used < contact_resolver->position_iterations) {
-    max = contact_resolver->position_epsilon;
-    index = num_contacts;
-    for (i = 0; i < num_contacts; i++) {
-      if (contact[i].penetration > max) {
-        max = contact[i].penetration;
-        index = i;
-      }
-    }
-    if (index == num_contacts)
+  contact_heap_reset(contact_heap, num_contacts);
+  for (unsigned int i = 0; i < num_contacts; i++)
+    contact_heap->key[i] = contact[i].penetration;
+  contact_heap_build(contact_heap);
+
+  unsigned int iterations_used = 0;
+  while (iterations_used < iterations) {
+    unsigned int index = contact_heap_top(contact_heap);
+    if (index == num_contacts || contact_heap->key[index] <= contact_resolver->position_epsilon)
+      break;
+    if (contact_resolver_past_deadline_every(contact_resolver, contact_resolver->position_deadline, iterations_used)) {
+      island->out_of_time = true;
       break;
+    }
+
+    // NOTE: The impulse solver leaves some overlap so the contact is found again next frame
+    // and keeps its warm start
+    float penetration = contact[index].penetration;
+    if (contact_resolver->mode == CONTACT_RESOLVER_SEQUENTIAL_IMPULSE)
+      penetration -= contact_resolver->position_epsilon * 0.5f;
 
     contact_match_awake_state(&contact[index]);
-    contact_apply_position_change(&contact[index], linear_change, angular_change, max);
+    contact_apply_position_change(&contact[index], linear_change, angular_change, penetration);
 
-    for (i = 0; i < num_contacts; i++) {
+    unsigned int num_neighbours = contact_graph_gather_neighbours(contact_graph, index);
+    for (unsigned int neighbour = 0; neighbour < num_neighbours; neighbour++) {
+      unsigned int i = contact_graph->neighbours[neighbour];
       for (unsigned int b = 0; b < 2; b++)
         if (contact[i].body[b]) {
           for (unsigned int d = 0; d < 2; d++) {
@@ -397,7 +766,287 @@ void contact_resolver_adjust_positions(struct ContactResolver* contact_resolver,
             }
           }
         }
+      contact_heap_update(contact_heap, i, contact[i].penetration);
+    }
+    iterations_used++;
+  }
+
+  island->position_iterations_used = iterations_used;
+  island->position_error = contact_resolver_heap_error(contact_heap, num_contacts);
+}
+
+// Leaves the impulses in the contacts, the cache is only stored once every island is done
+static void contact_resolver_adjust_velocities_workspace(struct ContactResolver* contact_resolver, struct ContactResolverWorkspace* workspace, struct JobScheduler* scheduler, struct Contact* contact, unsigned int num_contacts, float duration, struct ContactIsland* island) {
+  unsigned int iterations = contact_resolver_budget(contact_resolver, contact_resolver->velocity_iterations, num_contacts);
+
+  if (contact_resolver->mode == CONTACT_RESOLVER_GRAPH_COLORED) {
+    struct ContactResolverBatch batch = {.contact_resolver = contact_resolver, .contact_graph = &workspace->graph, .contacts = contact, .duration = duration};
+    island->velocity_iterations_used = contact_resolver_sweep_colors(scheduler, &batch, contact_resolver_velocity_range, iterations, contact_resolver->velocity_deadline, &island->out_of_time);
+    island->velocity_error = contact_resolver_velocity_error(contact, num_contacts, duration);
+  } else if (contact_resolver->mode == CONTACT_RESOLVER_SEQUENTIAL_IMPULSE) {
+    contact_resolver_solve_impulses(contact_resolver, workspace, scheduler, contact, num_contacts, duration, island);
+  } else {
+    contact_resolver_adjust_velocities_worst_first(contact_resolver, workspace, contact, num_contacts, duration, iterations, island);
+  }
+}
+
+static void contact_resolver_adjust_positions_workspace(struct ContactResolver* contact_resolver, struct ContactResolverWorkspace* workspace, struct JobScheduler* scheduler, struct Contact* contact, unsigned int num_contacts, float duration, struct ContactIsland* island) {
+  unsigned int iterations = contact_resolver_budget(contact_resolver, contact_resolver->position_iterations, num_contacts);
+
+  if (contact_resolver->mode == CONTACT_RESOLVER_GRAPH_COLORED) {
+    struct ContactResolverBatch batch = {.contact_resolver = contact_resolver, .contact_graph = &workspace->graph, .contacts = contact, .duration = duration};
+    island->position_iterations_used = contact_resolver_sweep_colors(scheduler, &batch, contact_resolver_position_range, iterations, contact_resolver->position_deadline, &island->out_of_time);
+    job_scheduler_parallel_for(scheduler, num_contacts, CONTACT_RESOLVER_GRAIN, contact_resolver_store_penetration_range, &batch);
+    island->position_error = contact_resolver_position_error(contact, num_contacts);
+  } else {
+    contact_resolver_adjust_positions_worst_first(contact_resolver, workspace, contact, num_contacts, iterations, island);
+  }
+}
+
+// Union-find over the movable bodies, then a stable counting sort of the contacts by island.
+// Islands are numbered in order of their first contact, so the split does not depend on
+// where bodies sit in memory.
+static void contact_resolver_build_islands(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts) {
+  struct ContactGraph* contact_graph = &contact_resolver->workspaces[0].graph;
+  struct IslandBuilder* island_builder = &contact_resolver->island_builder;
+
+  contact_graph_index_bodies(contact_graph, contacts, num_contacts);
+  island_builder_reset(island_builder, contact_graph->body_count);
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    unsigned int one = contact_graph->contact_body[contact_num * 2];
+    unsigned int two = contact_graph->contact_body[contact_num * 2 + 1];
+    if (one != CONTACT_GRAPH_NO_BODY && two != CONTACT_GRAPH_NO_BODY)
+      island_builder_union(island_builder, one, two);
+  }
+
+  if (contact_resolver->contact_capacity < num_contacts) {
+    free(contact_resolver->contact_island);
+    free(contact_resolver->island_contacts);
+    contact_resolver->contact_capacity = num_contacts;
+    contact_resolver->contact_island = malloc(sizeof(unsigned int) * num_contacts);
+    contact_resolver->island_contacts = malloc(sizeof(struct Contact) * num_contacts);
+  }
+  if (contact_resolver->island_capacity < num_contacts) {
+    free(contact_resolver->islands);
+    contact_resolver->island_capacity = num_contacts;
+    contact_resolver->islands = malloc(sizeof(struct ContactIsland) * num_contacts);
+  }
+  if (contact_resolver->root_capacity < contact_graph->body_count) {
+    free(contact_resolver->root_island);
+    contact_resolver->root_capacity = contact_graph->body_count;
+    contact_resolver->root_island = malloc(sizeof(unsigned int) * contact_graph->body_count);
+  }
+  for (unsigned int body_num = 0; body_num < contact_graph->body_count; body_num++)
+    contact_resolver->root_island[body_num] = CONTACT_RESOLVER_NO_ISLAND;
+
+  contact_resolver->island_count = 0;
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    unsigned int one = contact_graph->contact_body[contact_num * 2];
+    unsigned int two = contact_graph->contact_body[contact_num * 2 + 1];
+    unsigned int body = (one != CONTACT_GRAPH_NO_BODY) ? one : two;
+
+    // NOTE: Immovable bodies are shared between islands, so any waking they need happens here
+    // rather than inside the island tasks
+    if (one == CONTACT_GRAPH_NO_BODY || two == CONTACT_GRAPH_NO_BODY)
+      contact_match_awake_state(&contacts[contact_num]);
+
+    unsigned int island;
+    if (body == CONTACT_GRAPH_NO_BODY) {
+      island = contact_resolver->island_count++;
+    } else {
+      unsigned int root = island_builder_find(island_builder, body);
+      if (contact_resolver->root_island[root] == CONTACT_RESOLVER_NO_ISLAND)
+        contact_resolver->root_island[root] = contact_resolver->island_count++;
+      island = contact_resolver->root_island[root];
     }
-    contact_resolver->position_iterations_used++;
+    contact_resolver->contact_island[contact_num] = island;
+  }
+
+  for (unsigned int island_num = 0; island_num < contact_resolver->island_count; island_num++)
+    contact_resolver->islands[island_num] = (struct ContactIsland){0};
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    struct ContactIsland* island = &contact_resolver->islands[contact_resolver->contact_island[contact_num]];
+    island->count++;
+    island->position_error = fmaxf(island->position_error, contacts[contact_num].penetration);
   }
+
+  unsigned int first = 0;
+  for (unsigned int island_num = 0; island_num < contact_resolver->island_count; island_num++) {
+    contact_resolver->islands[island_num].first = first;
+    first += contact_resolver->islands[island_num].count;
+  }
+
+  if (contact_resolver->island_count == 1)
+    return;
+
+  for (unsigned int island_num = 0; island_num < contact_resolver->island_count; island_num++)
+    contact_resolver->islands[island_num].count = 0;
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    struct ContactIsland* island = &contact_resolver->islands[contact_resolver->contact_island[contact_num]];
+    contact_resolver->island_contacts[island->first + island->count++] = contacts[contact_num];
+  }
+  memcpy(contacts, contact_resolver->island_contacts, sizeof(struct Contact) * num_contacts);
+}
+
+// A later substep keeps the islands and the contact order, only the stats start over
+static void contact_resolver_refresh_islands(struct ContactResolver* contact_resolver, struct Contact* contacts) {
+  for (unsigned int island_num = 0; island_num < contact_resolver->island_count; island_num++) {
+    struct ContactIsland* island = &contact_resolver->islands[island_num];
+    *island = (struct ContactIsland){.first = island->first, .count = island->count};
+    island->position_error = contact_resolver_position_error(contacts + island->first, island->count);
+  }
+}
+
+// Worst penetration first, then contact order so the order stays deterministic
+static int contact_resolver_compare_islands(const void* a, const void* b) {
+  const struct ContactIsland* one = a;
+  const struct ContactIsland* two = b;
+  if (one->position_error != two->position_error)
+    return (one->position_error < two->position_error) ? 1 : -1;
+  return (one->first > two->first) - (one->first < two->first);
+}
+
+// NOTE: Sequential impulse runs a fixed number of passes, so splitting its velocity pass gains no
+// early exit and only leaves SIMD lanes empty. It runs once over every island afterwards.
+static void contact_resolver_solve_island(struct ContactResolver* contact_resolver, struct ContactResolverWorkspace* workspace, struct JobScheduler* scheduler, struct ContactIsland* island, struct Contact* contacts, float duration) {
+  struct Contact* island_contacts = contacts + island->first;
+  contact_resolver_prepare_workspace(contact_resolver, workspace, island_contacts, island->count, duration);
+  contact_resolver_adjust_positions_workspace(contact_resolver, workspace, scheduler, island_contacts, island->count, duration, island);
+  if (contact_resolver->mode != CONTACT_RESOLVER_SEQUENTIAL_IMPULSE)
+    contact_resolver_adjust_velocities_workspace(contact_resolver, workspace, scheduler, island_contacts, island->count, duration, island);
+}
+
+struct ContactResolverIslands {
+  struct ContactResolver* contact_resolver;
+  struct Contact* contacts;
+  float duration;
+};
+
+// NOTE: The scheduler is not passed down, a task waiting on its own parallel_for could pick up
+// another island on the same thread and with it the same workspace
+static void contact_resolver_island_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct ContactResolverIslands* islands = data;
+  struct ContactResolver* contact_resolver = islands->contact_resolver;
+
+  for (unsigned int island_num = begin; island_num < end; island_num++) {
+    struct ContactIsland* island = &contact_resolver->islands[island_num];
+    if (island->count < CONTACT_RESOLVER_LARGE_ISLAND)
+      contact_resolver_solve_island(contact_resolver, &contact_resolver->workspaces[thread_index], NULL, island, islands->contacts, islands->duration);
+  }
+}
+
+// The impulse passes run once over every island, their error is then split back per island.
+// Only the first substep of a step colors and packs, the cache takes the last one's impulses.
+static void contact_resolver_solve_impulse_islands(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration, bool first_substep, bool last_substep) {
+  struct ContactResolverWorkspace* workspace = &contact_resolver->impulse_workspace;
+  struct ContactIsland all = {.count = num_contacts};
+
+  if (first_substep)
+    contact_resolver_prepare_impulses(contact_resolver, workspace, contacts, num_contacts, duration);
+  else
+    impulse_solver_refresh(&workspace->impulse_solver, &workspace->graph, contacts, contact_resolver->warm_starting, duration);
+  contact_resolver_solve_impulses(contact_resolver, workspace, contact_resolver->scheduler, contacts, num_contacts, duration, &all);
+  if (last_substep)
+    impulse_cache_store(&contact_resolver->impulse_cache, contacts, num_contacts);
+
+  for (unsigned int island_num = 0; island_num < contact_resolver->island_count; island_num++) {
+    struct ContactIsland* island = &contact_resolver->islands[island_num];
+    island->velocity_iterations_used = all.velocity_iterations_used;
+    island->velocity_error = 0.0f;
+    for (unsigned int contact_num = island->first; contact_num < island->first + island->count; contact_num++)
+      island->velocity_error = fmaxf(island->velocity_error, contacts[contact_num].desired_delta_velocity);
+    island->out_of_time |= all.out_of_time;
+  }
+}
+
+void contact_resolver_resolve_contacts(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration) {
+  contact_resolver_resolve_substep(contact_resolver, contacts, num_contacts, duration, true, true);
+}
+
+void contact_resolver_resolve_substep(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration, bool first_substep, bool last_substep) {
+  if (first_substep)
+    contact_resolver->island_count = 0;
+  contact_resolver->velocity_iterations_used = 0;
+  contact_resolver->position_iterations_used = 0;
+  contact_resolver->velocity_error = 0.0f;
+  contact_resolver->position_error = 0.0f;
+  contact_resolver->out_of_time = false;
+  if (!contact_resolver_is_valid(contact_resolver))
+    return;
+
+  double start = contact_resolver_clock();
+  contact_resolver->position_deadline = start + contact_resolver->time_budget * CONTACT_RESOLVER_POSITION_SHARE;
+  contact_resolver->velocity_deadline = start + contact_resolver->time_budget;
+  if (num_contacts == 0) {
+    contact_resolver_solve_joints(contact_resolver, duration);
+    return;
+  }
+
+  struct JobScheduler* scheduler = contact_resolver->scheduler;
+  contact_resolver_reserve_workspaces(contact_resolver, job_scheduler_thread_count(scheduler));
+  if (first_substep)
+    contact_resolver_build_islands(contact_resolver, contacts, num_contacts);
+  else
+    contact_resolver_refresh_islands(contact_resolver, contacts);
+  if (contact_resolver->time_budget > 0.0f)
+    qsort(contact_resolver->islands, contact_resolver->island_count, sizeof(struct ContactIsland), contact_resolver_compare_islands);
+
+  for (unsigned int island_num = 0; island_num < contact_resolver->island_count; island_num++) {
+    struct ContactIsland* island = &contact_resolver->islands[island_num];
+    if (island->count >= CONTACT_RESOLVER_LARGE_ISLAND)
+      contact_resolver_solve_island(contact_resolver, &contact_resolver->workspaces[0], scheduler, island, contacts, duration);
+  }
+
+  struct ContactResolverIslands islands = {.contact_resolver = contact_resolver, .contacts = contacts, .duration = duration};
+  job_scheduler_parallel_for(scheduler, contact_resolver->island_count, 1, contact_resolver_island_range, &islands);
+
+  if (contact_resolver->mode == CONTACT_RESOLVER_SEQUENTIAL_IMPULSE)
+    contact_resolver_solve_impulse_islands(contact_resolver, contacts, num_contacts, duration, first_substep, last_substep);
+  else
+    contact_resolver_solve_joints(contact_resolver, duration);
+
+  for (unsigned int island_num = 0; island_num < contact_resolver->island_count; island_num++) {
+    struct ContactIsland* island = &contact_resolver->islands[island_num];
+    contact_resolver->velocity_iterations_used += island->velocity_iterations_used;
+    contact_resolver->position_iterations_used += island->position_iterations_used;
+    contact_resolver->velocity_error = fmaxf(contact_resolver->velocity_error, island->velocity_error);
+    contact_resolver->position_error = fmaxf(contact_resolver->position_error, island->position_error);
+    contact_resolver->out_of_time |= island->out_of_time;
+  }
+  if (contact_resolver->mode == CONTACT_RESOLVER_SEQUENTIAL_IMPULSE)
+    contact_resolver->velocity_iterations_used = contact_resolver->islands[0].velocity_iterations_used;
+}
+
+// The three steps below treat the contacts as a single island, each pass gets its share of the
+// time budget from when it starts
+void contact_resolver_prepare_contacts(struct ContactResolver* contact_resolver, struct Contact* contacts, unsigned int num_contacts, float duration) {
+  contact_resolver->out_of_time = false;
+  contact_resolver_reserve_workspaces(contact_resolver, 1);
+  contact_resolver_prepare_workspace(contact_resolver, &contact_resolver->workspaces[0], contacts, num_contacts, duration);
+  if (contact_resolver->mode == CONTACT_RESOLVER_SEQUENTIAL_IMPULSE)
+    contact_resolver_prepare_impulses(contact_resolver, &contact_resolver->workspaces[0], contacts, num_contacts, duration);
+}
+
+void contact_resolver_adjust_velocities(struct ContactResolver* contact_resolver, struct Contact* contact, unsigned int num_contacts, float duration) {
+  struct ContactIsland island = {.count = num_contacts};
+  contact_resolver->velocity_deadline = contact_resolver_clock() + contact_resolver->time_budget * (1.0f - CONTACT_RESOLVER_POSITION_SHARE);
+  contact_resolver_adjust_velocities_workspace(contact_resolver, &contact_resolver->workspaces[0], contact_resolver->scheduler, contact, num_contacts, duration, &island);
+  if (contact_resolver->mode == CONTACT_RESOLVER_SEQUENTIAL_IMPULSE)
+    impulse_cache_store(&contact_resolver->impulse_cache, contact, num_contacts);
+
+  contact_resolver->velocity_iterations_used = island.velocity_iterations_used;
+  contact_resolver->velocity_error = island.velocity_error;
+  contact_resolver->out_of_time |= island.out_of_time;
+  if (contact_resolver->mode != CONTACT_RESOLVER_SEQUENTIAL_IMPULSE)
+    contact_resolver_solve_joints(contact_resolver, duration);
+}
+
+void contact_resolver_adjust_positions(struct ContactResolver* contact_resolver, struct Contact* contact, unsigned int num_contacts, float duration) {
+  struct ContactIsland island = {.count = num_contacts};
+  contact_resolver->position_deadline = contact_resolver_clock() + contact_resolver->time_budget * CONTACT_RESOLVER_POSITION_SHARE;
+  contact_resolver_adjust_positions_workspace(contact_resolver, &contact_resolver->workspaces[0], contact_resolver->scheduler, contact, num_contacts, duration, &island);
+
+  contact_resolver->position_iterations_used = island.position_iterations_used;
+  contact_resolver->position_error = island.position_error;
+  contact_resolver->out_of_time |= island.out_of_time;
 }
@@ -0,0 +1,510 @@
+#include "chaos/core/impulse.h"
+
+#include "chaos/core/contacts.h"
+#include "chaos/core/simd.h"
+
+static inline unsigned int impulse_cache_hash(struct ImpulseCache* impulse_cache, struct RigidBody* one, struct RigidBody* two, unsigned int feature) {
+  uintptr_t hash = ((uintptr_t)one >> 4) * 2654435761u;
+  hash ^= ((uintptr_t)two >> 4) * 40503u + (hash << 6) + (hash >> 2);
+  hash ^= feature * 2246822519u;
+  return (unsigned int)hash & (impulse_cache->capacity - 1);
+}
+
+void impulse_cache_init(struct ImpulseCache* impulse_cache) {
+  impulse_cache->capacity = 0;
+  impulse_cache->size = 0;
+  impulse_cache->entries = NULL;
+}
+
+void impulse_cache_delete(struct ImpulseCache* impulse_cache) {
+  free(impulse_cache->entries);
+}
+
+// Replaces the cache with the impulses of this set of contacts
+void impulse_cache_store(struct ImpulseCache* impulse_cache, struct Contact* contacts, unsigned int num_contacts) {
+  if (impulse_cache->capacity < num_contacts * 2) {
+    free(impulse_cache->entries);
+    impulse_cache->capacity = 16;
+    while (impulse_cache->capacity < num_contacts * 2)
+      impulse_cache->capacity *= 2;
+    impulse_cache->entries = malloc(sizeof(struct ImpulseCacheEntry) * impulse_cache->capacity);
+  }
+
+  impulse_cache->size = 0;
+  for (unsigned int slot = 0; slot < impulse_cache->capacity; slot++)
+    impulse_cache->entries[slot].body[0] = NULL;
+
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    struct Contact* contact = &contacts[contact_num];
+    unsigned int slot = impulse_cache_hash(impulse_cache, contact->body[0], contact->body[1], contact->feature);
+
+    // NOTE: Contacts sharing a key cannot be told apart next frame, handing each the impulse of
+    // one of them would warm start the pair several times over, so the key is marked ambiguous
+    bool found = false;
+    while (impulse_cache->entries[slot].body[0]) {
+      struct ImpulseCacheEntry* entry = &impulse_cache->entries[slot];
+      if (entry->body[0] == contact->body[0] && entry->body[1] == contact->body[1] && entry->feature == contact->feature) {
+        entry->ambiguous = true;
+        found = true;
+        break;
+      }
+      slot = (slot + 1) & (impulse_cache->capacity - 1);
+    }
+    if (found)
+      continue;
+
+    impulse_cache->entries[slot] = (struct ImpulseCacheEntry){.body = {contact->body[0], contact->body[1]}, .feature = contact->feature, .ambiguous = false, .impulse = mat3_transform(contact->contact_to_world, contact->accumulated_impulse)};
+    impulse_cache->size++;
+  }
+}
+
+// NOTE: Entries stay in place to keep the probe chains whole, marking them ambiguous is enough
+// to stop a body that reuses the address from being warm started with them
+void impulse_cache_remove_body(struct ImpulseCache* impulse_cache, struct RigidBody* body) {
+  if (impulse_cache->size == 0)
+    return;
+
+  for (unsigned int slot = 0; slot < impulse_cache->capacity; slot++) {
+    struct ImpulseCacheEntry* entry = &impulse_cache->entries[slot];
+    if (entry->body[0] && (entry->body[0] == body || entry->body[1] == body))
+      entry->ambiguous = true;
+  }
+}
+
+bool impulse_cache_find(struct ImpulseCache* impulse_cache, struct Contact* contact, vec3* impulse) {
+  if (impulse_cache->size == 0)
+    return false;
+
+  unsigned int slot = impulse_cache_hash(impulse_cache, contact->body[0], contact->body[1], contact->feature);
+  while (impulse_cache->entries[slot].body[0]) {
+    struct ImpulseCacheEntry* entry = &impulse_cache->entries[slot];
+    if (entry->body[0] == contact->body[0] && entry->body[1] == contact->body[1] && entry->feature == contact->feature) {
+      if (entry->ambiguous)
+        return false;
+      *impulse = entry->impulse;
+      return true;
+    }
+    slot = (slot + 1) & (impulse_cache->capacity - 1);
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+// Impulse along direction needed per unit velocity change along it at the contact, zero
+// when nothing at the contact can move
+static float impulse_solver_mass(struct Contact* contact, vec3 direction) {
+  float inverse_mass = 0.0f;
+  for (unsigned int b = 0; b < 2; b++) {
+    struct RigidBody* body = contact->body[b];
+    if (!body || body->inverse_mass == 0.0f)
+      continue;
+
+    vec3 angular = vec3_cross_product(contact->relative_contact_position[b], direction);
+    angular = mat3_transform(body->inverse_inertia_tensor_world, angular);
+    angular = vec3_cross_product(angular, contact->relative_contact_position[b]);
+    inverse_mass += body->inverse_mass + vec3_dot(angular, direction);
+  }
+  return inverse_mass > 0.0f ? 1.0f / inverse_mass : 0.0f;
+}
+
+// Constraint layout, every field is SIMD_WIDTH floats wide. Rows are the normal and the two
+// tangents, each with its direction, r x direction per body, the inverse inertia applied to
+// that, and the mass along the direction.
+#define IMPULSE_ROW_DIRECTION 0
+#define IMPULSE_ROW_ANGULAR 3
+#define IMPULSE_ROW_INVERSE_ANGULAR 9
+#define IMPULSE_ROW_MASS 15
+#define IMPULSE_ROW_FLOATS 16
+#define IMPULSE_INVERSE_MASS (IMPULSE_ROW_FLOATS * 3)
+#define IMPULSE_TARGET (IMPULSE_INVERSE_MASS + 2)
+#define IMPULSE_FRICTION (IMPULSE_TARGET + 1)
+#define IMPULSE_BIAS (IMPULSE_FRICTION + 1)
+#define IMPULSE_ACCUMULATED (IMPULSE_BIAS + 3)
+#define IMPULSE_CONSTRAINT_FLOATS (IMPULSE_ACCUMULATED + 3)
+
+static inline float* impulse_solver_group(struct ImpulseSolver* impulse_solver, unsigned int group) {
+  return impulse_solver->constraints + (size_t)group * IMPULSE_CONSTRAINT_FLOATS * SIMD_WIDTH;
+}
+
+static inline void impulse_solver_set(float* group, unsigned int field, unsigned int lane, float value) {
+  group[field * SIMD_WIDTH + lane] = value;
+}
+
+static inline float impulse_solver_get(float* group, unsigned int field, unsigned int lane) {
+  return group[field * SIMD_WIDTH + lane];
+}
+
+static inline bool impulse_solver_is_movable(struct RigidBody* body) {
+  return body && body->inverse_mass != 0.0f;
+}
+
+void impulse_solver_init(struct ImpulseSolver* impulse_solver) {
+  impulse_solver->group_count = 0;
+  impulse_solver->group_capacity = 0;
+  impulse_solver->constraints = NULL;
+  impulse_solver->lane_contact = NULL;
+  impulse_solver->lane_body = NULL;
+  impulse_solver->color_count = 0;
+  impulse_solver->body_capacity = 0;
+  impulse_solver->dummy_body = 0;
+  impulse_solver->body_state = NULL;
+}
+
+void impulse_solver_delete(struct ImpulseSolver* impulse_solver) {
+  free(impulse_solver->constraints);
+  free(impulse_solver->lane_contact);
+  free(impulse_solver->lane_body);
+  free(impulse_solver->body_state);
+}
+
+static void impulse_solver_reserve(struct ImpulseSolver* impulse_solver, unsigned int group_count, unsigned int body_count) {
+  if (impulse_solver->group_capacity < group_count) {
+    free(impulse_solver->constraints);
+    free(impulse_solver->lane_contact);
+    free(impulse_solver->lane_body);
+    impulse_solver->group_capacity = group_count;
+    impulse_solver->constraints = malloc(sizeof(float) * IMPULSE_CONSTRAINT_FLOATS * SIMD_WIDTH * group_count);
+    impulse_solver->lane_contact = malloc(sizeof(unsigned int) * SIMD_WIDTH * group_count);
+    impulse_solver->lane_body = malloc(sizeof(unsigned int) * 2 * SIMD_WIDTH * group_count);
+  }
+
+  if (impulse_solver->body_capacity < body_count + 1) {
+    free(impulse_solver->body_state);
+    impulse_solver->body_capacity = body_count + 1;
+    impulse_solver->body_state = malloc(sizeof(float) * IMPULSE_SOLVER_BODY_FLOATS * impulse_solver->body_capacity);
+  }
+}
+
+// Adds impulse along a row to the two bodies of a lane
+static void impulse_solver_apply_lane(struct ImpulseSolver* impulse_solver, unsigned int group_num, unsigned int lane, unsigned int row, float impulse) {
+  float* group = impulse_solver_group(impulse_solver, group_num);
+  unsigned int* lane_body = impulse_solver->lane_body + ((size_t)group_num * SIMD_WIDTH + lane) * 2;
+  unsigned int base = row * IMPULSE_ROW_FLOATS;
+
+  for (unsigned int b = 0; b < 2; b++) {
+    float* state = impulse_solver->body_state + (size_t)lane_body[b] * IMPULSE_SOLVER_BODY_FLOATS;
+    float sign = b ? -1.0f : 1.0f;
+    float linear = sign * impulse * impulse_solver_get(group, IMPULSE_INVERSE_MASS + b, lane);
+    for (unsigned int k = 0; k < 3; k++) {
+      state[k] += impulse_solver_get(group, base + IMPULSE_ROW_DIRECTION + k, lane) * linear;
+      state[3 + k] += sign * impulse * impulse_solver_get(group, base + IMPULSE_ROW_INVERSE_ANGULAR + b * 3 + k, lane);
+    }
+  }
+}
+
+// The bias is whatever the contact velocity holds beyond what the movable bodies contribute
+// through the lane's rows (immovable bodies and the acceleration Millington folds in)
+static void impulse_solver_set_bias(float* group, unsigned int lane, struct Contact* contact, float duration) {
+  vec3 velocity = contact_calculate_local_velocity(contact, 0, duration);
+  if (contact->body[1])
+    velocity = vec3_sub(velocity, contact_calculate_local_velocity(contact, 1, duration));
+
+  for (unsigned int row = 0; row < 3; row++) {
+    unsigned int base = row * IMPULSE_ROW_FLOATS;
+    float bias = velocity.data[row];
+    for (unsigned int b = 0; b < 2; b++) {
+      struct RigidBody* body = contact->body[b];
+      if (!impulse_solver_is_movable(body))
+        continue;
+      float sign = b ? -1.0f : 1.0f;
+      float linear = 0.0f;
+      float angular = 0.0f;
+      for (unsigned int k = 0; k < 3; k++) {
+        linear += impulse_solver_get(group, base + IMPULSE_ROW_DIRECTION + k, lane) * body->velocity.data[k];
+        angular += impulse_solver_get(group, base + IMPULSE_ROW_ANGULAR + b * 3 + k, lane) * body->rotation.data[k];
+      }
+      bias -= sign * (linear + angular);
+    }
+    impulse_solver_set(group, IMPULSE_BIAS + row, lane, bias);
+  }
+
+  // Restitution is already folded into the desired change
+  impulse_solver_set(group, IMPULSE_TARGET, lane, contact->contact_velocity.data[0] + contact->desired_delta_velocity);
+}
+
+// Fills one lane from a contact
+static void impulse_solver_pack(struct ImpulseSolver* impulse_solver, struct ImpulseCache* impulse_cache, unsigned int group_num, unsigned int lane, struct Contact* contact, unsigned int* body_index, float duration) {
+  float* group = impulse_solver_group(impulse_solver, group_num);
+  mat3 basis = contact->contact_to_world;
+  vec3 direction[3];
+  direction[0] = contact->contact_normal;
+  direction[1] = (vec3){.data[0] = basis.data[1], .data[1] = basis.data[4], .data[2] = basis.data[7]};
+  direction[2] = (vec3){.data[0] = basis.data[2], .data[1] = basis.data[5], .data[2] = basis.data[8]};
+
+  for (unsigned int row = 0; row < 3; row++) {
+    unsigned int base = row * IMPULSE_ROW_FLOATS;
+    for (unsigned int k = 0; k < 3; k++)
+      impulse_solver_set(group, base + IMPULSE_ROW_DIRECTION + k, lane, direction[row].data[k]);
+
+    for (unsigned int b = 0; b < 2; b++) {
+      struct RigidBody* body = contact->body[b];
+      vec3 angular = VEC3_ZERO;
+      vec3 inverse_angular = VEC3_ZERO;
+
+      if (impulse_solver_is_movable(body)) {
+        angular = vec3_cross_product(contact->relative_contact_position[b], direction[row]);
+        inverse_angular = mat3_transform(body->inverse_inertia_tensor_world, angular);
+      }
+      for (unsigned int k = 0; k < 3; k++) {
+        impulse_solver_set(group, base + IMPULSE_ROW_ANGULAR + b * 3 + k, lane, angular.data[k]);
+        impulse_solver_set(group, base + IMPULSE_ROW_INVERSE_ANGULAR + b * 3 + k, lane, inverse_angular.data[k]);
+      }
+    }
+    impulse_solver_set(group, base + IMPULSE_ROW_MASS, lane, impulse_solver_mass(contact, direction[row]));
+  }
+  impulse_solver_set_bias(group, lane, contact, duration);
+
+  for (unsigned int b = 0; b < 2; b++) {
+    impulse_solver_set(group, IMPULSE_INVERSE_MASS + b, lane, impulse_solver_is_movable(contact->body[b]) ? contact->body[b]->inverse_mass : 0.0f);
+    impulse_solver->lane_body[((size_t)group_num * SIMD_WIDTH + lane) * 2 + b] = body_index[b];
+  }
+  impulse_solver_set(group, IMPULSE_FRICTION, lane, contact->friction);
+
+  // NOTE: The cache is in world space, the tangent basis can flip between frames
+  vec3 impulse;
+  contact->accumulated_impulse = VEC3_ZERO;
+  if (impulse_cache && impulse_cache_find(impulse_cache, contact, &impulse)) {
+    impulse = mat3_transform_transpose(basis, impulse);
+    if (impulse.data[0] > 0.0f) {
+      float max_friction = contact->friction * impulse.data[0];
+      float planar_impulse = sqrtf(impulse.data[1] * impulse.data[1] + impulse.data[2] * impulse.data[2]);
+      if (planar_impulse > max_friction) {
+        impulse.data[1] *= max_friction / planar_impulse;
+        impulse.data[2] *= max_friction / planar_impulse;
+      }
+      contact->accumulated_impulse = impulse;
+    }
+  }
+  for (unsigned int row = 0; row < 3; row++) {
+    impulse_solver_set(group, IMPULSE_ACCUMULATED + row, lane, contact->accumulated_impulse.data[row]);
+    if (contact->accumulated_impulse.data[row] != 0.0f)
+      impulse_solver_apply_lane(impulse_solver, group_num, lane, row, contact->accumulated_impulse.data[row]);
+  }
+}
+
+static void impulse_solver_load_bodies(struct ImpulseSolver* impulse_solver, struct ContactGraph* contact_graph) {
+  for (unsigned int body_num = 0; body_num < contact_graph->body_count; body_num++) {
+    struct RigidBody* body = contact_graph->bodies[body_num];
+    float* state = impulse_solver->body_state + (size_t)body_num * IMPULSE_SOLVER_BODY_FLOATS;
+    for (unsigned int k = 0; k < 3; k++) {
+      state[k] = body->velocity.data[k];
+      state[3 + k] = body->rotation.data[k];
+    }
+  }
+  memset(impulse_solver->body_state + (size_t)impulse_solver->dummy_body * IMPULSE_SOLVER_BODY_FLOATS, 0, sizeof(float) * IMPULSE_SOLVER_BODY_FLOATS);
+}
+
+// Expects the contact internals to be calculated and the graph to be colored for contacts.
+// A NULL cache starts every impulse from zero.
+void impulse_solver_prepare(struct ImpulseSolver* impulse_solver, struct ContactGraph* contact_graph, struct ImpulseCache* impulse_cache, struct Contact* contacts, unsigned int num_contacts, float duration) {
+  unsigned int overflow_first = contact_graph->color_start[contact_graph->color_count];
+  unsigned int group_count = num_contacts - overflow_first;
+  for (unsigned int color = 0; color < contact_graph->color_count; color++)
+    group_count += (contact_graph->color_start[color + 1] - contact_graph->color_start[color] + SIMD_WIDTH - 1) / SIMD_WIDTH;
+
+  impulse_solver_reserve(impulse_solver, group_count, contact_graph->body_count);
+  impulse_solver->group_count = group_count;
+  impulse_solver->color_count = contact_graph->color_count;
+
+  unsigned int dummy = contact_graph->body_count;
+  impulse_solver->dummy_body = dummy;
+  impulse_solver_load_bodies(impulse_solver, contact_graph);
+
+  // Padding lanes stay zeroed with both bodies on the dummy slot, so they solve to nothing
+  memset(impulse_solver->constraints, 0, sizeof(float) * IMPULSE_CONSTRAINT_FLOATS * SIMD_WIDTH * group_count);
+  for (unsigned int lane = 0; lane < group_count * SIMD_WIDTH; lane++) {
+    impulse_solver->lane_contact[lane] = IMPULSE_SOLVER_NO_CONTACT;
+    impulse_solver->lane_body[lane * 2] = dummy;
+    impulse_solver->lane_body[lane * 2 + 1] = dummy;
+  }
+
+  unsigned int group = 0;
+  for (unsigned int color = 0; color <= contact_graph->color_count; color++) {
+    bool overflow = (color == contact_graph->color_count);
+    unsigned int first = contact_graph->color_start[color];
+    unsigned int last = overflow ? num_contacts : contact_graph->color_start[color + 1];
+    unsigned int width = overflow ? 1 : SIMD_WIDTH;
+
+    impulse_solver->color_group_start[color] = group;
+    for (unsigned int order_num = first; order_num < last; order_num += width, group++) {
+      for (unsigned int lane = 0; lane < width && order_num + lane < last; lane++) {
+        unsigned int contact_index = contact_graph->order[order_num + lane];
+        unsigned int body_index[2];
+        for (unsigned int b = 0; b < 2; b++) {
+          body_index[b] = contact_graph->contact_body[contact_index * 2 + b];
+          if (body_index[b] == CONTACT_GRAPH_NO_BODY)
+            body_index[b] = dummy;
+        }
+
+        impulse_solver->lane_contact[group * SIMD_WIDTH + lane] = contact_index;
+        impulse_solver_pack(impulse_solver, impulse_cache, group, lane, &contacts[contact_index], body_index, duration);
+      }
+    }
+  }
+  impulse_solver->color_group_start[contact_graph->color_count + 1] = group;
+}
+
+// Starts another solve of what was prepared, for the same contacts and graph a substep later.
+// The directions, angular terms and masses are kept, the body velocities are loaded again and
+// the bias and target follow the refreshed contact internals. The impulses the last solve
+// ended with warm start this one, since the bodies lost them again to the forces since.
+void impulse_solver_refresh(struct ImpulseSolver* impulse_solver, struct ContactGraph* contact_graph, struct Contact* contacts, bool warm_start, float duration) {
+  impulse_solver_load_bodies(impulse_solver, contact_graph);
+
+  for (unsigned int group_num = 0; group_num < impulse_solver->group_count; group_num++) {
+    float* group = impulse_solver_group(impulse_solver, group_num);
+    for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++) {
+      unsigned int contact_index = impulse_solver->lane_contact[group_num * SIMD_WIDTH + lane];
+      if (contact_index == IMPULSE_SOLVER_NO_CONTACT)
+        continue;
+
+      impulse_solver_set_bias(group, lane, &contacts[contact_index], duration);
+      for (unsigned int row = 0; row < 3; row++) {
+        float impulse = warm_start ? impulse_solver_get(group, IMPULSE_ACCUMULATED + row, lane) : 0.0f;
+        impulse_solver_set(group, IMPULSE_ACCUMULATED + row, lane, impulse);
+        if (impulse != 0.0f)
+          impulse_solver_apply_lane(impulse_solver, group_num, lane, row, impulse);
+      }
+    }
+  }
+}
+
+static inline simd_float impulse_solver_load(float* group, unsigned int field) {
+  return simd_load(group + field * SIMD_WIDTH);
+}
+
+static inline simd_float impulse_solver_dot(float* group, unsigned int field, simd_float v[3]) {
+  return simd_add(simd_add(simd_mul(impulse_solver_load(group, field), v[0]), simd_mul(impulse_solver_load(group, field + 1), v[1])), simd_mul(impulse_solver_load(group, field + 2), v[2]));
+}
+
+// Velocity along a row at the contact, body 0 relative to body 1
+static inline simd_float impulse_solver_row_velocity(float* group, unsigned int row, simd_float velocity[2][3], simd_float rotation[2][3]) {
+  unsigned int base = row * IMPULSE_ROW_FLOATS;
+  simd_float one = simd_add(impulse_solver_dot(group, base + IMPULSE_ROW_DIRECTION, velocity[0]), impulse_solver_dot(group, base + IMPULSE_ROW_ANGULAR, rotation[0]));
+  simd_float two = simd_add(impulse_solver_dot(group, base + IMPULSE_ROW_DIRECTION, velocity[1]), impulse_solver_dot(group, base + IMPULSE_ROW_ANGULAR + 3, rotation[1]));
+  return simd_add(simd_sub(one, two), impulse_solver_load(group, IMPULSE_BIAS + row));
+}
+
+static inline void impulse_solver_row_apply(float* group, unsigned int row, simd_float impulse, simd_float inverse_mass[2], simd_float velocity[2][3], simd_float rotation[2][3]) {
+  unsigned int base = row * IMPULSE_ROW_FLOATS;
+  simd_float linear[2] = {simd_mul(impulse, inverse_mass[0]), simd_mul(impulse, inverse_mass[1])};
+
+  for (unsigned int k = 0; k < 3; k++) {
+    simd_float direction = impulse_solver_load(group, base + IMPULSE_ROW_DIRECTION + k);
+    velocity[0][k] = simd_add(velocity[0][k], simd_mul(direction, linear[0]));
+    velocity[1][k] = simd_sub(velocity[1][k], simd_mul(direction, linear[1]));
+    rotation[0][k] = simd_add(rotation[0][k], simd_mul(impulse_solver_load(group, base + IMPULSE_ROW_INVERSE_ANGULAR + k), impulse));
+    rotation[1][k] = simd_sub(rotation[1][k], simd_mul(impulse_solver_load(group, base + IMPULSE_ROW_INVERSE_ANGULAR + 3 + k), impulse));
+  }
+}
+
+// One pass over a range of groups. Friction goes first so it is bounded by the normal
+// impulse of the previous pass.
+void impulse_solver_solve_groups(struct ImpulseSolver* impulse_solver, unsigned int first_group, unsigned int last_group) {
+  for (unsigned int group_num = first_group; group_num < last_group; group_num++) {
+    float* group = impulse_solver_group(impulse_solver, group_num);
+    unsigned int* lane_body = impulse_solver->lane_body + (size_t)group_num * SIMD_WIDTH * 2;
+
+    float gathered[2][IMPULSE_SOLVER_BODY_FLOATS][SIMD_WIDTH];
+    for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++)
+      for (unsigned int b = 0; b < 2; b++) {
+        float* state = impulse_solver->body_state + (size_t)lane_body[lane * 2 + b] * IMPULSE_SOLVER_BODY_FLOATS;
+        for (unsigned int k = 0; k < IMPULSE_SOLVER_BODY_FLOATS; k++)
+          gathered[b][k][lane] = state[k];
+      }
+
+    simd_float velocity[2][3], rotation[2][3];
+    for (unsigned int b = 0; b < 2; b++)
+      for (unsigned int k = 0; k < 3; k++) {
+        velocity[b][k] = simd_load(gathered[b][k]);
+        rotation[b][k] = simd_load(gathered[b][3 + k]);
+      }
+    simd_float inverse_mass[2] = {impulse_solver_load(group, IMPULSE_INVERSE_MASS), impulse_solver_load(group, IMPULSE_INVERSE_MASS + 1)};
+    simd_float accumulated[3];
+    for (unsigned int row = 0; row < 3; row++)
+      accumulated[row] = impulse_solver_load(group, IMPULSE_ACCUMULATED + row);
+
+    simd_float tangent[2];
+    for (unsigned int t = 0; t < 2; t++) {
+      simd_float row_velocity = impulse_solver_row_velocity(group, t + 1, velocity, rotation);
+      tangent[t] = simd_sub(accumulated[t + 1], simd_mul(row_velocity, impulse_solver_load(group, (t + 1) * IMPULSE_ROW_FLOATS + IMPULSE_ROW_MASS)));
+    }
+
+    simd_float max_friction = simd_mul(impulse_solver_load(group, IMPULSE_FRICTION), accumulated[0]);
+    simd_float planar_impulse = simd_sqrt(simd_add(simd_mul(tangent[0], tangent[0]), simd_mul(tangent[1], tangent[1])));
+    simd_float scale = simd_min(simd_set(1.0f), simd_div(max_friction, simd_max(planar_impulse, simd_set(FLT_MIN))));
+    for (unsigned int t = 0; t < 2; t++) {
+      tangent[t] = simd_mul(tangent[t], scale);
+      impulse_solver_row_apply(group, t + 1, simd_sub(tangent[t], accumulated[t + 1]), inverse_mass, velocity, rotation);
+      accumulated[t + 1] = tangent[t];
+    }
+
+    simd_float row_velocity = impulse_solver_row_velocity(group, 0, velocity, rotation);
+    simd_float normal = simd_add(accumulated[0], simd_mul(simd_sub(impulse_solver_load(group, IMPULSE_TARGET), row_velocity), impulse_solver_load(group, IMPULSE_ROW_MASS)));
+    normal = simd_max(normal, simd_zero());
+    impulse_solver_row_apply(group, 0, simd_sub(normal, accumulated[0]), inverse_mass, velocity, rotation);
+    accumulated[0] = normal;
+
+    for (unsigned int row = 0; row < 3; row++)
+      simd_store(group + (IMPULSE_ACCUMULATED + row) * SIMD_WIDTH, accumulated[row]);
+
+    for (unsigned int b = 0; b < 2; b++)
+      for (unsigned int k = 0; k < 3; k++) {
+        simd_store(gathered[b][k], velocity[b][k]);
+        simd_store(gathered[b][3 + k], rotation[b][k]);
+      }
+
+    // NOTE: The dummy slot is shared by every lane without a movable body, it is never written
+    unsigned int dummy = impulse_solver->dummy_body;
+    for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++)
+      for (unsigned int b = 0; b < 2; b++) {
+        if (lane_body[lane * 2 + b] == dummy)
+          continue;
+        float* state = impulse_solver->body_state + (size_t)lane_body[lane * 2 + b] * IMPULSE_SOLVER_BODY_FLOATS;
+        for (unsigned int k = 0; k < IMPULSE_SOLVER_BODY_FLOATS; k++)
+          state[k] = gathered[b][k][lane];
+      }
+  }
+}
+
+struct ImpulseSolverColor {
+  struct ImpulseSolver* impulse_solver;
+  unsigned int first_group;
+};
+
+static void impulse_solver_solve_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct ImpulseSolverColor* color = data;
+  impulse_solver_solve_groups(color->impulse_solver, color->first_group + begin, color->first_group + end);
+}
+
+// One pass over every group
+void impulse_solver_iterate(struct ImpulseSolver* impulse_solver, struct JobScheduler* scheduler) {
+  for (unsigned int color_num = 0; color_num < impulse_solver->color_count; color_num++) {
+    struct ImpulseSolverColor color = {.impulse_solver = impulse_solver, .first_group = impulse_solver->color_group_start[color_num]};
+    job_scheduler_parallel_for(scheduler, impulse_solver->color_group_start[color_num + 1] - color.first_group, IMPULSE_SOLVER_GRAIN, impulse_solver_solve_range, &color);
+  }
+  // Overflow groups share bodies, they run in order on the calling thread
+  impulse_solver_solve_groups(impulse_solver, impulse_solver->color_group_start[impulse_solver->color_count], impulse_solver->group_count);
+}
+
+// Writes the velocities and impulses back, the caller decides when the impulses go into the cache
+void impulse_solver_finish(struct ImpulseSolver* impulse_solver, struct ContactGraph* contact_graph, struct Contact* contacts) {
+  for (unsigned int body_num = 0; body_num < contact_graph->body_count; body_num++) {
+    struct RigidBody* body = contact_graph->bodies[body_num];
+    float* state = impulse_solver->body_state + (size_t)body_num * IMPULSE_SOLVER_BODY_FLOATS;
+    body->velocity = (vec3){.data[0] = state[0], .data[1] = state[1], .data[2] = state[2]};
+    body->rotation = (vec3){.data[0] = state[3], .data[1] = state[4], .data[2] = state[5]};
+  }
+
+  for (unsigned int group_num = 0; group_num < impulse_solver->group_count; group_num++) {
+    float* group = impulse_solver_group(impulse_solver, group_num);
+    for (unsigned int lane = 0; lane < SIMD_WIDTH; lane++) {
+      unsigned int contact_index = impulse_solver->lane_contact[group_num * SIMD_WIDTH + lane];
+      if (contact_index == IMPULSE_SOLVER_NO_CONTACT)
+        continue;
+      for (unsigned int row = 0; row < 3; row++)
+        contacts[contact_index].accumulated_impulse.data[row] = impulse_solver_get(group, IMPULSE_ACCUMULATED + row, lane);
+    }
+  }
+}
@@ -0,0 +1,99 @@
+#include "chaos/core/island.h"
+
+#include "chaos/core/contacts.h"
+
+static inline bool island_builder_is_member(struct BodyPool* body_pool, struct RigidBody* body) {
+  return body && body->island_index < body_pool->size && body_pool->bodies[body->island_index] == body;
+}
+
+void island_builder_init(struct IslandBuilder* island_builder) {
+  island_builder->capacity = 0;
+  island_builder->parent = NULL;
+  island_builder->restless = NULL;
+}
+
+void island_builder_delete(struct IslandBuilder* island_builder) {
+  free(island_builder->parent);
+  free(island_builder->restless);
+}
+
+unsigned int island_builder_find(struct IslandBuilder* island_builder, unsigned int index) {
+  unsigned int* parent = island_builder->parent;
+  while (parent[index] != index) {
+    parent[index] = parent[parent[index]];
+    index = parent[index];
+  }
+  return index;
+}
+
+void island_builder_union(struct IslandBuilder* island_builder, unsigned int a, unsigned int b) {
+  a = island_builder_find(island_builder, a);
+  b = island_builder_find(island_builder, b);
+
+  // NOTE: Lower index wins so island roots do not depend on contact order
+  if (a < b)
+    island_builder->parent[b] = a;
+  else if (b < a)
+    island_builder->parent[a] = b;
+}
+
+// Makes indices 0 to count - 1 singleton sets
+void island_builder_reset(struct IslandBuilder* island_builder, unsigned int count) {
+  if (island_builder->capacity < count) {
+    free(island_builder->parent);
+    free(island_builder->restless);
+    island_builder->capacity = count;
+    island_builder->parent = malloc(sizeof(unsigned int) * island_builder->capacity);
+    island_builder->restless = malloc(sizeof(bool) * island_builder->capacity);
+  }
+
+  for (unsigned int index = 0; index < count; index++)
+    island_builder->parent[index] = index;
+}
+
+// Immovable bodies are left out of the merge, otherwise the ground would join every island
+void island_builder_link(struct IslandBuilder* island_builder, struct BodyPool* body_pool, struct RigidBody* one, struct RigidBody* two) {
+  if (island_builder_is_member(body_pool, one) && island_builder_is_member(body_pool, two) && one->inverse_mass != 0.0f && two->inverse_mass != 0.0f)
+    island_builder_union(island_builder, one->island_index, two->island_index);
+}
+
+void island_builder_build(struct IslandBuilder* island_builder, struct BodyPool* body_pool, struct Contact* contacts, unsigned int num_contacts) {
+  island_builder_reset(island_builder, body_pool->capacity);
+  for (unsigned int body_num = 0; body_num < body_pool->size; body_num++)
+    body_pool->bodies[body_num]->island_index = body_num;
+
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+    island_builder_link(island_builder, body_pool, contacts[contact_num].body[0], contacts[contact_num].body[1]);
+}
+
+// An island sleeps only when every member is at rest, otherwise every member is woken
+void island_builder_update_sleep(struct IslandBuilder* island_builder, struct BodyPool* body_pool) {
+  for (unsigned int body_num = 0; body_num < body_pool->size; body_num++)
+    island_builder->restless[body_num] = false;
+
+  for (unsigned int body_num = 0; body_num < body_pool->size; body_num++) {
+    struct RigidBody* body = body_pool->bodies[body_num];
+    if (body->is_awake && (!body->can_sleep || body->motion >= SLEEP_EPSILON))
+      island_builder->restless[island_builder_find(island_builder, body_num)] = true;
+  }
+
+  for (unsigned int body_num = 0; body_num < body_pool->size; body_num++) {
+    struct RigidBody* body = body_pool->bodies[body_num];
+    bool restless = island_builder->restless[island_builder_find(island_builder, body_num)];
+
+    if (restless && !body->is_awake)
+      rigid_body_set_awake(body, true);
+    else if (!restless && body->is_awake)
+      rigid_body_set_awake(body, false);
+  }
+}
+
+unsigned int island_builder_remove_sleeping_contacts(struct IslandBuilder* island_builder, struct Contact* contacts, unsigned int num_contacts) {
+  unsigned int used = 0;
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    struct Contact* contact = &contacts[contact_num];
+    if (!contact_pair_is_sleeping(contact->body[0], contact->body[1]))
+      contacts[used++] = *contact;
+  }
+  return used;
+}
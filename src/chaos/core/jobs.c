@@ -0,0 +1,326 @@
+#include "chaos/core/jobs.h"
+
+static THREAD_LOCAL struct JobSystem* job_current_system = NULL;
+static THREAD_LOCAL unsigned int job_current_index = 0;
+
+void job_scheduler_parallel_for(struct JobScheduler* scheduler, unsigned int count, unsigned int grain, job_range_function function, void* data) {
+  if (count == 0)
+    return;
+
+  if (scheduler)
+    scheduler->parallel_for(scheduler->context, count, grain, function, data);
+  else
+    function(data, 0, count, 0);
+}
+
+unsigned int job_scheduler_thread_count(struct JobScheduler* scheduler) {
+  return scheduler ? scheduler->thread_count : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static inline unsigned int job_system_thread_index(struct JobSystem* job_system) {
+  return (job_current_system == job_system) ? job_current_index : 0;
+}
+
+static inline void job_run(struct Job* job, unsigned int thread_index) {
+  job->function(job->data, job->begin, job->end, thread_index);
+  atomic_fetch_sub_explicit(job->remaining, 1, memory_order_release);
+}
+
+static inline bool job_queue_push(struct JobQueue* job_queue, struct Job* job) {
+  thread_mutex_lock(&job_queue->lock);
+  bool pushed = job_queue->tail - job_queue->head < JOB_QUEUE_CAPACITY;
+  if (pushed)
+    job_queue->jobs[job_queue->tail++ % JOB_QUEUE_CAPACITY] = *job;
+  thread_mutex_unlock(&job_queue->lock);
+
+  return pushed;
+}
+
+static inline bool job_queue_pop(struct JobQueue* job_queue, struct Job* job) {
+  thread_mutex_lock(&job_queue->lock);
+  bool popped = job_queue->tail != job_queue->head;
+  if (popped)
+    *job = job_queue->jobs[--job_queue->tail % JOB_QUEUE_CAPACITY];
+  thread_mutex_unlock(&job_queue->lock);
+
+  return popped;
+}
+
+static inline bool job_queue_steal(struct JobQueue* job_queue, struct Job* job) {
+  thread_mutex_lock(&job_queue->lock);
+  bool stolen = job_queue->tail != job_queue->head;
+  if (stolen)
+    *job = job_queue->jobs[job_queue->head++ % JOB_QUEUE_CAPACITY];
+  thread_mutex_unlock(&job_queue->lock);
+
+  return stolen;
+}
+
+static bool job_system_take(struct JobSystem* job_system, unsigned int thread_index, struct Job* job) {
+  if (atomic_load_explicit(&job_system->queued, memory_order_acquire) == 0)
+    return false;
+
+  bool taken = job_queue_pop(&job_system->queues[thread_index], job);
+  for (unsigned int offset = 1; !taken && offset < job_system->thread_count; offset++)
+    taken = job_queue_steal(&job_system->queues[(thread_index + offset) % job_system->thread_count], job);
+
+  if (taken)
+    atomic_fetch_sub_explicit(&job_system->queued, 1, memory_order_acq_rel);
+
+  return taken;
+}
+
+struct JobWorkerStart {
+  struct JobSystem* job_system;
+  unsigned int thread_index;
+};
+
+static thread_result THREAD_CALL job_system_worker(void* arg) {
+  struct JobWorkerStart start = *(struct JobWorkerStart*)arg;
+  free(arg);
+
+  struct JobSystem* job_system = start.job_system;
+  job_current_system = job_system;
+  job_current_index = start.thread_index;
+
+  struct Job job;
+  while (!atomic_load_explicit(&job_system->quit, memory_order_acquire)) {
+    if (job_system_take(job_system, start.thread_index, &job)) {
+      job_run(&job, start.thread_index);
+      continue;
+    }
+
+    thread_mutex_lock(&job_system->sleep_lock);
+    while (atomic_load(&job_system->queued) == 0 && !atomic_load(&job_system->quit))
+      thread_cond_wait(&job_system->wake, &job_system->sleep_lock);
+    thread_mutex_unlock(&job_system->sleep_lock);
+  }
+
+  return 0;
+}
+
+static void job_system_scheduler_parallel_for(void* context, unsigned int count, unsigned int grain, job_range_function function, void* data) {
+  job_system_parallel_for((struct JobSystem*)context, count, grain, function, data);
+}
+
+// Stops the workers below started and frees everything init made
+static void job_system_stop(struct JobSystem* job_system, unsigned int started) {
+  thread_mutex_lock(&job_system->sleep_lock);
+  atomic_store(&job_system->quit, true);
+  thread_cond_broadcast(&job_system->wake);
+  thread_mutex_unlock(&job_system->sleep_lock);
+
+  for (unsigned int thread_num = 1; thread_num < started; thread_num++)
+    thread_join(job_system->threads[thread_num]);
+
+  for (unsigned int thread_num = 0; thread_num < job_system->thread_count; thread_num++)
+    thread_mutex_destroy(&job_system->queues[thread_num].lock);
+
+  thread_mutex_destroy(&job_system->sleep_lock);
+  thread_cond_destroy(&job_system->wake);
+  free(job_system->queues);
+  free(job_system->threads);
+}
+
+// NOTE: If a worker fails to start, the ones already running are stopped and everything is freed
+// before returning false, so a failed init must not be followed by job_system_delete
+bool job_system_init(struct JobSystem* job_system, unsigned int thread_count) {
+  if (thread_count == 0)
+    thread_count = 1;
+
+  job_system->thread_count = thread_count;
+  job_system->threads = calloc(thread_count, sizeof(thread_handle));
+  job_system->queues = calloc(thread_count, sizeof(struct JobQueue));
+  atomic_init(&job_system->queued, 0);
+  atomic_init(&job_system->quit, false);
+  thread_mutex_init(&job_system->sleep_lock);
+  thread_cond_init(&job_system->wake);
+
+  job_system->scheduler = (struct JobScheduler){.context = job_system, .thread_count = thread_count, .parallel_for = job_system_scheduler_parallel_for};
+
+  for (unsigned int thread_num = 0; thread_num < thread_count; thread_num++)
+    thread_mutex_init(&job_system->queues[thread_num].lock);
+
+  for (unsigned int thread_num = 1; thread_num < thread_count; thread_num++) {
+    struct JobWorkerStart* start = malloc(sizeof(struct JobWorkerStart));
+    *start = (struct JobWorkerStart){.job_system = job_system, .thread_index = thread_num};
+
+    if (!thread_create(&job_system->threads[thread_num], job_system_worker, start)) {
+      free(start);
+      job_system_stop(job_system, thread_num);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void job_system_delete(struct JobSystem* job_system) {
+  job_system_stop(job_system, job_system->thread_count);
+}
+
+struct JobScheduler* job_system_get_scheduler(struct JobSystem* job_system) {
+  return &job_system->scheduler;
+}
+
+// NOTE: The calling thread keeps running queued jobs (its own first, then stolen ones) until
+// every chunk of this loop is done, so nested parallel loops cannot deadlock
+void job_system_parallel_for(struct JobSystem* job_system, unsigned int count, unsigned int grain, job_range_function function, void* data) {
+  if (count == 0)
+    return;
+  if (grain == 0)
+    grain = 1;
+
+  unsigned int thread_index = job_system_thread_index(job_system);
+  unsigned int chunks = (count + grain - 1) / grain;
+
+  if (job_system->thread_count == 1 || chunks == 1) {
+    function(data, 0, count, thread_index);
+    return;
+  }
+
+  atomic_uint remaining;
+  atomic_init(&remaining, chunks);
+
+  struct Job first = {.function = function, .data = data, .begin = 0, .end = grain, .remaining = &remaining};
+  for (unsigned int chunk = 1; chunk < chunks; chunk++) {
+    struct Job job = {.function = function, .data = data, .begin = chunk * grain, .end = (chunk + 1) * grain, .remaining = &remaining};
+    if (job.end > count)
+      job.end = count;
+
+    // Queue full, run it here rather than drop it
+    if (!job_queue_push(&job_system->queues[thread_index], &job)) {
+      job_run(&job, thread_index);
+      continue;
+    }
+    atomic_fetch_add_explicit(&job_system->queued, 1, memory_order_release);
+  }
+
+  thread_mutex_lock(&job_system->sleep_lock);
+  thread_cond_broadcast(&job_system->wake);
+  thread_mutex_unlock(&job_system->sleep_lock);
+
+  job_run(&first, thread_index);
+
+  struct Job job;
+  while (atomic_load_explicit(&remaining, memory_order_acquire) > 0) {
+    if (job_system_take(job_system, thread_index, &job))
+      job_run(&job, thread_index);
+    else
+      thread_yield();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+void task_graph_init(struct TaskGraph* task_graph) {
+  task_graph->task_count = 0;
+  task_graph->task_capacity = TASK_GRAPH_INIT_CAPACITY;
+  task_graph->tasks = malloc(sizeof(struct Task) * TASK_GRAPH_INIT_CAPACITY);
+  task_graph->dependency_count = 0;
+  task_graph->dependency_capacity = TASK_GRAPH_INIT_CAPACITY;
+  task_graph->dependencies = malloc(sizeof(struct TaskDependency) * TASK_GRAPH_INIT_CAPACITY);
+  task_graph->order = malloc(sizeof(unsigned int) * TASK_GRAPH_INIT_CAPACITY);
+}
+
+void task_graph_delete(struct TaskGraph* task_graph) {
+  free(task_graph->tasks);
+  free(task_graph->dependencies);
+  free(task_graph->order);
+}
+
+void task_graph_clear(struct TaskGraph* task_graph) {
+  task_graph->task_count = 0;
+  task_graph->dependency_count = 0;
+}
+
+unsigned int task_graph_add_task(struct TaskGraph* task_graph, void (*function)(void* data, unsigned int thread_index), void* data) {
+  if (task_graph->task_count == task_graph->task_capacity) {
+    task_graph->task_capacity *= 2;
+    task_graph->tasks = realloc(task_graph->tasks, sizeof(struct Task) * task_graph->task_capacity);
+    task_graph->order = realloc(task_graph->order, sizeof(unsigned int) * task_graph->task_capacity);
+  }
+
+  task_graph->tasks[task_graph->task_count] = (struct Task){.function = function, .data = data, .level = 0, .dependencies = 0};
+  return task_graph->task_count++;
+}
+
+void task_graph_add_dependency(struct TaskGraph* task_graph, unsigned int before, unsigned int after) {
+  if (task_graph->dependency_count == task_graph->dependency_capacity) {
+    task_graph->dependency_capacity *= 2;
+    task_graph->dependencies = realloc(task_graph->dependencies, sizeof(struct TaskDependency) * task_graph->dependency_capacity);
+  }
+
+  task_graph->dependencies[task_graph->dependency_count++] = (struct TaskDependency){.before = before, .after = after};
+}
+
+struct TaskGraphLevel {
+  struct TaskGraph* task_graph;
+  unsigned int first;
+};
+
+static void task_graph_run_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct TaskGraphLevel* level = data;
+  for (unsigned int task_num = begin; task_num < end; task_num++) {
+    struct Task* task = &level->task_graph->tasks[level->task_graph->order[level->first + task_num]];
+    task->function(task->data, thread_index);
+  }
+}
+
+// Returns false without running anything if the dependencies contain a cycle
+bool task_graph_run(struct TaskGraph* task_graph, struct JobScheduler* scheduler) {
+  struct Task* tasks = task_graph->tasks;
+  unsigned int* order = task_graph->order;
+
+  for (unsigned int task_num = 0; task_num < task_graph->task_count; task_num++) {
+    tasks[task_num].level = 0;
+    tasks[task_num].dependencies = 0;
+  }
+  for (unsigned int dep_num = 0; dep_num < task_graph->dependency_count; dep_num++)
+    tasks[task_graph->dependencies[dep_num].after].dependencies++;
+
+  // Kahn's algorithm, a task's level is the length of the longest chain leading to it
+  unsigned int ready = 0;
+  for (unsigned int task_num = 0; task_num < task_graph->task_count; task_num++)
+    if (tasks[task_num].dependencies == 0)
+      order[ready++] = task_num;
+
+  for (unsigned int visited = 0; visited < ready; visited++) {
+    unsigned int before = order[visited];
+    for (unsigned int dep_num = 0; dep_num < task_graph->dependency_count; dep_num++) {
+      if (task_graph->dependencies[dep_num].before != before)
+        continue;
+
+      struct Task* after = &tasks[task_graph->dependencies[dep_num].after];
+      if (after->level < tasks[before].level + 1)
+        after->level = tasks[before].level + 1;
+      if (--after->dependencies == 0)
+        order[ready++] = task_graph->dependencies[dep_num].after;
+    }
+  }
+
+  if (ready != task_graph->task_count)
+    return false;
+
+  // Stable counting sort by level keeps insertion order inside each level
+  unsigned int levels = 0;
+  for (unsigned int task_num = 0; task_num < task_graph->task_count; task_num++)
+    if (tasks[task_num].level + 1 > levels)
+      levels = tasks[task_num].level + 1;
+
+  unsigned int first = 0;
+  for (unsigned int level = 0; level < levels; level++) {
+    unsigned int count = 0;
+    for (unsigned int task_num = 0; task_num < task_graph->task_count; task_num++)
+      if (tasks[task_num].level == level)
+        order[first + count++] = task_num;
+
+    struct TaskGraphLevel run_level = {.task_graph = task_graph, .first = first};
+    job_scheduler_parallel_for(scheduler, count, 1, task_graph_run_range, &run_level);
+    first += count;
+  }
+
+  return true;
+}
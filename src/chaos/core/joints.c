@@ -1,6 +1,13 @@
 #include "chaos/core/joints.h"
 
 unsigned int joint_add_contact(struct Joint* joint, struct Contact* contact, unsigned int limit) {
+  if (limit == 0)
+    return 0;
+
+  // Two sleeping bodies cannot pull the joint apart
+  if (contact_pair_is_sleeping(joint->body[0], joint->body[1]))
+    return 0;
+
   vec3 a_pos_world = rigid_body_get_point_in_world_space(joint->body[0], joint->position[0]);
   vec3 b_pos_world = rigid_body_get_point_in_world_space(joint->body[1], joint->position[1]);
 
@@ -17,6 +24,7 @@ unsigned int joint_add_contact(struct Joint* joint, struct Contact* contact, uns
     contact->penetration = length - joint->error;
     contact->friction = 1.0f;
     contact->restitution = 0;
+    contact->feature = JOINT_CONTACT_FEATURE;
 
     return 1;
   }
@@ -33,3 +41,29 @@ void joint_set(struct Joint* joint, struct RigidBody* a, vec3 a_pos, struct Rigi
 
   joint->error = error;
 }
+
+void joint_group_init(struct JointGroup* joint_group, struct Joint* joints, unsigned int joint_count) {
+  joint_group->joints = joints;
+  joint_group->joint_count = joint_count;
+}
+
+// NOTE: Joints past the limit are still checked so needed is exact, they are cheap to test
+unsigned int joint_group_add_contacts(void* context, struct Contact* contacts, unsigned int limit, unsigned int* needed) {
+  struct JointGroup* joint_group = context;
+  struct Contact overflow;
+  unsigned int used = 0;
+  unsigned int wanted = 0;
+
+  for (unsigned int joint_num = 0; joint_num < joint_group->joint_count; joint_num++) {
+    struct Contact* contact = (used < limit) ? &contacts[used] : &overflow;
+    unsigned int added = joint_add_contact(&joint_group->joints[joint_num], contact, 1);
+    if (added)
+      contact->feature = JOINT_CONTACT_FEATURE + joint_num;
+    wanted += added;
+    if (contact != &overflow)
+      used += added;
+  }
+
+  *needed = wanted;
+  return used;
+}
@@ -0,0 +1,495 @@
+#include "chaos/core/jointsolver.h"
+
+static const vec3 joint_world_axes[3] = {{.data = {1.0f, 0.0f, 0.0f}}, {.data = {0.0f, 1.0f, 0.0f}}, {.data = {0.0f, 0.0f, 1.0f}}};
+
+static inline vec3 joint_perpendicular(vec3 axis) {
+  vec3 other = (fabsf(axis.data[0]) < 0.57735f) ? joint_world_axes[0] : joint_world_axes[1];
+  return vec3_normalise(vec3_cross_product(axis, other));
+}
+
+static inline bool joint_is_movable(struct RigidBody* body) {
+  return body && body->inverse_mass != 0.0f;
+}
+
+// NOTE: Everything is taken at the bodies' current pose
+static void joint_constraint_set(struct JointConstraint* joint, enum JointType type, struct RigidBody* a, struct RigidBody* b, vec3 anchor, vec3 axis) {
+  joint->type = type;
+  joint->body[0] = a;
+  joint->body[1] = b;
+
+  axis = vec3_normalise(axis);
+  vec3 across = joint_perpendicular(axis);
+  for (unsigned int i = 0; i < 2; i++) {
+    struct RigidBody* body = joint->body[i];
+    if (body)
+      rigid_body_calculate_derived_data(body);
+
+    joint->position[i] = body ? rigid_body_get_point_in_local_space(body, anchor) : anchor;
+    joint->axis[i] = body ? rigid_body_get_direction_in_local_space(body, axis) : axis;
+    for (unsigned int j = 0; j < 3; j++)
+      joint->reference[i][j] = body ? rigid_body_get_direction_in_local_space(body, joint_world_axes[j]) : joint_world_axes[j];
+
+    // Hinge angles are measured from a direction across the axis
+    if (type == JOINT_HINGE)
+      joint->reference[i][0] = body ? rigid_body_get_direction_in_local_space(body, across) : across;
+  }
+
+  joint_constraint_clear_limits(joint);
+  for (unsigned int row = 0; row < JOINT_MAX_ROWS; row++)
+    joint->impulse[row] = 0.0f;
+}
+
+void joint_constraint_set_ball(struct JointConstraint* joint, struct RigidBody* a, struct RigidBody* b, vec3 anchor) {
+  joint_constraint_set(joint, JOINT_BALL, a, b, anchor, joint_world_axes[0]);
+}
+
+void joint_constraint_set_hinge(struct JointConstraint* joint, struct RigidBody* a, struct RigidBody* b, vec3 anchor, vec3 axis) {
+  joint_constraint_set(joint, JOINT_HINGE, a, b, anchor, axis);
+}
+
+void joint_constraint_set_fixed(struct JointConstraint* joint, struct RigidBody* a, struct RigidBody* b, vec3 anchor) {
+  joint_constraint_set(joint, JOINT_FIXED, a, b, anchor, joint_world_axes[0]);
+}
+
+void joint_constraint_set_slider(struct JointConstraint* joint, struct RigidBody* a, struct RigidBody* b, vec3 anchor, vec3 axis) {
+  joint_constraint_set(joint, JOINT_SLIDER, a, b, anchor, axis);
+}
+
+// NOTE: Only hinges and sliders have limits, radians for a hinge and distance for a slider
+void joint_constraint_set_limits(struct JointConstraint* joint, float lower_limit, float upper_limit) {
+  joint->limited = true;
+  joint->lower_limit = lower_limit;
+  joint->upper_limit = upper_limit;
+}
+
+void joint_constraint_clear_limits(struct JointConstraint* joint) {
+  joint->limited = false;
+  joint->lower_limit = 0.0f;
+  joint->upper_limit = 0.0f;
+  joint->limit_side = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static inline unsigned int joint_solver_hash(struct JointSolver* joint_solver, struct RigidBody* body) {
+  return (unsigned int)(((uintptr_t)body >> 4) * 2654435761u) & (joint_solver->table_capacity - 1);
+}
+
+void joint_solver_init(struct JointSolver* joint_solver) {
+  joint_solver->row_count = 0;
+  joint_solver->row_capacity = 0;
+  joint_solver->rows = NULL;
+  joint_solver->block_count = 0;
+  joint_solver->block_capacity = 0;
+  joint_solver->blocks = NULL;
+  joint_solver->body_count = 0;
+  joint_solver->body_capacity = 0;
+  joint_solver->bodies = NULL;
+  joint_solver->body_state = NULL;
+  joint_solver->table_capacity = 0;
+  joint_solver->table_body = NULL;
+  joint_solver->table_index = NULL;
+}
+
+void joint_solver_delete(struct JointSolver* joint_solver) {
+  free(joint_solver->rows);
+  free(joint_solver->blocks);
+  free(joint_solver->bodies);
+  free(joint_solver->body_state);
+  free(joint_solver->table_body);
+  free(joint_solver->table_index);
+}
+
+static void joint_solver_reserve(struct JointSolver* joint_solver, unsigned int num_joints) {
+  if (joint_solver->row_capacity < num_joints * JOINT_MAX_ROWS) {
+    free(joint_solver->rows);
+    joint_solver->row_capacity = num_joints * JOINT_MAX_ROWS;
+    joint_solver->rows = malloc(sizeof(struct JointRow) * joint_solver->row_capacity);
+  }
+
+  // NOTE: Enough for every row to end up in a block of its own
+  if (joint_solver->block_capacity < num_joints * JOINT_MAX_ROWS) {
+    free(joint_solver->blocks);
+    joint_solver->block_capacity = num_joints * JOINT_MAX_ROWS;
+    joint_solver->blocks = malloc(sizeof(struct JointBlock) * joint_solver->block_capacity);
+  }
+
+  // NOTE: One extra zeroed slot stands in for missing and immovable bodies
+  if (joint_solver->body_capacity < num_joints * 2 + 1) {
+    free(joint_solver->bodies);
+    free(joint_solver->body_state);
+    free(joint_solver->table_body);
+    free(joint_solver->table_index);
+    joint_solver->body_capacity = num_joints * 2 + 1;
+    joint_solver->table_capacity = 1;
+    while (joint_solver->table_capacity < joint_solver->body_capacity * 2)
+      joint_solver->table_capacity *= 2;
+    joint_solver->bodies = malloc(sizeof(struct RigidBody*) * joint_solver->body_capacity);
+    joint_solver->body_state = malloc(sizeof(float) * IMPULSE_SOLVER_BODY_FLOATS * joint_solver->body_capacity);
+    joint_solver->table_body = malloc(sizeof(struct RigidBody*) * joint_solver->table_capacity);
+    joint_solver->table_index = malloc(sizeof(unsigned int) * joint_solver->table_capacity);
+  }
+  memset(joint_solver->table_body, 0, sizeof(struct RigidBody*) * joint_solver->table_capacity);
+  joint_solver->body_count = 0;
+  joint_solver->row_count = 0;
+  joint_solver->block_count = 0;
+}
+
+static unsigned int joint_solver_insert_body(struct JointSolver* joint_solver, struct RigidBody* body) {
+  unsigned int slot = joint_solver_hash(joint_solver, body);
+  while (joint_solver->table_body[slot]) {
+    if (joint_solver->table_body[slot] == body)
+      return joint_solver->table_index[slot];
+    slot = (slot + 1) & (joint_solver->table_capacity - 1);
+  }
+
+  joint_solver->table_body[slot] = body;
+  joint_solver->table_index[slot] = joint_solver->body_count;
+  joint_solver->bodies[joint_solver->body_count] = body;
+  return joint_solver->body_count++;
+}
+
+static float* joint_solver_find_state(struct JointSolver* joint_solver, struct RigidBody* body, struct ContactGraph* contact_graph, float* shared_state) {
+  if (!joint_is_movable(body))
+    return joint_solver->body_state + (size_t)joint_solver->body_count * IMPULSE_SOLVER_BODY_FLOATS;
+
+  unsigned int body_index = contact_graph ? contact_graph_find_body(contact_graph, body) : CONTACT_GRAPH_NO_BODY;
+  if (body_index != CONTACT_GRAPH_NO_BODY)
+    return shared_state + (size_t)body_index * IMPULSE_SOLVER_BODY_FLOATS;
+  return joint_solver->body_state + (size_t)joint_solver_insert_body(joint_solver, body) * IMPULSE_SOLVER_BODY_FLOATS;
+}
+
+// Joints with both bodies asleep are left alone, a sleeping body next to an awake one is woken
+static bool joint_solver_is_active(struct JointConstraint* joint) {
+  struct RigidBody* one = joint->body[0];
+  struct RigidBody* two = joint->body[1];
+  if (!one)
+    return false;
+
+  bool one_awake = one->is_awake && joint_is_movable(one);
+  bool two_awake = two && two->is_awake && joint_is_movable(two);
+  if (!one_awake && !two_awake)
+    return false;
+
+  if (!one->is_awake)
+    rigid_body_set_awake(one, true);
+  if (two && !two->is_awake)
+    rigid_body_set_awake(two, true);
+  return true;
+}
+
+static inline float joint_row_velocity(struct JointRow* row) {
+  float velocity = 0.0f;
+  for (unsigned int b = 0; b < 2; b++)
+    for (unsigned int k = 0; k < 3; k++)
+      velocity += row->linear[b].data[k] * row->state[b][k] + row->angular[b].data[k] * row->state[b][3 + k];
+  return velocity;
+}
+
+static inline void joint_row_apply(struct JointRow* row, float impulse) {
+  for (unsigned int b = 0; b < 2; b++) {
+    float* state = row->state[b];
+    for (unsigned int k = 0; k < 3; k++) {
+      state[k] += row->linear[b].data[k] * row->inverse_mass[b] * impulse;
+      state[3 + k] += row->inverse_angular[b].data[k] * impulse;
+    }
+  }
+}
+
+// NOTE: A limit still short of its stop lets the bodies close the gap within the step
+static inline float joint_solver_bias(float error, float duration, bool limit) {
+  if (limit && error > 0.0f)
+    return error / duration;
+  return JOINT_BAUMGARTE * error / duration;
+}
+
+// World space view of a joint for this step
+struct JointFrame {
+  struct JointConstraint* joint;
+  float* state[2];
+  vec3 anchor[2];
+  vec3 offset[2];
+  vec3 axis[2];
+  vec3 reference[2][3];
+};
+
+static void joint_solver_add_row(struct JointSolver* joint_solver, struct JointFrame* frame, unsigned int row_num, vec3 linear[2], vec3 angular[2], float error, float duration, bool limit) {
+  struct JointRow* row = &joint_solver->rows[joint_solver->row_count++];
+  float inverse_effective_mass = 0.0f;
+
+  for (unsigned int b = 0; b < 2; b++) {
+    struct RigidBody* body = frame->joint->body[b];
+    row->state[b] = frame->state[b];
+    row->linear[b] = linear[b];
+    row->angular[b] = angular[b];
+    if (joint_is_movable(body)) {
+      row->inverse_mass[b] = body->inverse_mass;
+      row->inverse_angular[b] = mat3_transform(body->inverse_inertia_tensor_world, angular[b]);
+    } else {
+      row->inverse_mass[b] = 0.0f;
+      row->inverse_angular[b] = VEC3_ZERO;
+    }
+    inverse_effective_mass += row->inverse_mass[b] * vec3_dot(linear[b], linear[b]) + vec3_dot(angular[b], row->inverse_angular[b]);
+  }
+
+  row->mass = (inverse_effective_mass > 0.0f) ? 1.0f / inverse_effective_mass : 0.0f;
+  row->bias = joint_solver_bias(error, duration, limit);
+  row->lower = limit ? 0.0f : -FLT_MAX;
+  row->upper = FLT_MAX;
+  row->impulse = &frame->joint->impulse[row_num];
+
+  // NOTE: Part of the last step's impulse went into the bias, reapplying all of it can feed an
+  // oscillation when the passes run out before converging
+  *row->impulse *= JOINT_WARM_START;
+  if (*row->impulse != 0.0f)
+    joint_row_apply(row, *row->impulse);
+}
+
+// Effective mass matrix of the block factored in place as L L^T, false when a pivot shows the
+// rows are too close to dependent
+static bool joint_block_factor(struct JointBlock* block, struct JointRow* rows) {
+  unsigned int n = block->count;
+  float* l = block->factor;
+  for (unsigned int i = 0; i < n; i++)
+    for (unsigned int j = 0; j <= i; j++) {
+      struct JointRow* one = &rows[block->first + i];
+      struct JointRow* two = &rows[block->first + j];
+      float k = 0.0f;
+      for (unsigned int b = 0; b < 2; b++)
+        k += one->inverse_mass[b] * vec3_dot(one->linear[b], two->linear[b]) + vec3_dot(one->angular[b], two->inverse_angular[b]);
+      l[i * n + j] = k;
+    }
+
+  for (unsigned int j = 0; j < n; j++) {
+    float diagonal = l[j * n + j];
+    float d = diagonal;
+    for (unsigned int k = 0; k < j; k++)
+      d -= l[j * n + k] * l[j * n + k];
+    if (d <= diagonal * JOINT_PIVOT_EPSILON)
+      return false;
+
+    d = sqrtf(d);
+    l[j * n + j] = d;
+    for (unsigned int i = j + 1; i < n; i++) {
+      float s = l[i * n + j];
+      for (unsigned int k = 0; k < j; k++)
+        s -= l[i * n + k] * l[j * n + k];
+      l[i * n + j] = s / d;
+    }
+  }
+  return true;
+}
+
+// Closes the rows added since first into a block, rows that cannot be factored together fall
+// back to blocks of one
+static void joint_solver_add_block(struct JointSolver* joint_solver, unsigned int first, bool limit) {
+  struct JointBlock* block = &joint_solver->blocks[joint_solver->block_count];
+  block->first = first;
+  block->count = joint_solver->row_count - first;
+  block->limit = limit;
+  if (block->count == 0)
+    return;
+  if (limit || joint_block_factor(block, joint_solver->rows)) {
+    joint_solver->block_count++;
+    return;
+  }
+
+  for (unsigned int row_num = first; row_num < joint_solver->row_count; row_num++) {
+    block = &joint_solver->blocks[joint_solver->block_count];
+    block->first = row_num;
+    block->count = 1;
+    block->limit = false;
+    if (joint_block_factor(block, joint_solver->rows))
+      joint_solver->block_count++;
+  }
+}
+
+// Keeps the anchors from separating along direction. The second lever arm is from body two to
+// the first anchor, so a slider's directions turn with body two.
+static void joint_solver_add_linear_row(struct JointSolver* joint_solver, struct JointFrame* frame, unsigned int row_num, vec3 direction, vec3 offset, float error, float duration, bool limit) {
+  vec3 linear[2] = {direction, vec3_invert(direction)};
+  vec3 angular[2] = {vec3_cross_product(frame->offset[0], direction), vec3_invert(vec3_cross_product(offset, direction))};
+  joint_solver_add_row(joint_solver, frame, row_num, linear, angular, error, duration, limit);
+}
+
+static void joint_solver_add_angular_row(struct JointSolver* joint_solver, struct JointFrame* frame, unsigned int row_num, vec3 axis, float error, float duration, bool limit) {
+  vec3 linear[2] = {VEC3_ZERO, VEC3_ZERO};
+  vec3 angular[2] = {axis, vec3_invert(axis)};
+  joint_solver_add_row(joint_solver, frame, row_num, linear, angular, error, duration, limit);
+}
+
+// Small rotation taking the reference frame of body two onto that of body one
+static vec3 joint_frame_rotation_error(struct JointFrame* frame) {
+  vec3 error = VEC3_ZERO;
+  for (unsigned int j = 0; j < 3; j++)
+    error = vec3_add(error, vec3_cross_product(frame->reference[1][j], frame->reference[0][j]));
+  return vec3_scale(error, 0.5f);
+}
+
+static void joint_solver_add_rotation_rows(struct JointSolver* joint_solver, struct JointFrame* frame, unsigned int first_row, float duration) {
+  vec3 error = joint_frame_rotation_error(frame);
+  for (unsigned int j = 0; j < 3; j++)
+    joint_solver_add_angular_row(joint_solver, frame, first_row + j, joint_world_axes[j], error.data[j], duration, false);
+}
+
+// Only the limit nearer the current position gets a row, its warm start is dropped when the
+// side changes
+static void joint_solver_add_limit_row(struct JointSolver* joint_solver, struct JointFrame* frame, unsigned int row_num, float position, vec3 direction, float duration) {
+  struct JointConstraint* joint = frame->joint;
+  int side = (position - joint->lower_limit < joint->upper_limit - position) ? -1 : 1;
+  if (side != joint->limit_side) {
+    joint->impulse[row_num] = 0.0f;
+    joint->limit_side = side;
+  }
+
+  float error = (side < 0) ? position - joint->lower_limit : joint->upper_limit - position;
+  if (side > 0)
+    direction = vec3_invert(direction);
+
+  unsigned int first = joint_solver->row_count;
+  if (joint->type == JOINT_SLIDER)
+    joint_solver_add_linear_row(joint_solver, frame, row_num, direction, vec3_add(frame->offset[1], vec3_sub(frame->anchor[0], frame->anchor[1])), error, duration, true);
+  else
+    joint_solver_add_angular_row(joint_solver, frame, row_num, direction, error, duration, true);
+  joint_solver_add_block(joint_solver, first, true);
+}
+
+static void joint_solver_add_joint(struct JointSolver* joint_solver, struct JointFrame* frame, float duration) {
+  struct JointConstraint* joint = frame->joint;
+  vec3 separation = vec3_sub(frame->anchor[0], frame->anchor[1]);
+  unsigned int first = joint_solver->row_count;
+
+  if (joint->type != JOINT_SLIDER)
+    for (unsigned int j = 0; j < 3; j++)
+      joint_solver_add_linear_row(joint_solver, frame, j, joint_world_axes[j], frame->offset[1], vec3_dot(separation, joint_world_axes[j]), duration, false);
+
+  if (joint->type == JOINT_HINGE) {
+    vec3 across[2];
+    across[0] = joint_perpendicular(frame->axis[1]);
+    across[1] = vec3_cross_product(frame->axis[1], across[0]);
+    vec3 error = vec3_cross_product(frame->axis[1], frame->axis[0]);
+    for (unsigned int j = 0; j < 2; j++)
+      joint_solver_add_angular_row(joint_solver, frame, 3 + j, across[j], vec3_dot(error, across[j]), duration, false);
+    joint_solver_add_block(joint_solver, first, false);
+
+    if (joint->limited) {
+      vec3 from = frame->reference[1][0];
+      vec3 to = frame->reference[0][0];
+      float angle = atan2f(vec3_dot(vec3_cross_product(from, to), frame->axis[1]), vec3_dot(from, to));
+      joint_solver_add_limit_row(joint_solver, frame, 5, angle, frame->axis[1], duration);
+    }
+  } else if (joint->type == JOINT_FIXED) {
+    joint_solver_add_rotation_rows(joint_solver, frame, 3, duration);
+    joint_solver_add_block(joint_solver, first, false);
+  } else if (joint->type == JOINT_SLIDER) {
+    vec3 offset = vec3_add(frame->offset[1], separation);
+    vec3 across[2];
+    across[0] = joint_perpendicular(frame->axis[1]);
+    across[1] = vec3_cross_product(frame->axis[1], across[0]);
+    for (unsigned int j = 0; j < 2; j++)
+      joint_solver_add_linear_row(joint_solver, frame, j, across[j], offset, vec3_dot(separation, across[j]), duration, false);
+    joint_solver_add_rotation_rows(joint_solver, frame, 2, duration);
+    joint_solver_add_block(joint_solver, first, false);
+
+    if (joint->limited)
+      joint_solver_add_limit_row(joint_solver, frame, 5, vec3_dot(separation, frame->axis[1]), frame->axis[1], duration);
+  } else {
+    joint_solver_add_block(joint_solver, first, false);
+  }
+}
+
+// Bodies found in the contact graph use shared_state, laid out like the ImpulseSolver's body
+// state, the rest are loaded into the solver's own array. Passing no graph keeps every body
+// in the solver.
+void joint_solver_prepare(struct JointSolver* joint_solver, struct JointConstraint* joints, unsigned int num_joints, struct ContactGraph* contact_graph, float* shared_state, float duration) {
+  joint_solver_reserve(joint_solver, num_joints);
+
+  // Own bodies are indexed first, so the zeroed slot after them stays put
+  for (unsigned int joint_num = 0; joint_num < num_joints; joint_num++) {
+    struct JointConstraint* joint = &joints[joint_num];
+    if (!joint_solver_is_active(joint))
+      continue;
+    for (unsigned int b = 0; b < 2; b++)
+      if (joint_is_movable(joint->body[b]))
+        joint_solver_find_state(joint_solver, joint->body[b], contact_graph, shared_state);
+  }
+
+  for (unsigned int body_num = 0; body_num < joint_solver->body_count; body_num++) {
+    struct RigidBody* body = joint_solver->bodies[body_num];
+    float* state = joint_solver->body_state + (size_t)body_num * IMPULSE_SOLVER_BODY_FLOATS;
+    for (unsigned int k = 0; k < 3; k++) {
+      state[k] = body->velocity.data[k];
+      state[3 + k] = body->rotation.data[k];
+    }
+  }
+  memset(joint_solver->body_state + (size_t)joint_solver->body_count * IMPULSE_SOLVER_BODY_FLOATS, 0, sizeof(float) * IMPULSE_SOLVER_BODY_FLOATS);
+
+  for (unsigned int joint_num = 0; joint_num < num_joints; joint_num++) {
+    struct JointConstraint* joint = &joints[joint_num];
+    if (!joint_solver_is_active(joint))
+      continue;
+
+    struct JointFrame frame = {.joint = joint};
+    for (unsigned int b = 0; b < 2; b++) {
+      struct RigidBody* body = joint->body[b];
+      if (body && body->is_dirty)
+        rigid_body_calculate_derived_data(body);
+
+      frame.state[b] = joint_solver_find_state(joint_solver, body, contact_graph, shared_state);
+      frame.anchor[b] = body ? rigid_body_get_point_in_world_space(body, joint->position[b]) : joint->position[b];
+      frame.offset[b] = body ? vec3_sub(frame.anchor[b], body->position) : VEC3_ZERO;
+      frame.axis[b] = body ? rigid_body_get_direction_in_world_space(body, joint->axis[b]) : joint->axis[b];
+      for (unsigned int j = 0; j < 3; j++)
+        frame.reference[b][j] = body ? rigid_body_get_direction_in_world_space(body, joint->reference[b][j]) : joint->reference[b][j];
+    }
+    joint_solver_add_joint(joint_solver, &frame, duration);
+  }
+}
+
+void joint_solver_iterate(struct JointSolver* joint_solver) {
+  for (unsigned int block_num = 0; block_num < joint_solver->block_count; block_num++) {
+    struct JointBlock* block = &joint_solver->blocks[block_num];
+    struct JointRow* rows = joint_solver->rows + block->first;
+
+    if (block->limit) {
+      float accumulated = *rows->impulse;
+      float impulse = accumulated - rows->mass * (joint_row_velocity(rows) + rows->bias);
+      impulse = fmaxf(rows->lower, fminf(rows->upper, impulse));
+      *rows->impulse = impulse;
+      joint_row_apply(rows, impulse - accumulated);
+      continue;
+    }
+
+    // Solves L L^T delta = -(J·v + bias) by forward then back substitution
+    unsigned int n = block->count;
+    const float* l = block->factor;
+    float delta[JOINT_MAX_ROWS];
+    for (unsigned int i = 0; i < n; i++) {
+      float s = -(joint_row_velocity(&rows[i]) + rows[i].bias);
+      for (unsigned int k = 0; k < i; k++)
+        s -= l[i * n + k] * delta[k];
+      delta[i] = s / l[i * n + i];
+    }
+    for (unsigned int i = n; i-- > 0;) {
+      float s = delta[i];
+      for (unsigned int k = i + 1; k < n; k++)
+        s -= l[k * n + i] * delta[k];
+      delta[i] = s / l[i * n + i];
+    }
+
+    for (unsigned int i = 0; i < n; i++) {
+      *rows[i].impulse += delta[i];
+      joint_row_apply(&rows[i], delta[i]);
+    }
+  }
+}
+
+// Only the bodies kept in the solver's own array, the shared ones go back with the contacts
+void joint_solver_finish(struct JointSolver* joint_solver) {
+  for (unsigned int body_num = 0; body_num < joint_solver->body_count; body_num++) {
+    struct RigidBody* body = joint_solver->bodies[body_num];
+    float* state = joint_solver->body_state + (size_t)body_num * IMPULSE_SOLVER_BODY_FLOATS;
+    body->velocity = (vec3){.data[0] = state[0], .data[1] = state[1], .data[2] = state[2]};
+    body->rotation = (vec3){.data[0] = state[3], .data[1] = state[4], .data[2] = state[5]};
+  }
+}
@@ -0,0 +1,317 @@
+#include "chaos/core/manifold.h"
+
+static inline unsigned int manifold_table_hash(struct ManifoldTable* manifold_table, struct RigidBody* one, struct RigidBody* two) {
+  uintptr_t hash = ((uintptr_t)one >> 4) * 2654435761u;
+  hash ^= ((uintptr_t)two >> 4) * 40503u + (hash << 6) + (hash >> 2);
+  return (unsigned int)hash & (manifold_table->slot_capacity - 1);
+}
+
+static void manifold_table_init(struct ManifoldTable* manifold_table) {
+  manifold_table->count = 0;
+  manifold_table->capacity = 0;
+  manifold_table->manifolds = NULL;
+  manifold_table->slot_capacity = 0;
+  manifold_table->slots = NULL;
+}
+
+static void manifold_table_delete(struct ManifoldTable* manifold_table) {
+  free(manifold_table->manifolds);
+  free(manifold_table->slots);
+}
+
+// Empties the table with room for pair_count pairs
+static void manifold_table_reset(struct ManifoldTable* manifold_table, unsigned int pair_count) {
+  if (manifold_table->capacity < pair_count) {
+    manifold_table->capacity = pair_count;
+    manifold_table->manifolds = realloc(manifold_table->manifolds, sizeof(struct ContactManifold) * manifold_table->capacity);
+  }
+
+  if (manifold_table->slot_capacity < pair_count * 2) {
+    free(manifold_table->slots);
+    manifold_table->slot_capacity = 16;
+    while (manifold_table->slot_capacity < pair_count * 2)
+      manifold_table->slot_capacity *= 2;
+    manifold_table->slots = malloc(sizeof(unsigned int) * manifold_table->slot_capacity);
+  }
+
+  manifold_table->count = 0;
+  for (unsigned int slot = 0; slot < manifold_table->slot_capacity; slot++)
+    manifold_table->slots[slot] = CONTACT_MANIFOLD_NONE;
+}
+
+static unsigned int manifold_table_find(struct ManifoldTable* manifold_table, struct RigidBody* one, struct RigidBody* two) {
+  if (manifold_table->count == 0)
+    return CONTACT_MANIFOLD_NONE;
+
+  unsigned int slot = manifold_table_hash(manifold_table, one, two);
+  while (manifold_table->slots[slot] != CONTACT_MANIFOLD_NONE) {
+    struct ContactManifold* manifold = &manifold_table->manifolds[manifold_table->slots[slot]];
+    if (manifold->body[0] == one && manifold->body[1] == two)
+      return manifold_table->slots[slot];
+    slot = (slot + 1) & (manifold_table->slot_capacity - 1);
+  }
+  return CONTACT_MANIFOLD_NONE;
+}
+
+// NOTE: The table was reset for at least as many pairs as get added, so it never fills up
+static unsigned int manifold_table_add(struct ManifoldTable* manifold_table, struct RigidBody* one, struct RigidBody* two) {
+  unsigned int slot = manifold_table_hash(manifold_table, one, two);
+  while (manifold_table->slots[slot] != CONTACT_MANIFOLD_NONE) {
+    struct ContactManifold* manifold = &manifold_table->manifolds[manifold_table->slots[slot]];
+    if (manifold->body[0] == one && manifold->body[1] == two)
+      return manifold_table->slots[slot];
+    slot = (slot + 1) & (manifold_table->slot_capacity - 1);
+  }
+
+  unsigned int manifold_num = manifold_table->count++;
+  manifold_table->slots[slot] = manifold_num;
+  manifold_table->manifolds[manifold_num].body[0] = one;
+  manifold_table->manifolds[manifold_num].body[1] = two;
+  manifold_table->manifolds[manifold_num].point_count = 0;
+  return manifold_num;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+void manifold_cache_init(struct ManifoldCache* manifold_cache) {
+  manifold_table_init(&manifold_cache->current);
+  manifold_table_init(&manifold_cache->previous);
+  manifold_cache->scratch_capacity = 0;
+  manifold_cache->contact_manifold = NULL;
+  manifold_cache->pair_start = NULL;
+  manifold_cache->pair_contacts = NULL;
+  manifold_cache->candidate_capacity = 0;
+  manifold_cache->candidates = NULL;
+  manifold_cache->contact_count = 0;
+  manifold_cache->contact_capacity = 0;
+  manifold_cache->contacts = NULL;
+}
+
+void manifold_cache_delete(struct ManifoldCache* manifold_cache) {
+  manifold_table_delete(&manifold_cache->current);
+  manifold_table_delete(&manifold_cache->previous);
+  free(manifold_cache->contact_manifold);
+  free(manifold_cache->pair_start);
+  free(manifold_cache->pair_contacts);
+  free(manifold_cache->candidates);
+  free(manifold_cache->contacts);
+}
+
+// Forgets every manifold, for when bodies were moved by hand
+void manifold_cache_clear(struct ManifoldCache* manifold_cache) {
+  manifold_cache->current.count = 0;
+  manifold_cache->previous.count = 0;
+  manifold_cache->contact_count = 0;
+}
+
+// Forgets the manifolds of one body, whose address a body added later could reuse. The
+// manifolds stay in the table with no bodies, so the other pairs keep their slots.
+void manifold_cache_remove_body(struct ManifoldCache* manifold_cache, struct RigidBody* body) {
+  struct ManifoldTable* current = &manifold_cache->current;
+  for (unsigned int manifold_num = 0; manifold_num < current->count; manifold_num++) {
+    struct ContactManifold* manifold = &current->manifolds[manifold_num];
+    if (manifold->body[0] == body || manifold->body[1] == body) {
+      manifold->body[0] = NULL;
+      manifold->body[1] = NULL;
+      manifold->point_count = 0;
+    }
+  }
+
+  unsigned int kept = 0;
+  for (unsigned int contact_num = 0; contact_num < manifold_cache->contact_count; contact_num++) {
+    struct Contact* contact = &manifold_cache->contacts[contact_num];
+    if (contact->body[0] != body && contact->body[1] != body)
+      manifold_cache->contacts[kept++] = *contact;
+  }
+  manifold_cache->contact_count = kept;
+}
+
+struct ContactManifold* manifold_cache_find(struct ManifoldCache* manifold_cache, struct RigidBody* one, struct RigidBody* two) {
+  unsigned int manifold_num = manifold_table_find(&manifold_cache->current, one, two);
+  return manifold_num == CONTACT_MANIFOLD_NONE ? NULL : &manifold_cache->current.manifolds[manifold_num];
+}
+
+// Picks at most CONTACT_MANIFOLD_POINTS points that keep the deepest penetration and as much of
+// the area the points cover as possible, selected gets their indices
+unsigned int manifold_reduce(struct Contact* points, unsigned int point_count, unsigned int selected[CONTACT_MANIFOLD_POINTS]) {
+  if (point_count <= CONTACT_MANIFOLD_POINTS) {
+    for (unsigned int point_num = 0; point_num < point_count; point_num++)
+      selected[point_num] = point_num;
+    return point_count;
+  }
+
+  unsigned int deepest = 0;
+  for (unsigned int point_num = 1; point_num < point_count; point_num++)
+    if (points[point_num].penetration > points[deepest].penetration)
+      deepest = point_num;
+  vec3 a = points[deepest].contact_point;
+  selected[0] = deepest;
+
+  unsigned int furthest = deepest;
+  float best = 0.0f;
+  for (unsigned int point_num = 0; point_num < point_count; point_num++) {
+    float distance = vec3_square_magnitude(vec3_sub(points[point_num].contact_point, a));
+    if (distance > best) {
+      best = distance;
+      furthest = point_num;
+    }
+  }
+  if (furthest == deepest)
+    return 1;
+  vec3 b = points[furthest].contact_point;
+  selected[1] = furthest;
+
+  unsigned int widest = deepest;
+  vec3 ab = vec3_sub(b, a);
+  best = 0.0f;
+  for (unsigned int point_num = 0; point_num < point_count; point_num++) {
+    float area = vec3_square_magnitude(vec3_cross_product(ab, vec3_sub(points[point_num].contact_point, a)));
+    if (area > best) {
+      best = area;
+      widest = point_num;
+    }
+  }
+  if (widest == deepest)
+    return 2;
+  vec3 c = points[widest].contact_point;
+  selected[2] = widest;
+
+  // NOTE: Points inside the triangle have a positive area against all three edges, the one
+  // with the most negative area against any edge adds the most
+  vec3 corners[3] = {a, b, c};
+  vec3 facing = vec3_cross_product(ab, vec3_sub(c, a));
+  unsigned int outside = deepest;
+  best = 0.0f;
+  for (unsigned int point_num = 0; point_num < point_count; point_num++) {
+    vec3 point = points[point_num].contact_point;
+    for (unsigned int edge = 0; edge < 3; edge++) {
+      vec3 start = corners[edge];
+      vec3 end = corners[(edge + 1) % 3];
+      float area = -vec3_dot(vec3_cross_product(vec3_sub(end, start), vec3_sub(point, start)), facing);
+      if (area > best) {
+        best = area;
+        outside = point_num;
+      }
+    }
+  }
+  if (outside == deepest)
+    return 3;
+  selected[3] = outside;
+  return 4;
+}
+
+// Follows the anchors of a point kept from last frame and tells whether it still belongs in
+// a manifold whose new contacts face along normal
+static bool manifold_point_is_valid(struct Contact* point, vec3 normal) {
+  if (vec3_dot(point->contact_normal, normal) < CONTACT_MANIFOLD_NORMAL_DOT)
+    return false;
+
+  contact_follow_anchors(point);
+  if (point->penetration < -CONTACT_MANIFOLD_BREAK)
+    return false;
+
+  vec3 anchor[2];
+  for (unsigned int b = 0; b < 2; b++)
+    anchor[b] = point->body[b] ? rigid_body_get_point_in_world_space(point->body[b], point->local_position[b]) : point->local_position[b];
+  vec3 drift = vec3_sub(anchor[0], anchor[1]);
+  drift = vec3_sub(drift, vec3_scale(point->contact_normal, vec3_dot(drift, point->contact_normal)));
+  return vec3_square_magnitude(drift) <= CONTACT_MANIFOLD_BREAK * CONTACT_MANIFOLD_BREAK;
+}
+
+static bool manifold_point_is_replaced(struct Contact* point, struct Contact* contacts, unsigned int num_contacts) {
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++) {
+    struct Contact* contact = &contacts[contact_num];
+    if (contact->feature == point->feature || vec3_square_magnitude(vec3_sub(contact->contact_point, point->contact_point)) < CONTACT_MANIFOLD_MERGE * CONTACT_MANIFOLD_MERGE)
+      return true;
+  }
+  return false;
+}
+
+static void manifold_cache_reserve(struct ManifoldCache* manifold_cache, unsigned int num_contacts) {
+  if (manifold_cache->scratch_capacity >= num_contacts)
+    return;
+
+  manifold_cache->scratch_capacity = num_contacts;
+  manifold_cache->contact_manifold = realloc(manifold_cache->contact_manifold, sizeof(unsigned int) * num_contacts);
+  manifold_cache->pair_start = realloc(manifold_cache->pair_start, sizeof(unsigned int) * num_contacts);
+  manifold_cache->pair_contacts = realloc(manifold_cache->pair_contacts, sizeof(unsigned int) * num_contacts);
+}
+
+// Builds this frame's manifolds from the generated contacts, in the order their pairs first
+// appear, and returns how many points went into the cache's contacts
+unsigned int manifold_cache_update(struct ManifoldCache* manifold_cache, struct Contact* contacts, unsigned int num_contacts) {
+  struct ManifoldTable swap = manifold_cache->previous;
+  manifold_cache->previous = manifold_cache->current;
+  manifold_cache->current = swap;
+
+  struct ManifoldTable* current = &manifold_cache->current;
+  struct ManifoldTable* previous = &manifold_cache->previous;
+  manifold_table_reset(current, num_contacts);
+  manifold_cache->contact_count = 0;
+  if (num_contacts == 0)
+    return 0;
+  manifold_cache_reserve(manifold_cache, num_contacts);
+
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+    manifold_cache->contact_manifold[contact_num] = manifold_table_add(current, contacts[contact_num].body[0], contacts[contact_num].body[1]);
+
+  // NOTE: Counting sort by pair, pair_start ends up holding where each pair's contacts stop
+  unsigned int* pair_start = manifold_cache->pair_start;
+  memset(pair_start, 0, sizeof(unsigned int) * current->count);
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+    pair_start[manifold_cache->contact_manifold[contact_num]]++;
+  unsigned int offset = 0;
+  unsigned int largest = 0;
+  for (unsigned int manifold_num = 0; manifold_num < current->count; manifold_num++) {
+    unsigned int count = pair_start[manifold_num];
+    pair_start[manifold_num] = offset;
+    offset += count;
+    if (largest < count)
+      largest = count;
+  }
+  for (unsigned int contact_num = 0; contact_num < num_contacts; contact_num++)
+    manifold_cache->pair_contacts[pair_start[manifold_cache->contact_manifold[contact_num]]++] = contact_num;
+
+  if (manifold_cache->candidate_capacity < largest + CONTACT_MANIFOLD_POINTS) {
+    manifold_cache->candidate_capacity = largest + CONTACT_MANIFOLD_POINTS;
+    manifold_cache->candidates = realloc(manifold_cache->candidates, sizeof(struct Contact) * manifold_cache->candidate_capacity);
+  }
+  if (manifold_cache->contact_capacity < current->count * CONTACT_MANIFOLD_POINTS) {
+    manifold_cache->contact_capacity = current->count * CONTACT_MANIFOLD_POINTS;
+    manifold_cache->contacts = realloc(manifold_cache->contacts, sizeof(struct Contact) * manifold_cache->contact_capacity);
+  }
+
+  for (unsigned int manifold_num = 0; manifold_num < current->count; manifold_num++) {
+    struct ContactManifold* manifold = &current->manifolds[manifold_num];
+    struct Contact* candidates = manifold_cache->candidates;
+    unsigned int first = manifold_num ? pair_start[manifold_num - 1] : 0;
+    unsigned int fresh = pair_start[manifold_num] - first;
+
+    for (unsigned int contact_num = 0; contact_num < fresh; contact_num++) {
+      candidates[contact_num] = contacts[manifold_cache->pair_contacts[first + contact_num]];
+      contact_store_anchors(&candidates[contact_num]);
+    }
+
+    unsigned int candidate_count = fresh;
+    unsigned int kept_num = manifold_table_find(previous, manifold->body[0], manifold->body[1]);
+    if (kept_num != CONTACT_MANIFOLD_NONE) {
+      struct ContactManifold* kept = &previous->manifolds[kept_num];
+      for (unsigned int point_num = 0; point_num < kept->point_count; point_num++) {
+        struct Contact point = kept->points[point_num];
+        if (manifold_point_is_valid(&point, candidates[0].contact_normal) && !manifold_point_is_replaced(&point, candidates, fresh))
+          candidates[candidate_count++] = point;
+      }
+    }
+
+    unsigned int selected[CONTACT_MANIFOLD_POINTS];
+    manifold->point_count = manifold_reduce(candidates, candidate_count, selected);
+    for (unsigned int point_num = 0; point_num < manifold->point_count; point_num++) {
+      struct Contact* point = &candidates[selected[point_num]];
+      manifold->points[point_num] = *point;
+      if (selected[point_num] < fresh || point->penetration > 0.0f)
+        manifold_cache->contacts[manifold_cache->contact_count++] = *point;
+    }
+  }
+
+  return manifold_cache->contact_count;
+}
@@ -0,0 +1,281 @@
+#include "chaos/core/spatialgrid.h"
+
+#include "chaos/core/collidecoarse.h"
+
+static inline int spatial_grid_cell(struct SpatialGrid* spatial_grid, float value) {
+  return (int)floorf(value * spatial_grid->inverse_cell_size);
+}
+
+static inline unsigned int spatial_grid_hash(struct SpatialGrid* spatial_grid, int* cell) {
+  uint32_t hash = (uint32_t)cell[0] * 73856093u ^ (uint32_t)cell[1] * 19349663u ^ (uint32_t)cell[2] * 83492791u;
+  return hash & (spatial_grid->bucket_count - 1);
+}
+
+// Entries of one bucket in proxy order, then cell order, so the pairs do not depend on the
+// order the scatter wrote them in
+static inline bool spatial_grid_entry_less(struct SpatialGridEntry* one, struct SpatialGridEntry* two) {
+  if (one->proxy != two->proxy)
+    return one->proxy < two->proxy;
+  for (unsigned int i = 0; i < 3; i++)
+    if (one->cell[i] != two->cell[i])
+      return one->cell[i] < two->cell[i];
+  return false;
+}
+
+static void spatial_grid_sort_bucket(struct SpatialGridEntry* entries, unsigned int count) {
+  for (unsigned int entry_num = 1; entry_num < count; entry_num++) {
+    struct SpatialGridEntry entry = entries[entry_num];
+    unsigned int position = entry_num;
+    while (position > 0 && spatial_grid_entry_less(&entry, &entries[position - 1])) {
+      entries[position] = entries[position - 1];
+      position--;
+    }
+    entries[position] = entry;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+void spatial_grid_init(struct SpatialGrid* spatial_grid, float cell_size) {
+  memset(spatial_grid, 0, sizeof(struct SpatialGrid));
+  spatial_grid_set_cell_size(spatial_grid, cell_size);
+}
+
+void spatial_grid_delete(struct SpatialGrid* spatial_grid) {
+  free(spatial_grid->proxies);
+  free(spatial_grid->entries);
+  free(spatial_grid->sorted_entries);
+  free(spatial_grid->bucket_start);
+  free(spatial_grid->bucket_cursor);
+  free(spatial_grid->block_output);
+  for (unsigned int thread_num = 0; thread_num < spatial_grid->thread_pairs_count; thread_num++)
+    free(spatial_grid->thread_pairs[thread_num].pairs);
+  free(spatial_grid->thread_pairs);
+  free(spatial_grid->pairs);
+}
+
+// NOTE: Takes effect on the next build
+void spatial_grid_set_cell_size(struct SpatialGrid* spatial_grid, float cell_size) {
+  spatial_grid->cell_size = cell_size;
+  spatial_grid->inverse_cell_size = 1.0f / cell_size;
+}
+
+void spatial_grid_clear(struct SpatialGrid* spatial_grid) {
+  spatial_grid->proxy_count = 0;
+  spatial_grid->pair_count = 0;
+}
+
+unsigned int spatial_grid_add(struct SpatialGrid* spatial_grid, struct RigidBody* body, struct AABB aabb) {
+  if (spatial_grid->proxy_count == spatial_grid->proxy_capacity) {
+    spatial_grid->proxy_capacity = spatial_grid->proxy_capacity ? spatial_grid->proxy_capacity * 2 : 256;
+    spatial_grid->proxies = realloc(spatial_grid->proxies, sizeof(struct SpatialGridProxy) * spatial_grid->proxy_capacity);
+  }
+
+  spatial_grid->proxies[spatial_grid->proxy_count].body = body;
+  spatial_grid->proxies[spatial_grid->proxy_count].aabb = aabb;
+  return spatial_grid->proxy_count++;
+}
+
+// Finds the cells each box touches, first_entry holds how many until the prefix sum
+static void spatial_grid_count_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct SpatialGrid* spatial_grid = data;
+
+  for (unsigned int proxy_num = begin; proxy_num < end; proxy_num++) {
+    struct SpatialGridProxy* proxy = &spatial_grid->proxies[proxy_num];
+    unsigned int cells = 1;
+    for (unsigned int i = 0; i < 3; i++) {
+      proxy->cell_min[i] = spatial_grid_cell(spatial_grid, proxy->aabb.min.data[i]);
+      proxy->cell_max[i] = spatial_grid_cell(spatial_grid, proxy->aabb.max.data[i]);
+      cells *= (unsigned int)(proxy->cell_max[i] - proxy->cell_min[i] + 1);
+    }
+    proxy->first_entry = cells;
+  }
+}
+
+static void spatial_grid_fill_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct SpatialGrid* spatial_grid = data;
+
+  for (unsigned int proxy_num = begin; proxy_num < end; proxy_num++) {
+    struct SpatialGridProxy* proxy = &spatial_grid->proxies[proxy_num];
+    struct SpatialGridEntry* entry = &spatial_grid->entries[proxy->first_entry];
+    int cell[3];
+    for (cell[0] = proxy->cell_min[0]; cell[0] <= proxy->cell_max[0]; cell[0]++) {
+      for (cell[1] = proxy->cell_min[1]; cell[1] <= proxy->cell_max[1]; cell[1]++) {
+        for (cell[2] = proxy->cell_min[2]; cell[2] <= proxy->cell_max[2]; cell[2]++) {
+          entry->proxy = proxy_num;
+          entry->bucket = spatial_grid_hash(spatial_grid, cell);
+          memcpy(entry->cell, cell, sizeof(cell));
+          atomic_fetch_add_explicit(&spatial_grid->bucket_cursor[entry->bucket], 1, memory_order_relaxed);
+          entry++;
+        }
+      }
+    }
+  }
+}
+
+static void spatial_grid_scatter_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct SpatialGrid* spatial_grid = data;
+
+  for (unsigned int entry_num = begin; entry_num < end; entry_num++) {
+    struct SpatialGridEntry* entry = &spatial_grid->entries[entry_num];
+    unsigned int slot = atomic_fetch_add_explicit(&spatial_grid->bucket_cursor[entry->bucket], 1, memory_order_relaxed);
+    spatial_grid->sorted_entries[slot] = *entry;
+  }
+}
+
+static void spatial_grid_push_pair(struct SpatialGridThreadPairs* thread_pairs, struct RigidBody* one, struct RigidBody* two) {
+  if (thread_pairs->count == thread_pairs->capacity) {
+    thread_pairs->capacity = thread_pairs->capacity ? thread_pairs->capacity * 2 : 256;
+    thread_pairs->pairs = realloc(thread_pairs->pairs, sizeof(struct PotentialContact) * thread_pairs->capacity);
+  }
+  thread_pairs->pairs[thread_pairs->count].body[0] = one;
+  thread_pairs->pairs[thread_pairs->count].body[1] = two;
+  thread_pairs->count++;
+}
+
+// A pair is kept only in the cell holding the min corner of where the boxes overlap, which is
+// one of the cells both boxes touch
+static void spatial_grid_pairs_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct SpatialGrid* spatial_grid = data;
+  struct SpatialGridThreadPairs* thread_pairs = &spatial_grid->thread_pairs[thread_index];
+
+  for (unsigned int block = begin; block < end; block++) {
+    struct SpatialGridBlockOutput* output = &spatial_grid->block_output[block];
+    output->thread_index = thread_index;
+    output->offset = thread_pairs->count;
+
+    unsigned int last_bucket = (block + 1) * SPATIAL_GRID_CELL_BLOCK;
+    if (last_bucket > spatial_grid->bucket_count)
+      last_bucket = spatial_grid->bucket_count;
+
+    for (unsigned int bucket = block * SPATIAL_GRID_CELL_BLOCK; bucket < last_bucket; bucket++) {
+      struct SpatialGridEntry* entries = &spatial_grid->sorted_entries[spatial_grid->bucket_start[bucket]];
+      unsigned int count = spatial_grid->bucket_start[bucket + 1] - spatial_grid->bucket_start[bucket];
+      if (count < 2)
+        continue;
+      spatial_grid_sort_bucket(entries, count);
+
+      for (unsigned int one = 0; one < count; one++) {
+        struct SpatialGridProxy* proxy_one = &spatial_grid->proxies[entries[one].proxy];
+        for (unsigned int two = one + 1; two < count; two++) {
+          if (entries[two].proxy == entries[one].proxy || memcmp(entries[one].cell, entries[two].cell, sizeof(entries[one].cell)) != 0)
+            continue;
+
+          struct SpatialGridProxy* proxy_two = &spatial_grid->proxies[entries[two].proxy];
+          if (!aabb_overlaps(proxy_one->aabb, proxy_two->aabb))
+            continue;
+
+          bool owner = true;
+          for (unsigned int i = 0; i < 3 && owner; i++) {
+            float corner = proxy_one->aabb.min.data[i] > proxy_two->aabb.min.data[i] ? proxy_one->aabb.min.data[i] : proxy_two->aabb.min.data[i];
+            owner = spatial_grid_cell(spatial_grid, corner) == entries[one].cell[i];
+          }
+          if (owner)
+            spatial_grid_push_pair(thread_pairs, proxy_one->body, proxy_two->body);
+        }
+      }
+    }
+
+    output->count = thread_pairs->count - output->offset;
+  }
+}
+
+// Counting sort of the entries by bucket: count per bucket, prefix sum into bucket ranges,
+// then scatter. Only the order inside a bucket depends on the scheduling, and the pair pass
+// sorts each bucket before testing it.
+void spatial_grid_build(struct SpatialGrid* spatial_grid, struct JobScheduler* scheduler) {
+  spatial_grid->pair_count = 0;
+  spatial_grid->entry_count = 0;
+  if (spatial_grid->proxy_count == 0)
+    return;
+
+  job_scheduler_parallel_for(scheduler, spatial_grid->proxy_count, SPATIAL_GRID_CHUNK_SIZE, spatial_grid_count_range, spatial_grid);
+
+  unsigned int entry_count = 0;
+  for (unsigned int proxy_num = 0; proxy_num < spatial_grid->proxy_count; proxy_num++) {
+    unsigned int cells = spatial_grid->proxies[proxy_num].first_entry;
+    spatial_grid->proxies[proxy_num].first_entry = entry_count;
+    entry_count += cells;
+  }
+  spatial_grid->entry_count = entry_count;
+
+  if (spatial_grid->entry_capacity < entry_count) {
+    free(spatial_grid->entries);
+    free(spatial_grid->sorted_entries);
+    spatial_grid->entry_capacity = entry_count + entry_count / 2;
+    spatial_grid->entries = malloc(sizeof(struct SpatialGridEntry) * spatial_grid->entry_capacity);
+    spatial_grid->sorted_entries = malloc(sizeof(struct SpatialGridEntry) * spatial_grid->entry_capacity);
+  }
+
+  // NOTE: At least two buckets per entry keeps unrelated cells from sharing buckets often
+  unsigned int bucket_count = 64;
+  while (bucket_count < entry_count * 2)
+    bucket_count *= 2;
+  spatial_grid->bucket_count = bucket_count;
+  if (spatial_grid->bucket_capacity < bucket_count) {
+    free(spatial_grid->bucket_start);
+    free(spatial_grid->bucket_cursor);
+    spatial_grid->bucket_capacity = bucket_count;
+    spatial_grid->bucket_start = malloc(sizeof(unsigned int) * (bucket_count + 1));
+    spatial_grid->bucket_cursor = malloc(sizeof(atomic_uint) * bucket_count);
+  }
+  for (unsigned int bucket = 0; bucket < bucket_count; bucket++)
+    atomic_init(&spatial_grid->bucket_cursor[bucket], 0);
+
+  job_scheduler_parallel_for(scheduler, spatial_grid->proxy_count, SPATIAL_GRID_CHUNK_SIZE, spatial_grid_fill_range, spatial_grid);
+
+  unsigned int start = 0;
+  for (unsigned int bucket = 0; bucket < bucket_count; bucket++) {
+    unsigned int count = atomic_load_explicit(&spatial_grid->bucket_cursor[bucket], memory_order_relaxed);
+    spatial_grid->bucket_start[bucket] = start;
+    atomic_store_explicit(&spatial_grid->bucket_cursor[bucket], start, memory_order_relaxed);
+    start += count;
+  }
+  spatial_grid->bucket_start[bucket_count] = start;
+
+  job_scheduler_parallel_for(scheduler, entry_count, SPATIAL_GRID_CHUNK_SIZE, spatial_grid_scatter_range, spatial_grid);
+
+  unsigned int thread_count = job_scheduler_thread_count(scheduler);
+  if (spatial_grid->thread_pairs_count < thread_count) {
+    spatial_grid->thread_pairs = realloc(spatial_grid->thread_pairs, sizeof(struct SpatialGridThreadPairs) * thread_count);
+    memset(spatial_grid->thread_pairs + spatial_grid->thread_pairs_count, 0, sizeof(struct SpatialGridThreadPairs) * (thread_count - spatial_grid->thread_pairs_count));
+    spatial_grid->thread_pairs_count = thread_count;
+  }
+  for (unsigned int thread_num = 0; thread_num < spatial_grid->thread_pairs_count; thread_num++)
+    spatial_grid->thread_pairs[thread_num].count = 0;
+
+  unsigned int blocks = (bucket_count + SPATIAL_GRID_CELL_BLOCK - 1) / SPATIAL_GRID_CELL_BLOCK;
+  if (spatial_grid->block_capacity < blocks) {
+    free(spatial_grid->block_output);
+    spatial_grid->block_capacity = blocks;
+    spatial_grid->block_output = malloc(sizeof(struct SpatialGridBlockOutput) * blocks);
+  }
+
+  job_scheduler_parallel_for(scheduler, blocks, 1, spatial_grid_pairs_range, spatial_grid);
+
+  unsigned int pair_count = 0;
+  for (unsigned int block = 0; block < blocks; block++)
+    pair_count += spatial_grid->block_output[block].count;
+  if (spatial_grid->pair_capacity < pair_count) {
+    free(spatial_grid->pairs);
+    spatial_grid->pair_capacity = pair_count + pair_count / 2;
+    spatial_grid->pairs = malloc(sizeof(struct PotentialContact) * spatial_grid->pair_capacity);
+  }
+
+  for (unsigned int block = 0; block < blocks; block++) {
+    struct SpatialGridBlockOutput* output = &spatial_grid->block_output[block];
+    if (output->count == 0)
+      continue;
+    memcpy(spatial_grid->pairs + spatial_grid->pair_count, spatial_grid->thread_pairs[output->thread_index].pairs + output->offset, sizeof(struct PotentialContact) * output->count);
+    spatial_grid->pair_count += output->count;
+  }
+}
+
+// Writes at most limit of the pairs found by the last build, needed is set to how many there are
+unsigned int spatial_grid_get_potential_contacts(struct SpatialGrid* spatial_grid, struct PotentialContact* contacts, unsigned int limit, unsigned int* needed) {
+  unsigned int used = spatial_grid->pair_count < limit ? spatial_grid->pair_count : limit;
+  if (used > 0)
+    memcpy(contacts, spatial_grid->pairs, sizeof(struct PotentialContact) * used);
+  *needed = spatial_grid->pair_count;
+  return used;
+}
@@ -0,0 +1,348 @@
+#include "chaos/core/sweepprune.h"
+
+#include "chaos/core/collidecoarse.h"
+
+static inline unsigned int sweep_prune_hash(struct SweepPrune* sweep_prune, unsigned int one, unsigned int two) {
+  uint32_t hash = one * 2654435761u;
+  hash ^= two * 40503u + (hash << 6) + (hash >> 2);
+  return hash & (sweep_prune->pair_capacity - 1);
+}
+
+static inline bool sweep_endpoint_is_max(struct SweepEndpoint* endpoint) {
+  return endpoint->proxy_end & 1;
+}
+
+// NOTE: A min end goes before a max end of the same value, so touching boxes overlap just as
+// they do for aabb_overlaps
+static inline bool sweep_endpoint_less(struct SweepEndpoint* one, struct SweepEndpoint* two) {
+  return one->value < two->value || (one->value == two->value && !sweep_endpoint_is_max(one) && sweep_endpoint_is_max(two));
+}
+
+static void sweep_prune_push_event(struct PotentialContact** events, unsigned int* count, unsigned int* capacity, struct RigidBody* one, struct RigidBody* two) {
+  if (*count == *capacity) {
+    *capacity = *capacity ? *capacity * 2 : 64;
+    *events = realloc(*events, sizeof(struct PotentialContact) * *capacity);
+  }
+  (*events)[*count].body[0] = one;
+  (*events)[*count].body[1] = two;
+  (*count)++;
+}
+
+static void sweep_prune_add_pair_slot(struct SweepPrune* sweep_prune, struct SweepPair pair) {
+  unsigned int slot = sweep_prune_hash(sweep_prune, pair.proxy[0], pair.proxy[1]);
+  while (sweep_prune->pairs[slot].proxy[0] != SWEEP_PRUNE_NULL)
+    slot = (slot + 1) & (sweep_prune->pair_capacity - 1);
+  sweep_prune->pairs[slot] = pair;
+}
+
+static void sweep_prune_grow_pairs(struct SweepPrune* sweep_prune) {
+  unsigned int old_capacity = sweep_prune->pair_capacity;
+  struct SweepPair* old_pairs = sweep_prune->pairs;
+
+  sweep_prune->pair_capacity = old_capacity ? old_capacity * 2 : 64;
+  sweep_prune->pairs = malloc(sizeof(struct SweepPair) * sweep_prune->pair_capacity);
+  for (unsigned int slot = 0; slot < sweep_prune->pair_capacity; slot++)
+    sweep_prune->pairs[slot].proxy[0] = SWEEP_PRUNE_NULL;
+
+  for (unsigned int slot = 0; slot < old_capacity; slot++)
+    if (old_pairs[slot].proxy[0] != SWEEP_PRUNE_NULL)
+      sweep_prune_add_pair_slot(sweep_prune, old_pairs[slot]);
+  free(old_pairs);
+}
+
+// Stamps the pair and lists it as added when it is new
+static void sweep_prune_add_pair(struct SweepPrune* sweep_prune, unsigned int one, unsigned int two) {
+  if (one > two) {
+    unsigned int swap = one;
+    one = two;
+    two = swap;
+  }
+
+  if ((sweep_prune->pair_count + 1) * 2 > sweep_prune->pair_capacity)
+    sweep_prune_grow_pairs(sweep_prune);
+
+  unsigned int slot = sweep_prune_hash(sweep_prune, one, two);
+  while (sweep_prune->pairs[slot].proxy[0] != SWEEP_PRUNE_NULL) {
+    struct SweepPair* pair = &sweep_prune->pairs[slot];
+    if (pair->proxy[0] == one && pair->proxy[1] == two) {
+      pair->stamp = sweep_prune->stamp;
+      return;
+    }
+    slot = (slot + 1) & (sweep_prune->pair_capacity - 1);
+  }
+
+  sweep_prune->pairs[slot] = (struct SweepPair){.proxy = {one, two}, .stamp = sweep_prune->stamp};
+  sweep_prune->pair_count++;
+  sweep_prune_push_event(&sweep_prune->added, &sweep_prune->added_count, &sweep_prune->added_capacity, sweep_prune->proxies[one].body, sweep_prune->proxies[two].body);
+}
+
+// Lists the pair as removed and shifts the entries after it back, so lookups never need
+// tombstones. An entry only moves back to a slot between its home and where it sat.
+static void sweep_prune_remove_pair_slot(struct SweepPrune* sweep_prune, unsigned int slot) {
+  struct SweepPair* pairs = sweep_prune->pairs;
+  unsigned int mask = sweep_prune->pair_capacity - 1;
+  sweep_prune_push_event(&sweep_prune->removed, &sweep_prune->removed_count, &sweep_prune->removed_capacity, sweep_prune->proxies[pairs[slot].proxy[0]].body, sweep_prune->proxies[pairs[slot].proxy[1]].body);
+  sweep_prune->pair_count--;
+
+  unsigned int next = slot;
+  while (true) {
+    next = (next + 1) & mask;
+    if (pairs[next].proxy[0] == SWEEP_PRUNE_NULL)
+      break;
+    unsigned int home = sweep_prune_hash(sweep_prune, pairs[next].proxy[0], pairs[next].proxy[1]);
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      pairs[slot] = pairs[next];
+      slot = next;
+    }
+  }
+  pairs[slot].proxy[0] = SWEEP_PRUNE_NULL;
+}
+
+static void sweep_prune_remove_pair(struct SweepPrune* sweep_prune, unsigned int one, unsigned int two) {
+  if (sweep_prune->pair_count == 0)
+    return;
+  if (one > two) {
+    unsigned int swap = one;
+    one = two;
+    two = swap;
+  }
+
+  unsigned int slot = sweep_prune_hash(sweep_prune, one, two);
+  while (sweep_prune->pairs[slot].proxy[0] != SWEEP_PRUNE_NULL) {
+    struct SweepPair* pair = &sweep_prune->pairs[slot];
+    if (pair->proxy[0] == one && pair->proxy[1] == two) {
+      sweep_prune_remove_pair_slot(sweep_prune, slot);
+      return;
+    }
+    slot = (slot + 1) & (sweep_prune->pair_capacity - 1);
+  }
+}
+
+// Drops the pairs of proxies being removed, or with remove_stale the pairs the last sweep did
+// not stamp. The slot is looked at again after a removal, another entry may have moved in.
+static void sweep_prune_remove_pairs(struct SweepPrune* sweep_prune, bool remove_stale) {
+  for (unsigned int slot = 0; slot < sweep_prune->pair_capacity;) {
+    struct SweepPair* pair = &sweep_prune->pairs[slot];
+    bool remove = false;
+    if (pair->proxy[0] != SWEEP_PRUNE_NULL) {
+      if (remove_stale)
+        remove = pair->stamp != sweep_prune->stamp;
+      else
+        remove = sweep_prune->proxies[pair->proxy[0]].removing || sweep_prune->proxies[pair->proxy[1]].removing;
+    }
+
+    if (remove)
+      sweep_prune_remove_pair_slot(sweep_prune, slot);
+    else
+      slot++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+// NOTE: axis_count is 1 or 3, anything else is treated as 3
+void sweep_prune_init(struct SweepPrune* sweep_prune, unsigned int axis_count) {
+  memset(sweep_prune, 0, sizeof(struct SweepPrune));
+  sweep_prune->axis_count = axis_count == 1 ? 1 : 3;
+  sweep_prune->free_list = SWEEP_PRUNE_NULL;
+}
+
+void sweep_prune_delete(struct SweepPrune* sweep_prune) {
+  free(sweep_prune->proxies);
+  for (unsigned int axis = 0; axis < 3; axis++)
+    free(sweep_prune->endpoints[axis]);
+  free(sweep_prune->pairs);
+  free(sweep_prune->active);
+  free(sweep_prune->pending);
+  free(sweep_prune->added);
+  free(sweep_prune->removed);
+}
+
+// The proxy's ends go last and are sorted in, and its pairs found, by the next update
+unsigned int sweep_prune_insert(struct SweepPrune* sweep_prune, struct RigidBody* body, struct AABB aabb) {
+  if (sweep_prune->free_list == SWEEP_PRUNE_NULL) {
+    unsigned int old_capacity = sweep_prune->proxy_capacity;
+    sweep_prune->proxy_capacity = old_capacity ? old_capacity * 2 : 64;
+    sweep_prune->proxies = realloc(sweep_prune->proxies, sizeof(struct SweepProxy) * sweep_prune->proxy_capacity);
+    for (unsigned int proxy_num = old_capacity; proxy_num < sweep_prune->proxy_capacity; proxy_num++)
+      sweep_prune->proxies[proxy_num].next_free = proxy_num + 1 < sweep_prune->proxy_capacity ? proxy_num + 1 : SWEEP_PRUNE_NULL;
+    sweep_prune->free_list = old_capacity;
+  }
+
+  if (sweep_prune->endpoint_count + 2 > sweep_prune->endpoint_capacity) {
+    sweep_prune->endpoint_capacity = sweep_prune->endpoint_capacity ? sweep_prune->endpoint_capacity * 2 : 128;
+    for (unsigned int axis = 0; axis < sweep_prune->axis_count; axis++)
+      sweep_prune->endpoints[axis] = realloc(sweep_prune->endpoints[axis], sizeof(struct SweepEndpoint) * sweep_prune->endpoint_capacity);
+  }
+
+  unsigned int proxy_num = sweep_prune->free_list;
+  struct SweepProxy* proxy = &sweep_prune->proxies[proxy_num];
+  sweep_prune->free_list = proxy->next_free;
+  proxy->body = body;
+  proxy->aabb = aabb;
+  proxy->next_free = SWEEP_PRUNE_NULL;
+  proxy->removing = false;
+
+  for (unsigned int axis = 0; axis < sweep_prune->axis_count; axis++) {
+    for (unsigned int end = 0; end < 2; end++) {
+      unsigned int endpoint_num = sweep_prune->endpoint_count + end;
+      sweep_prune->endpoints[axis][endpoint_num] = (struct SweepEndpoint){.value = end ? aabb.max.data[axis] : aabb.min.data[axis], .proxy_end = proxy_num << 1 | end};
+      proxy->endpoint[axis][end] = endpoint_num;
+    }
+  }
+  sweep_prune->endpoint_count += 2;
+  sweep_prune->proxy_count++;
+  return proxy_num;
+}
+
+// NOTE: The proxy and its pairs stay until the next update
+void sweep_prune_remove(struct SweepPrune* sweep_prune, unsigned int proxy) {
+  if (sweep_prune->proxies[proxy].removing)
+    return;
+  sweep_prune->proxies[proxy].removing = true;
+
+  if (sweep_prune->pending_count == sweep_prune->pending_capacity) {
+    sweep_prune->pending_capacity = sweep_prune->pending_capacity ? sweep_prune->pending_capacity * 2 : 16;
+    sweep_prune->pending = realloc(sweep_prune->pending, sizeof(unsigned int) * sweep_prune->pending_capacity);
+  }
+  sweep_prune->pending[sweep_prune->pending_count++] = proxy;
+}
+
+void sweep_prune_move(struct SweepPrune* sweep_prune, unsigned int proxy, struct AABB aabb) {
+  struct SweepProxy* sweep_proxy = &sweep_prune->proxies[proxy];
+  sweep_proxy->aabb = aabb;
+  for (unsigned int axis = 0; axis < sweep_prune->axis_count; axis++) {
+    sweep_prune->endpoints[axis][sweep_proxy->endpoint[axis][0]].value = aabb.min.data[axis];
+    sweep_prune->endpoints[axis][sweep_proxy->endpoint[axis][1]].value = aabb.max.data[axis];
+  }
+}
+
+static void sweep_prune_flush_removed(struct SweepPrune* sweep_prune) {
+  if (sweep_prune->pending_count == 0)
+    return;
+
+  sweep_prune_remove_pairs(sweep_prune, false);
+
+  for (unsigned int axis = 0; axis < sweep_prune->axis_count; axis++) {
+    struct SweepEndpoint* endpoints = sweep_prune->endpoints[axis];
+    unsigned int kept = 0;
+    for (unsigned int endpoint_num = 0; endpoint_num < sweep_prune->endpoint_count; endpoint_num++) {
+      struct SweepProxy* proxy = &sweep_prune->proxies[endpoints[endpoint_num].proxy_end >> 1];
+      if (proxy->removing)
+        continue;
+      proxy->endpoint[axis][endpoints[endpoint_num].proxy_end & 1] = kept;
+      endpoints[kept++] = endpoints[endpoint_num];
+    }
+  }
+  sweep_prune->endpoint_count -= sweep_prune->pending_count * 2;
+
+  for (unsigned int pending_num = 0; pending_num < sweep_prune->pending_count; pending_num++) {
+    struct SweepProxy* proxy = &sweep_prune->proxies[sweep_prune->pending[pending_num]];
+    proxy->removing = false;
+    proxy->body = NULL;
+    proxy->next_free = sweep_prune->free_list;
+    sweep_prune->free_list = sweep_prune->pending[pending_num];
+  }
+  sweep_prune->proxy_count -= sweep_prune->pending_count;
+  sweep_prune->pending_count = 0;
+}
+
+// Insertion sort of one axis, each swap is an inversion between the last order and this one
+static void sweep_prune_sort_axis(struct SweepPrune* sweep_prune, unsigned int axis, bool track_pairs) {
+  struct SweepEndpoint* endpoints = sweep_prune->endpoints[axis];
+  struct SweepProxy* proxies = sweep_prune->proxies;
+
+  for (unsigned int endpoint_num = 1; endpoint_num < sweep_prune->endpoint_count; endpoint_num++) {
+    struct SweepEndpoint moving = endpoints[endpoint_num];
+    unsigned int moving_proxy = moving.proxy_end >> 1;
+    unsigned int position = endpoint_num;
+
+    while (position > 0 && sweep_endpoint_less(&moving, &endpoints[position - 1])) {
+      struct SweepEndpoint* passed = &endpoints[position - 1];
+      unsigned int passed_proxy = passed->proxy_end >> 1;
+
+      if (track_pairs && passed_proxy != moving_proxy) {
+        if (!sweep_endpoint_is_max(&moving) && sweep_endpoint_is_max(passed)) {
+          if (aabb_overlaps(proxies[moving_proxy].aabb, proxies[passed_proxy].aabb))
+            sweep_prune_add_pair(sweep_prune, moving_proxy, passed_proxy);
+        } else if (sweep_endpoint_is_max(&moving) && !sweep_endpoint_is_max(passed)) {
+          sweep_prune_remove_pair(sweep_prune, moving_proxy, passed_proxy);
+        }
+      }
+
+      endpoints[position] = *passed;
+      proxies[passed_proxy].endpoint[axis][passed->proxy_end & 1] = position;
+      position--;
+    }
+
+    endpoints[position] = moving;
+    proxies[moving_proxy].endpoint[axis][moving.proxy_end & 1] = position;
+  }
+}
+
+// Walks the sorted axis keeping the boxes it is inside of, and tests every box it enters
+// against them
+static void sweep_prune_sweep_axis(struct SweepPrune* sweep_prune) {
+  if (sweep_prune->active_capacity < sweep_prune->proxy_count) {
+    sweep_prune->active_capacity = sweep_prune->proxy_count;
+    sweep_prune->active = realloc(sweep_prune->active, sizeof(unsigned int) * sweep_prune->active_capacity);
+  }
+
+  struct SweepEndpoint* endpoints = sweep_prune->endpoints[0];
+  struct SweepProxy* proxies = sweep_prune->proxies;
+  sweep_prune->active_count = 0;
+  for (unsigned int endpoint_num = 0; endpoint_num < sweep_prune->endpoint_count; endpoint_num++) {
+    unsigned int proxy_num = endpoints[endpoint_num].proxy_end >> 1;
+    struct SweepProxy* proxy = &proxies[proxy_num];
+
+    if (sweep_endpoint_is_max(&endpoints[endpoint_num])) {
+      unsigned int last = sweep_prune->active[--sweep_prune->active_count];
+      sweep_prune->active[proxy->active_index] = last;
+      proxies[last].active_index = proxy->active_index;
+      continue;
+    }
+
+    for (unsigned int active_num = 0; active_num < sweep_prune->active_count; active_num++) {
+      unsigned int other = sweep_prune->active[active_num];
+      if (aabb_overlaps(proxy->aabb, proxies[other].aabb))
+        sweep_prune_add_pair(sweep_prune, proxy_num, other);
+    }
+    proxy->active_index = sweep_prune->active_count;
+    sweep_prune->active[sweep_prune->active_count++] = proxy_num;
+  }
+}
+
+// Brings the pairs up to date with the moved, inserted and removed proxies and lists the
+// changes in added and removed, replacing the lists of the previous update
+void sweep_prune_update(struct SweepPrune* sweep_prune) {
+  sweep_prune->added_count = 0;
+  sweep_prune->removed_count = 0;
+  sweep_prune->stamp++;
+
+  sweep_prune_flush_removed(sweep_prune);
+
+  bool track_pairs = sweep_prune->axis_count == 3;
+  for (unsigned int axis = 0; axis < sweep_prune->axis_count; axis++)
+    sweep_prune_sort_axis(sweep_prune, axis, track_pairs);
+
+  if (!track_pairs) {
+    sweep_prune_sweep_axis(sweep_prune);
+    sweep_prune_remove_pairs(sweep_prune, true);
+  }
+}
+
+// Writes at most limit of the current pairs, needed is set to how many there are
+unsigned int sweep_prune_get_potential_contacts(struct SweepPrune* sweep_prune, struct PotentialContact* contacts, unsigned int limit, unsigned int* needed) {
+  unsigned int used = 0;
+  for (unsigned int slot = 0; slot < sweep_prune->pair_capacity && used < limit; slot++) {
+    struct SweepPair* pair = &sweep_prune->pairs[slot];
+    if (pair->proxy[0] == SWEEP_PRUNE_NULL)
+      continue;
+    contacts[used].body[0] = sweep_prune->proxies[pair->proxy[0]].body;
+    contacts[used].body[1] = sweep_prune->proxies[pair->proxy[1]].body;
+    used++;
+  }
+
+  *needed = sweep_prune->pair_count;
+  return used;
+}
@@ -1,59 +1,320 @@
 
 #include "chaos/core/world.h"
 
-static inline void world_init(struct World* world, unsigned int max_contacts, unsigned int iterations) {
-  world->first_body = NULL;
+void world_init(struct World* world, unsigned int contact_capacity, unsigned int iterations) {
+  body_pool_init(&world->bodies);
+  island_builder_init(&world->islands);
   contact_resolver_init(&world->resolver, iterations, iterations, 0.01f, 0.01f);
-  world->first_contact_gen = NULL;
-  world->max_contacts = max_contacts;
-  world->contacts = calloc(max_contacts, sizeof(struct Contact));
+  world->generator_count = 0;
+  world->generator_capacity = 0;
+  world->generators = NULL;
+  world->generator_output = NULL;
+  contact_arena_init(&world->contact_arena, contact_capacity);
+  world->contacts = NULL;
+  world->contact_shortfall = 0;
+  world->use_manifolds = false;
+  manifold_cache_init(&world->manifolds);
   world->calculate_iterations = (iterations == 0);
+  if (world->calculate_iterations)
+    contact_resolver_set_iterations_per_contact(&world->resolver, 4);
+  world->substeps = 1;
+  world->scheduler = NULL;
+  world->thread_arena_count = 0;
+  world->thread_arenas = NULL;
+  world->articulation_count = 0;
+  world->articulation_capacity = 0;
+  world->articulations = NULL;
 }
 
 // TODO: Might need to iterate free
-static inline void world_delete(struct World* world) {
-  free(world->contacts);
+void world_delete(struct World* world) {
+  body_pool_delete(&world->bodies);
+  island_builder_delete(&world->islands);
+  contact_resolver_delete(&world->resolver);
+  contact_arena_delete(&world->contact_arena);
+  manifold_cache_delete(&world->manifolds);
+  free(world->generators);
+  free(world->generator_output);
+  for (unsigned int arena_num = 0; arena_num < world->thread_arena_count; arena_num++)
+    contact_arena_delete(&world->thread_arenas[arena_num]);
+  free(world->thread_arenas);
+  free(world->articulations);
+}
+
+// The world simulates its own copy of the body, world_get_body returns it
+struct BodyHandle world_add_body(struct World* world, const struct RigidBody* body) {
+  struct BodyHandle handle = body_pool_add(&world->bodies, body);
+  rigid_body_mark_dirty(body_pool_get(&world->bodies, handle));
+  return handle;
+}
+
+// NOTE: The body's manifolds and cached impulses are forgotten, the next body added reuses its
+// storage and with it its address. Every other pair keeps them.
+bool world_remove_body(struct World* world, struct BodyHandle handle) {
+  struct RigidBody* body = body_pool_get(&world->bodies, handle);
+  if (!body)
+    return false;
+
+  manifold_cache_remove_body(&world->manifolds, body);
+  impulse_cache_remove_body(&world->resolver.impulse_cache, body);
+  return body_pool_remove(&world->bodies, handle);
+}
+
+struct RigidBody* world_get_body(struct World* world, struct BodyHandle handle) {
+  return body_pool_get(&world->bodies, handle);
+}
+
+// NOTE: The scheduler must outlive the world, NULL runs everything on the calling thread
+void world_set_scheduler(struct World* world, struct JobScheduler* scheduler) {
+  world->scheduler = scheduler;
+  contact_resolver_set_scheduler(&world->resolver, scheduler);
+}
+
+// NOTE: Zero is treated as one
+void world_set_substeps(struct World* world, unsigned int substeps) {
+  world->substeps = substeps > 0 ? substeps : 1;
+}
+
+void world_set_manifolds(struct World* world, bool use_manifolds) {
+  if (world->use_manifolds != use_manifolds)
+    manifold_cache_clear(&world->manifolds);
+  world->use_manifolds = use_manifolds;
+}
+
+// NOTE: The joints must outlive the world, they are solved along with the contacts
+void world_set_joints(struct World* world, struct JointConstraint* joints, unsigned int joint_count) {
+  contact_resolver_set_joints(&world->resolver, joints, joint_count);
+}
+
+// NOTE: The articulation must outlive the world, its stand in bodies are written right away so
+// generators can use them before the first step
+void world_add_articulation(struct World* world, struct Articulation* articulation) {
+  if (world->articulation_count == world->articulation_capacity) {
+    world->articulation_capacity = world->articulation_capacity ? world->articulation_capacity * 2 : 4;
+    world->articulations = realloc(world->articulations, sizeof(struct Articulation*) * world->articulation_capacity);
+  }
+  world->articulations[world->articulation_count++] = articulation;
+  articulation_update_bodies(articulation);
+}
+
+// Generators run in the order they were added, context is passed back to add_contacts
+unsigned int world_add_contact_generator(struct World* world, contact_generator_function add_contacts, void* context) {
+  if (world->generator_count == world->generator_capacity) {
+    world->generator_capacity = world->generator_capacity ? world->generator_capacity * 2 : 16;
+    world->generators = realloc(world->generators, sizeof(struct ContactGenerator) * world->generator_capacity);
+    world->generator_output = realloc(world->generator_output, sizeof(struct ContactGenOutput) * world->generator_capacity);
+  }
+  world->generators[world->generator_count] = (struct ContactGenerator){.add_contacts = add_contacts, .context = context};
+  return world->generator_count++;
+}
+
+void world_clear_contact_generators(struct World* world) {
+  world->generator_count = 0;
+}
+
+// Sizes the contact storage ahead of time, world_get_contact_high_water tells how much a
+// scene has needed so far
+void world_reserve_contacts(struct World* world, unsigned int contact_capacity) {
+  contact_arena_reserve(&world->contact_arena, contact_capacity);
+}
+
+unsigned int world_get_contact_high_water(struct World* world) {
+  return world->contact_arena.high_water;
+}
+
+// Contacts the last step's generators asked for but did not write, zero unless one is broken
+unsigned int world_get_contact_shortfall(struct World* world) {
+  return world->contact_shortfall;
+}
+
+static void world_clear_accumulators_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct BodyPool* body_pool = data;
+  for (unsigned int body_num = begin; body_num < end; body_num++)
+    rigid_body_clear_accumulators(body_pool->bodies[body_num]);
+}
+
+void world_start_frame(struct World* world) {
+  job_scheduler_parallel_for(world->scheduler, world->bodies.size, BODY_POOL_CHUNK_SIZE, world_clear_accumulators_range, &world->bodies);
+  body_pool_calculate_derived_data(&world->bodies, world->scheduler);
+}
+
+// Runs a generator into the arena, and once more into a span of everything it needed when the
+// first one was too small. A generator that still needs more than it wrote keeps what it wrote
+// and the rest is counted as dropped, rather than retried without end.
+static unsigned int world_run_generator(struct ContactGenerator* contact_generator, struct ContactArena* contact_arena, struct Contact** contacts, unsigned int* dropped) {
+  unsigned int limit;
+  unsigned int needed;
+  *contacts = contact_arena_begin(contact_arena, 1, &limit);
+  unsigned int used = contact_generator_run(contact_generator, *contacts, limit, &needed);
+
+  if (needed > used) {
+    *contacts = contact_arena_begin(contact_arena, needed, &limit);
+    used = contact_generator_run(contact_generator, *contacts, limit, &needed);
+  }
+
+  *dropped = needed - used;
+  contact_arena_commit(contact_arena, used);
+  return used;
 }
 
-static inline void world_start_frame(struct World* world) {
-  struct BodyRegistration* reg = world->first_body;
-  while (reg) {
-    rigid_body_clear_accumulators(reg->body);
-    rigid_body_calculate_derived_data(reg->body);
-    reg = reg->next;
+static void world_generate_contacts_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct World* world = data;
+  struct ContactArena* contact_arena = &world->thread_arenas[thread_index];
+
+  for (unsigned int gen_num = begin; gen_num < end; gen_num++) {
+    struct ContactGenOutput* output = &world->generator_output[gen_num];
+    output->count = world_run_generator(&world->generators[gen_num], contact_arena, &output->contacts, &output->dropped);
   }
 }
 
-// NOTE: Watch for functional programming here
-static inline unsigned int world_generate_contacts(struct World* world) {
-  unsigned int limit = world->max_contacts;
-  struct Contact* next_contact = world->contacts;
+// Generators run in parallel, each writing into the arena of the thread that picked it up.
+// The arenas are then merged in registration order, so the contact array does not depend on
+// how the generators were scheduled. Generators must not share mutable state.
+static unsigned int world_generate_contacts_parallel(struct World* world) {
+  unsigned int thread_count = job_scheduler_thread_count(world->scheduler);
+
+  if (world->thread_arena_count < thread_count) {
+    world->thread_arenas = realloc(world->thread_arenas, sizeof(struct ContactArena) * thread_count);
+    for (unsigned int arena_num = world->thread_arena_count; arena_num < thread_count; arena_num++)
+      contact_arena_init(&world->thread_arenas[arena_num], 0);
+    world->thread_arena_count = thread_count;
+  }
+  for (unsigned int arena_num = 0; arena_num < world->thread_arena_count; arena_num++)
+    contact_arena_reset(&world->thread_arenas[arena_num]);
 
-  struct ContactGenRegistration* reg = world->first_contact_gen;
-  while (reg) {
-    unsigned int used = reg->gen->add_contact(next_contact, limit);
-    limit -= used;
-    next_contact += used;
+  job_scheduler_parallel_for(world->scheduler, world->generator_count, 1, world_generate_contacts_range, world);
 
-    if (limit <= 0)
-      break;
+  unsigned int total = 0;
+  for (unsigned int gen_num = 0; gen_num < world->generator_count; gen_num++) {
+    total += world->generator_output[gen_num].count;
+    world->contact_shortfall += world->generator_output[gen_num].dropped;
+  }
 
-    reg = reg->next;
+  unsigned int limit;
+  struct Contact* contacts = contact_arena_begin(&world->contact_arena, total, &limit);
+  unsigned int used = 0;
+  for (unsigned int gen_num = 0; gen_num < world->generator_count; gen_num++) {
+    struct ContactGenOutput* output = &world->generator_output[gen_num];
+    memcpy(contacts + used, output->contacts, sizeof(struct Contact) * output->count);
+    used += output->count;
   }
+  contact_arena_commit(&world->contact_arena, used);
 
-  return world->max_contacts - limit;
+  return used;
 }
 
-static inline void world_run_physics(struct World* world, float duration) {
-  struct BodyRegistration* reg = world->first_body;
-  while (reg) {
-    rigid_body_integrate(reg->body, duration);
-    reg = reg->next;
+// Fills the contact array from every generator in order. The arena grows to whatever the
+// generators need, so only a generator that keeps asking for more than it writes loses
+// contacts, see world_get_contact_shortfall. With manifolds the contacts are then the manifold
+// points instead.
+unsigned int world_generate_contacts(struct World* world) {
+  contact_arena_reset(&world->contact_arena);
+  world->contact_shortfall = 0;
+
+  unsigned int used = 0;
+  if (job_scheduler_thread_count(world->scheduler) > 1) {
+    used = world_generate_contacts_parallel(world);
+  } else {
+    struct Contact* contacts;
+    unsigned int dropped;
+    for (unsigned int gen_num = 0; gen_num < world->generator_count; gen_num++) {
+      used += world_run_generator(&world->generators[gen_num], &world->contact_arena, &contacts, &dropped);
+      world->contact_shortfall += dropped;
+    }
   }
 
+  world->contacts = contact_arena_flatten(&world->contact_arena);
+  if (world->use_manifolds) {
+    used = manifold_cache_update(&world->manifolds, world->contacts, used);
+    world->contacts = world->manifolds.contacts;
+  }
+  return used;
+}
+
+static void world_store_anchors_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct World* world = data;
+  for (unsigned int contact_num = begin; contact_num < end; contact_num++)
+    contact_store_anchors(&world->contacts[contact_num]);
+}
+
+static void world_follow_anchors_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct World* world = data;
+  for (unsigned int contact_num = begin; contact_num < end; contact_num++)
+    contact_follow_anchors(&world->contacts[contact_num]);
+}
+
+struct WorldArticulationStep {
+  struct World* world;
+  float duration;
+  bool clear_accumulators;
+};
+
+static void world_integrate_articulations_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct WorldArticulationStep* step = data;
+  for (unsigned int articulation_num = begin; articulation_num < end; articulation_num++)
+    articulation_integrate(step->world->articulations[articulation_num], step->duration, step->clear_accumulators);
+}
+
+static void world_apply_articulation_contacts_range(void* data, unsigned int begin, unsigned int end, unsigned int thread_index) {
+  struct World* world = data;
+  for (unsigned int articulation_num = begin; articulation_num < end; articulation_num++)
+    articulation_apply_contacts(world->articulations[articulation_num]);
+}
+
+// Articulations are independent of each other, each one is a task
+static void world_integrate_articulations(struct World* world, float duration, bool clear_accumulators) {
+  struct WorldArticulationStep step = {.world = world, .duration = duration, .clear_accumulators = clear_accumulators};
+  job_scheduler_parallel_for(world->scheduler, world->articulation_count, 1, world_integrate_articulations_range, &step);
+}
+
+static void world_apply_articulation_contacts(struct World* world) {
+  job_scheduler_parallel_for(world->scheduler, world->articulation_count, 1, world_apply_articulation_contacts_range, world);
+}
+
+// Joined bodies share an island, so a chain sleeps and wakes as a whole
+static unsigned int world_update_islands(struct World* world, unsigned int used_contacts) {
+  island_builder_build(&world->islands, &world->bodies, world->contacts, used_contacts);
+  for (unsigned int joint_num = 0; joint_num < world->resolver.joint_count; joint_num++) {
+    struct JointConstraint* joint = &world->resolver.joints[joint_num];
+    island_builder_link(&world->islands, &world->bodies, joint->body[0], joint->body[1]);
+  }
+  island_builder_update_sleep(&world->islands, &world->bodies);
+  return island_builder_remove_sleeping_contacts(&world->islands, world->contacts, used_contacts);
+}
+
+// Generation sees the bodies as world_start_frame left them, the contacts are then anchored to
+// the bodies and follow them through every substep, which lets the resolver keep what it built
+// in the first one. Forces act for the whole step, so they are only cleared by the last substep.
+static void world_run_substeps(struct World* world, float duration) {
   unsigned int used_contacts = world_generate_contacts(world);
 
-  if (world->calculate_iterations)
-    contact_resolver_set_iterations(&world->resolver, used_contacts * 4, used_contacts * 4);
+  used_contacts = world_update_islands(world, used_contacts);
+  job_scheduler_parallel_for(world->scheduler, used_contacts, CONTACT_RESOLVER_GRAIN, world_store_anchors_range, world);
+
+  float substep = duration / world->substeps;
+  for (unsigned int substep_num = 0; substep_num < world->substeps; substep_num++) {
+    bool last_substep = substep_num + 1 == world->substeps;
+    body_pool_integrate(&world->bodies, world->scheduler, substep, last_substep);
+    world_integrate_articulations(world, substep, last_substep);
+    job_scheduler_parallel_for(world->scheduler, used_contacts, CONTACT_RESOLVER_GRAIN, world_follow_anchors_range, world);
+    contact_resolver_resolve_substep(&world->resolver, world->contacts, used_contacts, substep, substep_num == 0, last_substep);
+    world_apply_articulation_contacts(world);
+  }
+}
+
+void world_run_physics(struct World* world, float duration) {
+  if (world->substeps > 1) {
+    world_run_substeps(world, duration);
+    return;
+  }
+
+  body_pool_integrate(&world->bodies, world->scheduler, duration, true);
+  world_integrate_articulations(world, duration, true);
+
+  unsigned int used_contacts = world_generate_contacts(world);
+
+  used_contacts = world_update_islands(world, used_contacts);
+
   contact_resolver_resolve_contacts(&world->resolver, world->contacts, used_contacts, duration);
+  world_apply_articulation_contacts(world);
 }